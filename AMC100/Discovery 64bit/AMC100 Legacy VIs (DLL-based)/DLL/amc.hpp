@@ -0,0 +1,380 @@
+/******************************************************************/
+/** @file amc.hpp
+ *  AMC100 C++ interface
+ *
+ *  Header-only C++ layer over @ref amc.h. Provides a move-only device
+ *  handle, position types that carry their unit (nm or micro degree,
+ *  selected by the @ref AMC_actorType of the axis) and compile-time
+ *  axis sets whose operations are unrolled into one DLL call per axis.
+ *
+ *  No function in this header allocates on the heap unless an error
+ *  is reported, in which case an @ref amc::Error is thrown.
+ */
+/******************************************************************/
+
+#ifndef __AMC_HPP__
+#define __AMC_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "amc.h"
+
+#ifdef AMC_USE_TRACE
+#include "spantrace.h"
+#define AMC_HPP_TRACE( fn ) TRC_SCOPE( fn )   /**< Span per DLL call, see spantrace.h */
+#else
+#define AMC_HPP_TRACE( fn )
+#endif
+
+namespace amc {
+
+/** @brief  Error reported by the DLL                                                */
+class Error : public std::runtime_error
+{
+public:
+  Error( Int32 code, const char* function )
+    : std::runtime_error( function ), code_( code ) {}
+
+  Int32 code() const noexcept { return code_; }  /**< NCB_... result of the call    */
+
+private:
+  Int32 code_;
+};
+
+/** @brief Check a DLL result and throw on failure */
+inline void check( Int32 result, const char* function )
+{
+  if ( result != NCB_Ok )
+    throw Error( result, function );
+}
+
+
+/** @brief  Position / distance on a linear actor, in nm                           */
+struct Nanometre {
+  Int32 value;
+};
+
+/** @brief  Position / distance on a goniometer or rotator, in micro degree        */
+struct MicroDegree {
+  Int32 value;
+};
+
+/** @brief  Unit of an actor type, see @ref AMC_actorType                          */
+template <AMC_actorType Type> struct ActorUnit;
+template <> struct ActorUnit<AMC_actorLinear> { using type = Nanometre;   };
+template <> struct ActorUnit<AMC_actorGonio>  { using type = MicroDegree; };
+template <> struct ActorUnit<AMC_actorRot>    { using type = MicroDegree; };
+
+#define AMC_HPP_UNIT_OPS(U)                                                              \
+  constexpr bool operator==( U a, U b ) noexcept { return a.value == b.value; }          \
+  constexpr bool operator!=( U a, U b ) noexcept { return a.value != b.value; }          \
+  constexpr bool operator< ( U a, U b ) noexcept { return a.value <  b.value; }          \
+  constexpr U    operator+ ( U a, U b ) noexcept { return U{ a.value + b.value }; }      \
+  constexpr U    operator- ( U a, U b ) noexcept { return U{ a.value - b.value }; }
+AMC_HPP_UNIT_OPS( Nanometre )
+AMC_HPP_UNIT_OPS( MicroDegree )
+#undef AMC_HPP_UNIT_OPS
+
+
+/** @brief  Axis known at compile time
+ *
+ *  @tparam Index  Number of the axis on the controller [0..2]
+ *  @tparam Type   Actor type expected on that axis; selects the position unit
+ */
+template <Int32 Index, AMC_actorType Type = AMC_actorLinear>
+struct Axis {
+  static_assert( Index >= 0 && Index < 3, "AMC100 has three axes" );
+  static constexpr Int32         index = Index;
+  static constexpr AMC_actorType actor = Type;
+  using unit = typename ActorUnit<Type>::type;
+};
+
+/** @brief  Set of distinct axes operated together
+ *
+ *  Every operation on an axis set expands to one DLL call per axis at
+ *  compile time; results are returned in a std::tuple ordered like the
+ *  template arguments.
+ */
+template <class... Axes>
+struct AxisSet {
+  static constexpr std::size_t size = sizeof...( Axes );
+  using positions = std::tuple<typename Axes::unit...>;
+  using flags     = std::array<bool, sizeof...( Axes )>;
+};
+
+
+/** @brief  Fixed capacity, NULL-terminated string returned by the name getters    */
+template <std::size_t N>
+class FixedString
+{
+public:
+  char*       data()        noexcept { return buf_.data(); }
+  const char* c_str() const noexcept { return buf_.data(); }
+  std::size_t size()  const noexcept { return std::strlen( buf_.data() ); }
+  static constexpr Int32 capacity()  { return static_cast<Int32>( N ); }
+
+private:
+  std::array<char, N> buf_{};
+};
+
+using Name = FixedString<64>;   /**< Buffer size used for names and versions      */
+
+
+/** @brief Connected AMC device
+ *
+ *  Owns a handle obtained by @ref AMC_Connect and releases it with
+ *  @ref AMC_Close. The object can be moved but not copied.
+ */
+class Device
+{
+public:
+  /** @brief Connect device
+   *
+   *  @param  address  IP address of the device, see @ref AMC_Connect
+   */
+  explicit Device( const char* address )
+  {
+    AMC_HPP_TRACE( "AMC_Connect" );
+    check( AMC_Connect( address, &handle_ ), "AMC_Connect" );
+  }
+
+  /** @brief Adopt a handle returned by @ref AMC_Connect */
+  static Device adopt( Int32 handle ) noexcept { return Device( handle ); }
+
+  Device( Device&& other ) noexcept : handle_( other.release() ) {}
+  Device& operator=( Device&& other ) noexcept
+  {
+    if ( this != &other ) {
+      reset();
+      handle_ = other.release();
+    }
+    return *this;
+  }
+  Device( const Device& ) = delete;
+  Device& operator=( const Device& ) = delete;
+  ~Device() { reset(); }
+
+  Int32 handle() const noexcept { return handle_; }
+  explicit operator bool() const noexcept { return handle_ >= 0; }
+
+  /** @brief Give up ownership without closing the connection */
+  Int32 release() noexcept
+  {
+    Int32 h = handle_;
+    handle_ = -1;
+    return h;
+  }
+
+  /** @brief Close the connection, see @ref AMC_Close */
+  void reset() noexcept
+  {
+    if ( handle_ >= 0 )
+      AMC_Close( handle_ );
+    handle_ = -1;
+  }
+
+  /* ----- Single axis -------------------------------------------------------- */
+
+  template <class A>
+  typename A::unit position( A ) const
+  {
+    Int32 v = 0;
+    AMC_HPP_TRACE( "AMC_getPosition" );
+    check( AMC_getPosition( handle_, A::index, &v ), "AMC_getPosition" );
+    return typename A::unit{ v };
+  }
+
+  template <class A>
+  typename A::unit referencePosition( A ) const
+  {
+    Int32 v = 0;
+    AMC_HPP_TRACE( "AMC_getReferencePosition" );
+    check( AMC_getReferencePosition( handle_, A::index, &v ), "AMC_getReferencePosition" );
+    return typename A::unit{ v };
+  }
+
+  template <class A>
+  void setTarget( A, typename A::unit target ) const
+  {
+    Int32 v = target.value;
+    AMC_HPP_TRACE( "AMC_controlTargetPosition" );
+    check( AMC_controlTargetPosition( handle_, A::index, &v, 1 ), "AMC_controlTargetPosition" );
+  }
+
+  template <class A>
+  void setTargetRange( A, typename A::unit range ) const
+  {
+    Int32 v = range.value;
+    AMC_HPP_TRACE( "AMC_controlTargetRange" );
+    check( AMC_controlTargetRange( handle_, A::index, &v, 1 ), "AMC_controlTargetRange" );
+  }
+
+  template <class A>
+  void setOutput( A, bool enable ) const
+  {
+    Bln32 v = enable;
+    AMC_HPP_TRACE( "AMC_controlOutput" );
+    check( AMC_controlOutput( handle_, A::index, &v, 1 ), "AMC_controlOutput" );
+  }
+
+  template <class A>
+  void setMove( A, bool enable ) const
+  {
+    Bln32 v = enable;
+    AMC_HPP_TRACE( "AMC_controlMove" );
+    check( AMC_controlMove( handle_, A::index, &v, 1 ), "AMC_controlMove" );
+  }
+
+  template <class A>
+  bool inTargetRange( A ) const
+  {
+    Bln32 v = 0;
+    AMC_HPP_TRACE( "AMC_getStatusTargetRange" );
+    check( AMC_getStatusTargetRange( handle_, A::index, &v ), "AMC_getStatusTargetRange" );
+    return v != 0;
+  }
+
+  /** @brief Moving status, 0: Idle; 1: Moving; 2: Pending */
+  template <class A>
+  Int32 moving( A ) const
+  {
+    Int32 v = 0;
+    AMC_HPP_TRACE( "AMC_getStatusMoving" );
+    check( AMC_getStatusMoving( handle_, A::index, &v ), "AMC_getStatusMoving" );
+    return v;
+  }
+
+  /** @brief Frequency of the actuator signal in mHz */
+  template <class A>
+  Int32 frequency( A ) const
+  {
+    Int32 v = 0;
+    AMC_HPP_TRACE( "AMC_controlFrequency" );
+    check( AMC_controlFrequency( handle_, A::index, &v, 0 ), "AMC_controlFrequency" );
+    return v;
+  }
+
+  template <class A>
+  Name actorName( A ) const
+  {
+    Name n;
+    AMC_HPP_TRACE( "AMC_getActorName" );
+    check( AMC_getActorName( handle_, A::index, n.data(), Name::capacity() ), "AMC_getActorName" );
+    return n;
+  }
+
+  /** @brief Throws NCB_InvalidParam if the connected actor differs from A::actor
+   *
+   *  Linear actors report positions in nm, goniometers and rotators in
+   *  micro degree; a mismatch would silently mix up units.
+   */
+  template <class A>
+  void checkActor( A ) const
+  {
+    AMC_actorType t = AMC_actorLinear;
+    AMC_HPP_TRACE( "AMC_getActorType" );
+    check( AMC_getActorType( handle_, A::index, &t ), "AMC_getActorType" );
+    if ( ( t == AMC_actorLinear ) != ( A::actor == AMC_actorLinear ) )
+      throw Error( NCB_InvalidParam, "AMC_getActorType" );
+  }
+
+  /* ----- Axis sets ---------------------------------------------------------- */
+
+  template <class... A>
+  typename AxisSet<A...>::positions positions( AxisSet<A...> ) const
+  {
+    return typename AxisSet<A...>::positions{ position( A{} )... };
+  }
+
+  template <class... A>
+  void setTargets( AxisSet<A...>, typename A::unit... targets ) const
+  {
+    ( setTarget( A{}, targets ), ... );
+  }
+
+  template <class... A>
+  void setTargets( AxisSet<A...> set, const typename AxisSet<A...>::positions& targets ) const
+  {
+    std::apply( [&]( auto... t ) { setTargets( set, t... ); }, targets );
+  }
+
+  template <class... A>
+  void setOutputs( AxisSet<A...>, bool enable ) const
+  {
+    ( setOutput( A{}, enable ), ... );
+  }
+
+  template <class... A>
+  void setMoves( AxisSet<A...>, bool enable ) const
+  {
+    ( setMove( A{}, enable ), ... );
+  }
+
+  template <class... A>
+  typename AxisSet<A...>::flags inTargetRanges( AxisSet<A...> ) const
+  {
+    return typename AxisSet<A...>::flags{ { inTargetRange( A{} )... } };
+  }
+
+  /** @brief True when every axis of the set is within its target range */
+  template <class... A>
+  bool allInTargetRange( AxisSet<A...> ) const
+  {
+    return ( inTargetRange( A{} ) && ... );
+  }
+
+  template <class... A>
+  void checkActors( AxisSet<A...> ) const
+  {
+    ( checkActor( A{} ), ... );
+  }
+
+  /** @brief Set targets and start the approach on every axis of the set */
+  template <class... A>
+  void moveTo( AxisSet<A...> set, typename A::unit... targets ) const
+  {
+    setTargets( set, targets... );
+    setMoves( set, true );
+  }
+
+  /* ----- Device information ------------------------------------------------- */
+
+  Name deviceName() const
+  {
+    Name n;
+    AMC_HPP_TRACE( "AMC_getDeviceName" );
+    check( AMC_getDeviceName( handle_, n.data(), Name::capacity() ), "AMC_getDeviceName" );
+    return n;
+  }
+
+  Name firmwareVersion() const
+  {
+    Name n;
+    AMC_HPP_TRACE( "AMC_getFirmwareVersion" );
+    check( AMC_getFirmwareVersion( handle_, n.data(), Name::capacity() ), "AMC_getFirmwareVersion" );
+    return n;
+  }
+
+  Name serialNumber() const
+  {
+    Name n;
+    AMC_HPP_TRACE( "AMC_getSerialNumber" );
+    check( AMC_getSerialNumber( handle_, n.data(), Name::capacity() ), "AMC_getSerialNumber" );
+    return n;
+  }
+
+private:
+  explicit Device( Int32 handle ) noexcept : handle_( handle ) {}
+
+  Int32 handle_ = -1;
+};
+
+} // namespace amc
+
+#endif
@@ -0,0 +1,666 @@
+/******************************************************************/
+/** @file ccdpipe.cpp
+ *  CCD frame processing DLL
+ *
+ *  Implementation of @ref ccdpipe.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "ccdpipe.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define CCD_SSE2
+#endif
+
+namespace {
+
+const Int32 kSlots = 2;                  /**< input and output buffers       */
+
+
+/* ----- Kernels -------------------------------------------------------------- */
+
+/** out = ( raw - offset ) * gain, offset and gain optional                */
+template <bool Sub, bool Mul>
+void correct( const Int32* raw, const float* offset, const float* gain, float* out, size_t n )
+{
+  size_t i = 0;
+#ifdef CCD_SSE2
+  for ( ; i + 4 <= n; i += 4 ) {
+    __m128 v = _mm_cvtepi32_ps( _mm_loadu_si128( reinterpret_cast<const __m128i*>( raw + i ) ) );
+    if ( Sub )
+      v = _mm_sub_ps( v, _mm_loadu_ps( offset + i ) );
+    if ( Mul )
+      v = _mm_mul_ps( v, _mm_loadu_ps( gain + i ) );
+    _mm_storeu_ps( out + i, v );
+  }
+#endif
+  for ( ; i < n; ++i ) {
+    float v = float( raw[i] );
+    if ( Sub )
+      v -= offset[i];
+    if ( Mul )
+      v *= gain[i];
+    out[i] = v;
+  }
+}
+
+void correct( const Int32* raw, const float* offset, const float* gain, float* out, size_t n )
+{
+  if ( offset && gain )
+    correct<true, true>( raw, offset, gain, out, n );
+  else if ( offset )
+    correct<true, false>( raw, offset, gain, out, n );
+  else if ( gain )
+    correct<false, true>( raw, offset, gain, out, n );
+  else
+    correct<false, false>( raw, offset, gain, out, n );
+}
+
+
+/** Replaces pixels 2 .. w-3 of out by the median of 5 of row when they
+ *  exceed it by more than thr. The median uses min/max only: dropping
+ *  the smaller of the two pair minima and the larger of the two pair
+ *  maxima leaves three values with the same median.                     */
+void reject( const float* row, float* out, Int32 w, float thr )
+{
+  Int32 i = 2;
+#ifdef CCD_SSE2
+  const __m128 t = _mm_set1_ps( thr );
+  for ( ; i + 4 <= w - 2; i += 4 ) {
+    __m128 a = _mm_loadu_ps( row + i - 2 ), b = _mm_loadu_ps( row + i - 1 );
+    __m128 c = _mm_loadu_ps( row + i );
+    __m128 d = _mm_loadu_ps( row + i + 1 ), e = _mm_loadu_ps( row + i + 2 );
+    __m128 x = _mm_max_ps( _mm_min_ps( a, b ), _mm_min_ps( d, e ) );
+    __m128 y = _mm_min_ps( _mm_max_ps( a, b ), _mm_max_ps( d, e ) );
+    __m128 med  = _mm_max_ps( _mm_min_ps( x, y ), _mm_min_ps( _mm_max_ps( x, y ), c ) );
+    __m128 mask = _mm_cmpgt_ps( _mm_sub_ps( c, med ), t );
+    _mm_storeu_ps( out + i, _mm_or_ps( _mm_and_ps( mask, med ), _mm_andnot_ps( mask, c ) ) );
+  }
+#endif
+  for ( ; i < w - 2; ++i ) {
+    float x   = std::max( std::min( row[i - 2], row[i - 1] ), std::min( row[i + 1], row[i + 2] ) );
+    float y   = std::min( std::max( row[i - 2], row[i - 1] ), std::max( row[i + 1], row[i + 2] ) );
+    float med = std::max( std::min( x, y ), std::min( std::max( x, y ), row[i] ) );
+    out[i] = row[i] - med > thr ? med : row[i];
+  }
+}
+
+
+/** dst += src                                                             */
+void addRow( const float* src, float* dst, size_t n )
+{
+  size_t i = 0;
+#ifdef CCD_SSE2
+  for ( ; i + 4 <= n; i += 4 )
+    _mm_storeu_ps( dst + i, _mm_add_ps( _mm_loadu_ps( dst + i ), _mm_loadu_ps( src + i ) ) );
+#endif
+  for ( ; i < n; ++i )
+    dst[i] += src[i];
+}
+
+
+/** dst = src (first) or dst += src, widening to double                    */
+void accumulate( const float* src, double* dst, size_t n, bool first )
+{
+  size_t i = 0;
+#ifdef CCD_SSE2
+  for ( ; i + 4 <= n; i += 4 ) {
+    __m128  v  = _mm_loadu_ps( src + i );
+    __m128d lo = _mm_cvtps_pd( v );
+    __m128d hi = _mm_cvtps_pd( _mm_movehl_ps( v, v ) );
+    if ( !first ) {
+      lo = _mm_add_pd( lo, _mm_loadu_pd( dst + i ) );
+      hi = _mm_add_pd( hi, _mm_loadu_pd( dst + i + 2 ) );
+    }
+    _mm_storeu_pd( dst + i, lo );
+    _mm_storeu_pd( dst + i + 2, hi );
+  }
+#endif
+  for ( ; i < n; ++i )
+    dst[i] = first ? double( src[i] ) : dst[i] + src[i];
+}
+
+
+/* ----- Pipeline ------------------------------------------------------------- */
+
+class Pipeline
+{
+public:
+  Pipeline( Int32 width, Int32 height, bool keepAll )
+    : w_( width ), h_( height ), n_( size_t( width ) * height ), keepAll_( keepAll ),
+      work_( n_ ), frame_( n_ ), row_( width ),
+      accumulate_( 1 ), accCount_( 0 ), threshold_( 0.f ),
+      captureKind_( 0 ), captureLeft_( 0 ), captureTotal_( 0 ),
+      stop_( false ), inHead_( 0 ), inCount_( 0 ),
+      outHead_( 0 ), outCount_( 0 ), epoch_( 0 ),
+      frames_( 0 ), results_( 0 ), dropped_( 0 ), latestSeq_( 0 )
+  {
+    for ( Int32 k = 0; k < kSlots; ++k )
+      in_[k].resize( n_ );
+    thread_ = std::thread( &Pipeline::run, this );
+  }
+
+  ~Pipeline()
+  {
+    shutdown();
+    thread_.join();
+  }
+
+  /** Wakes all waiting callers and ends the thread                       */
+  void shutdown()
+  {
+    {
+      std::lock_guard<std::mutex> lk( m_ );
+      stop_ = true;
+    }
+    inCv_.notify_all();
+    outCv_.notify_all();
+  }
+
+  size_t pixels() const { return n_; }
+  Int32  width() const { return w_; }
+
+  Int32 rows()
+  {
+    std::lock_guard<std::mutex> lk( cfg_ );
+    return tracks_.empty() ? h_ : Int32( tracks_.size() );
+  }
+
+  /* --- Configuration, applied between frames --- */
+
+  void setReference( Int32 kind, const double* frame )
+  {
+    std::lock_guard<std::mutex> lk( cfg_ );
+    std::vector<float>& ref = reference( kind );
+    if ( frame )
+      ref.assign( frame, frame + n_ );
+    else
+      ref.clear();
+    derive();
+  }
+
+  bool getReference( Int32 kind, double* frame )
+  {
+    std::lock_guard<std::mutex> lk( cfg_ );
+    const std::vector<float>& ref = reference( kind );
+    if ( ref.empty() )
+      return false;
+    std::copy( ref.begin(), ref.end(), frame );
+    return true;
+  }
+
+  void capture( Int32 kind, Int32 frames )
+  {
+    std::lock_guard<std::mutex> lk( cfg_ );
+    captureKind_  = kind;
+    captureLeft_  = captureTotal_ = frames;
+    captureSum_.assign( n_, 0. );
+  }
+
+  void setTracks( const std::vector<std::pair<Int32, Int32> >& tracks )
+  {
+    std::lock_guard<std::mutex> lk( cfg_ );
+    tracks_ = tracks;
+    binned_.assign( tracks.size() * w_, 0.f );
+    acc_.assign( size_t( w_ ) * ( tracks.empty() ? h_ : tracks.size() ), 0. );
+    accCount_ = 0;
+    std::lock_guard<std::mutex> lk2( m_ );
+    ++epoch_;
+    outCount_ = 0;
+    latest_.clear();
+    outCv_.notify_all();
+  }
+
+  void setAccumulate( Int32 frames )
+  {
+    std::lock_guard<std::mutex> lk( cfg_ );
+    accumulate_ = frames;
+    accCount_   = 0;
+  }
+
+  void setCosmic( double threshold )
+  {
+    std::lock_guard<std::mutex> lk( cfg_ );
+    threshold_ = float( threshold );
+  }
+
+  /* --- Data --- */
+
+  Int32 push( const Int32* frame, Int32 timeout )
+  {
+    std::lock_guard<std::mutex> serial( push_ );
+    std::unique_lock<std::mutex> lk( m_ );
+    if ( !inCv_.wait_for( lk, std::chrono::milliseconds( timeout ),
+                          [this] { return inCount_ < kSlots || stop_; } ) )
+      return CCD_Timeout;
+    if ( stop_ )
+      return CCD_NotConnected;
+    std::vector<Int32>& slot = in_[( inHead_ + inCount_ ) % kSlots];
+    lk.unlock();
+    std::memcpy( slot.data(), frame, n_ * sizeof( Int32 ) );
+    lk.lock();
+    ++inCount_;
+    lk.unlock();
+    inCv_.notify_all();
+    return CCD_Ok;
+  }
+
+  Int32 read( double* result, Int32 size, Int32 timeout, Int32* sequence )
+  {
+    std::unique_lock<std::mutex> lk( m_ );
+    if ( !outCv_.wait_for( lk, std::chrono::milliseconds( timeout ),
+                           [this] { return outCount_ > 0 || stop_; } ) )
+      return CCD_Timeout;
+    if ( outCount_ == 0 )
+      return CCD_NotConnected;
+    const std::vector<double>& slot = out_[outHead_];
+    if ( size_t( size ) < slot.size() )
+      return CCD_BufferTooSmall;
+    std::copy( slot.begin(), slot.end(), result );
+    if ( sequence )
+      *sequence = outSeq_[outHead_];
+    outHead_ = ( outHead_ + 1 ) % kSlots;
+    --outCount_;
+    lk.unlock();
+    outCv_.notify_all();
+    return CCD_Ok;
+  }
+
+  Int32 latest( double* result, Int32 size, Int32* sequence )
+  {
+    std::lock_guard<std::mutex> lk( m_ );
+    if ( latest_.empty() )
+      return CCD_NoData;
+    if ( size_t( size ) < latest_.size() )
+      return CCD_BufferTooSmall;
+    std::copy( latest_.begin(), latest_.end(), result );
+    if ( sequence )
+      *sequence = latestSeq_;
+    return CCD_Ok;
+  }
+
+  void counters( Int32* frames, Int32* results, Int32* dropped )
+  {
+    std::lock_guard<std::mutex> lk( m_ );
+    if ( frames )
+      *frames = frames_;
+    if ( results )
+      *results = results_;
+    if ( dropped )
+      *dropped = dropped_;
+  }
+
+private:
+  std::vector<float>& reference( Int32 kind )
+  {
+    return kind == CCD_Dark ? dark_ : kind == CCD_Background ? background_ : flat_;
+  }
+
+  /** Combined offset and flat field gain from the references             */
+  void derive()
+  {
+    offset_.clear();
+    if ( !dark_.empty() || !background_.empty() ) {
+      offset_.assign( n_, 0.f );
+      if ( !dark_.empty() )
+        addRow( dark_.data(), offset_.data(), n_ );
+      if ( !background_.empty() )
+        addRow( background_.data(), offset_.data(), n_ );
+    }
+    gain_.clear();
+    if ( !flat_.empty() ) {
+      double sum = 0.;
+      size_t used = 0;
+      for ( float f : flat_ )
+        if ( f > 0.f ) {
+          sum += f;
+          ++used;
+        }
+      float mean = used ? float( sum / used ) : 1.f;
+      gain_.resize( n_ );
+      for ( size_t i = 0; i < n_; ++i )
+        gain_[i] = flat_[i] > 0.f ? mean / flat_[i] : 0.f;
+    }
+  }
+
+  void run()
+  {
+    for ( ;; ) {
+      {
+        std::unique_lock<std::mutex> lk( m_ );
+        inCv_.wait( lk, [this] { return inCount_ > 0 || stop_; } );
+        if ( stop_ )
+          return;
+        work_.swap( in_[inHead_] );
+        inHead_ = ( inHead_ + 1 ) % kSlots;
+        --inCount_;
+        ++frames_;
+      }
+      inCv_.notify_all();
+
+      Int32 epoch;
+      {
+        std::lock_guard<std::mutex> lk( cfg_ );
+        if ( !process() )
+          continue;
+        std::lock_guard<std::mutex> lk2( m_ );
+        epoch = epoch_;
+        ready_.assign( acc_.begin(), acc_.end() );
+      }
+      emit( epoch );
+    }
+  }
+
+  /** Processes work_, returns true when a result is complete in acc_     */
+  bool process()
+  {
+    if ( captureLeft_ > 0 ) {
+      const float* offset = captureKind_ == CCD_Dark ? 0
+                          : captureKind_ == CCD_Background ? ( dark_.empty() ? 0 : dark_.data() )
+                          : ( offset_.empty() ? 0 : offset_.data() );
+      correct( work_.data(), offset, 0, frame_.data(), n_ );
+      accumulate( frame_.data(), captureSum_.data(), n_, false );
+      if ( --captureLeft_ == 0 ) {
+        std::vector<float>& ref = reference( captureKind_ );
+        ref.resize( n_ );
+        for ( size_t i = 0; i < n_; ++i )
+          ref[i] = float( captureSum_[i] / captureTotal_ );
+        captureSum_.clear();
+        derive();
+      }
+      return false;
+    }
+
+    correct( work_.data(), offset_.empty() ? 0 : offset_.data(),
+             gain_.empty() ? 0 : gain_.data(), frame_.data(), n_ );
+
+    if ( threshold_ > 0.f && w_ >= 5 )
+      for ( Int32 r = 0; r < h_; ++r ) {
+        float* line = &frame_[size_t( r ) * w_];
+        std::copy( line, line + w_, row_.begin() );
+        reject( row_.data(), line, w_, threshold_ );
+      }
+
+    const float* result = frame_.data();
+    if ( !tracks_.empty() ) {
+      std::fill( binned_.begin(), binned_.end(), 0.f );
+      for ( size_t t = 0; t < tracks_.size(); ++t )
+        for ( Int32 r = tracks_[t].first - 1; r < tracks_[t].second; ++r )
+          addRow( &frame_[size_t( r ) * w_], &binned_[t * w_], w_ );
+      result = binned_.data();
+    }
+
+    if ( acc_.empty() )
+      acc_.resize( n_ );
+    accumulate( result, acc_.data(), acc_.size(), accCount_ == 0 );
+    if ( ++accCount_ < accumulate_ )
+      return false;
+    accCount_ = 0;
+    return true;
+  }
+
+  /** Hands ready_ to the readers                                         */
+  void emit( Int32 epoch )
+  {
+    std::unique_lock<std::mutex> lk( m_ );
+    if ( keepAll_ )
+      outCv_.wait( lk, [this] { return outCount_ < kSlots || stop_; } );
+    if ( stop_ || epoch != epoch_ )
+      return;
+    if ( outCount_ == kSlots ) {
+      outHead_ = ( outHead_ + 1 ) % kSlots;
+      --outCount_;
+      ++dropped_;
+    }
+    Int32 slot = ( outHead_ + outCount_ ) % kSlots;
+    out_[slot].assign( ready_.begin(), ready_.end() );
+    outSeq_[slot] = ++results_;
+    latest_.assign( ready_.begin(), ready_.end() );
+    latestSeq_ = results_;
+    ++outCount_;
+    lk.unlock();
+    outCv_.notify_all();
+  }
+
+  const Int32  w_, h_;
+  const size_t n_;
+  const bool   keepAll_;
+
+  /* Worker state and configuration, guarded by cfg_ */
+  std::mutex                             cfg_;
+  std::vector<Int32>                     work_;
+  std::vector<float>                     frame_, row_, binned_;
+  std::vector<double>                    acc_;
+  std::vector<float>                     dark_, background_, flat_, offset_, gain_;
+  std::vector<std::pair<Int32, Int32> >  tracks_;
+  Int32                                  accumulate_, accCount_;
+  float                                  threshold_;
+  Int32                                  captureKind_, captureLeft_, captureTotal_;
+  std::vector<double>                    captureSum_;
+
+  /* Buffers, guarded by m_ */
+  std::mutex              m_, push_;
+  std::condition_variable inCv_, outCv_;
+  bool                    stop_;
+  std::vector<Int32>      in_[kSlots];
+  Int32                   inHead_, inCount_;
+  std::vector<double>     out_[kSlots], ready_, latest_;
+  Int32                   outSeq_[kSlots];
+  Int32                   outHead_, outCount_, epoch_;
+  Int32                   frames_, results_, dropped_, latestSeq_;
+  std::thread             thread_;
+};
+
+
+struct Registry {
+  std::mutex                                 m;
+  Int32                                      nextId = 1;
+  std::map<Int32, std::shared_ptr<Pipeline>> pipes;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Pipeline> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.pipes.find( handle );
+  return it == reg.pipes.end() ? std::shared_ptr<Pipeline>() : it->second;
+}
+
+bool validKind( Int32 kind )
+{
+  return kind == CCD_Dark || kind == CCD_Background || kind == CCD_Flat;
+}
+
+} // namespace
+
+
+Int32 CCD_API CCD_create( Int32 width, Int32 height, Bln32 keepAll, Int32* pipe )
+{
+  if ( width < 1 || height < 1 || !pipe )
+    return CCD_InvalidParam;
+  try {
+    std::shared_ptr<Pipeline> p = std::make_shared<Pipeline>( width, height, keepAll != 0 );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *pipe = reg.nextId++;
+    reg.pipes[*pipe] = p;
+    return CCD_Ok;
+  }
+  catch ( ... ) {
+    return CCD_Error;
+  }
+}
+
+
+Int32 CCD_API CCD_close( Int32 pipe )
+{
+  std::shared_ptr<Pipeline> p;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.pipes.find( pipe );
+    if ( it == reg.pipes.end() )
+      return CCD_NotConnected;
+    p = it->second;
+    reg.pipes.erase( it );
+  }
+  p->shutdown();
+  return CCD_Ok;   /* thread is joined when the last caller releases p */
+}
+
+
+Int32 CCD_API CCD_setReference( Int32 pipe, Int32 kind, const double* frame )
+{
+  if ( !validKind( kind ) )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  p->setReference( kind, frame );
+  return CCD_Ok;
+}
+
+
+Int32 CCD_API CCD_getReference( Int32 pipe, Int32 kind, double* frame )
+{
+  if ( !validKind( kind ) || !frame )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  return p->getReference( kind, frame ) ? CCD_Ok : CCD_NoData;
+}
+
+
+Int32 CCD_API CCD_captureReference( Int32 pipe, Int32 kind, Int32 frames )
+{
+  if ( !validKind( kind ) || frames < 1 )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  p->capture( kind, frames );
+  return CCD_Ok;
+}
+
+
+Int32 CCD_API CCD_setTracks( Int32 pipe, Int32 tracks, const Int32* rows )
+{
+  if ( tracks < 0 || ( tracks > 0 && !rows ) )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  Int32 height = Int32( p->pixels() / p->width() );
+  std::vector<std::pair<Int32, Int32> > t( tracks );
+  for ( Int32 k = 0; k < tracks; ++k ) {
+    t[k] = std::make_pair( rows[2 * k], rows[2 * k + 1] );
+    if ( t[k].first < 1 || t[k].first > t[k].second || t[k].second > height )
+      return CCD_InvalidParam;
+  }
+  p->setTracks( t );
+  return CCD_Ok;
+}
+
+
+Int32 CCD_API CCD_setAccumulate( Int32 pipe, Int32 frames )
+{
+  if ( frames < 1 )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  p->setAccumulate( frames );
+  return CCD_Ok;
+}
+
+
+Int32 CCD_API CCD_setCosmic( Int32 pipe, double threshold )
+{
+  if ( !( threshold >= 0. ) )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  p->setCosmic( threshold );
+  return CCD_Ok;
+}
+
+
+Int32 CCD_API CCD_resultSize( Int32 pipe, Int32* width, Int32* rows )
+{
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  if ( width )
+    *width = p->width();
+  if ( rows )
+    *rows = p->rows();
+  return CCD_Ok;
+}
+
+
+Int32 CCD_API CCD_push( Int32 pipe, const Int32* frame, Int32 timeout )
+{
+  if ( !frame || timeout < 0 )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  return p->push( frame, timeout );
+}
+
+
+Int32 CCD_API CCD_read( Int32 pipe,
+                        double* result,
+                        Int32 size,
+                        Int32 timeout,
+                        Int32* sequence )
+{
+  if ( !result || size < 0 || timeout < 0 )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  return p->read( result, size, timeout, sequence );
+}
+
+
+Int32 CCD_API CCD_latest( Int32 pipe, double* result, Int32 size, Int32* sequence )
+{
+  if ( !result || size < 0 )
+    return CCD_InvalidParam;
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  return p->latest( result, size, sequence );
+}
+
+
+Int32 CCD_API CCD_counters( Int32 pipe, Int32* frames, Int32* results, Int32* dropped )
+{
+  std::shared_ptr<Pipeline> p = find( pipe );
+  if ( !p )
+    return CCD_NotConnected;
+  p->counters( frames, results, dropped );
+  return CCD_Ok;
+}
@@ -0,0 +1,219 @@
+/******************************************************************/
+/** @file ccdpipe.h
+ *  CCD frame processing DLL
+ *
+ *  Native replacement for the per frame array work of
+ *  Andor_ProcessBckgnd.vi, Andor_ProcessData.vi and Andor_Acquire_Im.vi.
+ *  Raw frames as returned by GetAcquiredData / GetImages are pushed into
+ *  a pipeline which processes them on its own thread:
+ *    1. dark and background subtraction, flat field correction
+ *    2. cosmic ray rejection (optional)
+ *    3. binning of row ranges into tracks (optional)
+ *    4. accumulation of a number of frames (optional)
+ *  Input and output are double buffered, so the camera loop, the
+ *  processing and the display / saving loop run concurrently.
+ *
+ *  Frames are width * height pixels, row major, a row being one line of
+ *  the sensor along the dispersion direction.
+ */
+/******************************************************************/
+
+#ifndef __CCDPIPE_H__
+#define __CCDPIPE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define CCD_API
+#else
+#ifdef  DLL_EXPORT
+#define CCD_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define CCD_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define CCD_Ok                   0              /**< No error                              */
+#define CCD_Error              (-1)             /**< Unspecified error                     */
+#define CCD_NotConnected        -2              /**< Pipeline handle does not exist        */
+#define CCD_Timeout             -6              /**< No slot or result within the timeout  */
+#define CCD_InvalidParam        -9              /**< Parameter out of range                */
+#define CCD_BufferTooSmall     -10              /**< Output array too small                */
+#define CCD_NoData             -15              /**< Reference or result not available     */
+
+
+/** @brief  Reference frames                                                         */
+typedef enum {
+  CCD_Dark       = 0,                        /**< Raw frame with the shutter closed  */
+  CCD_Background = 1,                        /**< Dark subtracted background signal  */
+  CCD_Flat       = 2                         /**< Dark subtracted flat field         */
+} CCD_Reference;
+
+
+/** @brief Create a pipeline and start its thread
+ *
+ *  @param  width     Pixels per row
+ *  @param  height    Rows per frame
+ *  @param  keepAll   True: every result is kept until read, a slow reader
+ *                    stalls the pipeline (saving). False: unread results
+ *                    are overwritten by newer ones (live display).
+ *  @param  pipe      Output: pipeline handle
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_create( Int32 width, Int32 height, Bln32 keepAll, Int32* pipe );
+
+
+/** @brief Stop the thread and release a pipeline
+ *
+ *  @param  pipe      Pipeline handle
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_close( Int32 pipe );
+
+
+/** @brief Set or clear a reference frame
+ *
+ *  Settings take effect with the next frame processed.
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  kind      Reference, see @ref CCD_Reference
+ *  @param  frame     width * height values, NULL to clear the reference
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_setReference( Int32 pipe, Int32 kind, const double* frame );
+
+
+/** @brief Read back a reference frame
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  kind      Reference, see @ref CCD_Reference
+ *  @param  frame     Output: width * height values
+ *  @return           Result of function, @ref CCD_NoData if not set
+ */
+Int32 CCD_API CCD_getReference( Int32 pipe, Int32 kind, double* frame );
+
+
+/** @brief Record a reference from the next frames
+ *
+ *  The next @p frames frames pushed are averaged into the reference
+ *  instead of producing results. The dark is recorded from raw frames,
+ *  the background with the dark subtracted, the flat with dark and
+ *  background subtracted.
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  kind      Reference, see @ref CCD_Reference
+ *  @param  frames    Number of frames to average
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_captureReference( Int32 pipe, Int32 kind, Int32 frames );
+
+
+/** @brief Select row ranges to bin
+ *
+ *  Pending results are discarded since their size changes.
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  tracks    Number of tracks, 0 for the full image
+ *  @param  rows      2 * tracks row numbers: first and last row of each
+ *                    track, 1-based and inclusive as in SetRandomTracks
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_setTracks( Int32 pipe, Int32 tracks, const Int32* rows );
+
+
+/** @brief Sum a number of frames into each result
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  frames    Frames per result, 1 for none
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_setAccumulate( Int32 pipe, Int32 frames );
+
+
+/** @brief Cosmic ray rejection
+ *
+ *  A corrected pixel exceeding the median of itself and its two
+ *  neighbours on each side of the row by more than @p threshold counts
+ *  is replaced by that median.
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  threshold Threshold in counts, 0 to disable
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_setCosmic( Int32 pipe, double threshold );
+
+
+/** @brief Size of a result
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  width     Output: values per row (= frame width)
+ *  @param  rows      Output: tracks, or the frame height without tracks
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_resultSize( Int32 pipe, Int32* width, Int32* rows );
+
+
+/** @brief Queue a raw frame
+ *
+ *  Copies the frame into a free input buffer and returns.
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  frame     width * height counts
+ *  @param  timeout   Time to wait for a free input buffer [ms]
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_push( Int32 pipe, const Int32* frame, Int32 timeout );
+
+
+/** @brief Take the oldest unread result
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  result    Output: width * rows values
+ *  @param  size      Size of the result array
+ *  @param  timeout   Time to wait for a result [ms]
+ *  @param  sequence  Output: number of the result since creation,
+ *                    gaps show results overwritten before being read
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_read( Int32 pipe,
+                        double* result,
+                        Int32 size,
+                        Int32 timeout,
+                        Int32* sequence );
+
+
+/** @brief Copy the newest result without taking it
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  result    Output: width * rows values
+ *  @param  size      Size of the result array
+ *  @param  sequence  Output: number of the result since creation
+ *  @return           Result of function, @ref CCD_NoData before the first
+ */
+Int32 CCD_API CCD_latest( Int32 pipe, double* result, Int32 size, Int32* sequence );
+
+
+/** @brief Pipeline counters
+ *
+ *  @param  pipe      Pipeline handle
+ *  @param  frames    Output: frames processed
+ *  @param  results   Output: results produced
+ *  @param  dropped   Output: results overwritten before being read
+ *  @return           Result of function
+ */
+Int32 CCD_API CCD_counters( Int32 pipe, Int32* frames, Int32* results, Int32* dropped );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,425 @@
+/******************************************************************/
+/** @file specstitch.cpp
+ *  Wavelength calibration and spectral stitching DLL
+ *
+ *  Implementation of @ref specstitch.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "specstitch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define SPEC_SSE2
+#endif
+
+namespace {
+
+typedef std::vector<double>            Table;
+typedef std::shared_ptr<const Table>   TablePtr;
+typedef std::pair<Int32, long long>    Position;   /**< grating, centre [pm] */
+
+const size_t kMaxCached = 512;          /**< computed tables kept per detector */
+
+Position position( Int32 grating, double centre )
+{
+  return Position( grating, std::llround( centre * 1000. ) );
+}
+
+bool monotonic( const Table& t )
+{
+  if ( t.size() < 2 )
+    return false;
+  bool up = t[1] > t[0];
+  for ( size_t p = 1; p < t.size(); ++p )
+    if ( up ? !( t[p] > t[p - 1] ) : !( t[p] < t[p - 1] ) )
+      return false;
+  return true;
+}
+
+
+/* ----- Calibration ---------------------------------------------------------- */
+
+class Calibration
+{
+public:
+  explicit Calibration( Int32 pixels ) : pixels_( pixels ) {}
+
+  Int32 pixels() const { return pixels_; }
+
+  void setDispersion( Int32 grating, double centrePixel, const double* coeffs, Int32 order )
+  {
+    std::lock_guard<std::mutex> lk( m_ );
+    Dispersion& d = dispersion_[grating];
+    d.centrePixel = centrePixel;
+    d.coeffs.assign( coeffs, coeffs + order );
+    for ( auto it = cached_.begin(); it != cached_.end(); )
+      it = it->first.first == grating ? cached_.erase( it ) : std::next( it );
+  }
+
+  void setTable( const Position& pos, TablePtr table )
+  {
+    std::lock_guard<std::mutex> lk( m_ );
+    if ( table )
+      explicit_[pos] = table;
+    else
+      explicit_.erase( pos );
+  }
+
+  /** Table for a grating position, computed on first use. Returns an empty
+   *  pointer if the grating is not calibrated or the table is not monotonic. */
+  TablePtr table( Int32 grating, double centre )
+  {
+    Position pos = position( grating, centre );
+    std::lock_guard<std::mutex> lk( m_ );
+    auto ex = explicit_.find( pos );
+    if ( ex != explicit_.end() )
+      return ex->second;
+    auto ca = cached_.find( pos );
+    if ( ca != cached_.end() )
+      return ca->second;
+    auto di = dispersion_.find( grating );
+    if ( di == dispersion_.end() )
+      return TablePtr();
+
+    std::shared_ptr<Table> t = std::make_shared<Table>( pixels_ );
+    const Dispersion& d = di->second;
+    for ( Int32 p = 0; p < pixels_; ++p ) {
+      double x = p - d.centrePixel, v = 0.;
+      for ( size_t k = d.coeffs.size(); k > 0; --k )
+        v = ( v + d.coeffs[k - 1] ) * x;
+      ( *t )[p] = centre + v;
+    }
+    if ( !monotonic( *t ) )
+      return TablePtr();
+    if ( cached_.size() >= kMaxCached )
+      cached_.clear();
+    cached_[pos] = t;
+    return t;
+  }
+
+private:
+  struct Dispersion {
+    double              centrePixel;
+    std::vector<double> coeffs;
+  };
+
+  const Int32                   pixels_;
+  std::mutex                    m_;
+  std::map<Int32, Dispersion>   dispersion_;
+  std::map<Position, TablePtr>  explicit_;
+  std::map<Position, TablePtr>  cached_;
+};
+
+
+/* ----- Stitching ------------------------------------------------------------ */
+
+/** Resampling of one window onto the axis: point first + k takes
+ *  s[i0] + frac * ( s[i1] - s[i0] ) with the given weight.              */
+struct Plan {
+  TablePtr            table;          /**< table the plan was built from */
+  Int32               first;
+  std::vector<Int32>  i0, i1;
+  std::vector<double> frac, weight;
+};
+
+class Stitch
+{
+public:
+  Stitch( double first, double step, Int32 size, double taper )
+    : first_( first ), step_( step ), taper_( taper ), sum_( size, 0. ), weight_( size, 0. ) {}
+
+  std::mutex m;
+
+  Int32 size() const { return Int32( sum_.size() ); }
+
+  void reset()
+  {
+    std::fill( sum_.begin(), sum_.end(), 0. );
+    std::fill( weight_.begin(), weight_.end(), 0. );
+  }
+
+  void add( Int32 cal, const Position& pos, const TablePtr& table, const double* s )
+  {
+    Plan& plan = plans_[std::make_pair( cal, pos )];
+    if ( plan.table != table )
+      build( plan, table );
+
+    size_t n = plan.i0.size(), k = 0;
+    double* sum = &sum_[0] + plan.first;
+    double* wgt = &weight_[0] + plan.first;
+#ifdef SPEC_SSE2
+    for ( ; k + 2 <= n; k += 2 ) {
+      __m128d a = _mm_set_pd( s[plan.i0[k + 1]], s[plan.i0[k]] );
+      __m128d b = _mm_set_pd( s[plan.i1[k + 1]], s[plan.i1[k]] );
+      __m128d f = _mm_loadu_pd( &plan.frac[k] );
+      __m128d w = _mm_loadu_pd( &plan.weight[k] );
+      __m128d v = _mm_add_pd( a, _mm_mul_pd( f, _mm_sub_pd( b, a ) ) );
+      _mm_storeu_pd( sum + k, _mm_add_pd( _mm_loadu_pd( sum + k ), _mm_mul_pd( w, v ) ) );
+      _mm_storeu_pd( wgt + k, _mm_add_pd( _mm_loadu_pd( wgt + k ), w ) );
+    }
+#endif
+    for ( ; k < n; ++k ) {
+      double a = s[plan.i0[k]], b = s[plan.i1[k]];
+      sum[k] += plan.weight[k] * ( a + plan.frac[k] * ( b - a ) );
+      wgt[k] += plan.weight[k];
+    }
+  }
+
+  void result( double* axis, double* values, double* weights ) const
+  {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for ( size_t k = 0; k < sum_.size(); ++k ) {
+      if ( axis )
+        axis[k] = first_ + double( k ) * step_;
+      values[k] = weight_[k] > 0. ? sum_[k] / weight_[k] : nan;
+      if ( weights )
+        weights[k] = weight_[k];
+    }
+  }
+
+private:
+  /** Walks axis and table together; the table may run either way        */
+  void build( Plan& plan, const TablePtr& table )
+  {
+    const Table& t  = *table;
+    const Int32  np = Int32( t.size() );
+    const bool   up = t[np - 1] > t[0];
+    auto at = [&]( Int32 j ) { return up ? j : np - 1 - j; };   /* j-th pixel by wavelength */
+
+    double lo = t[at( 0 )], hi = t[at( np - 1 )];
+    Int32  k0 = Int32( std::min<double>( size(), std::max( 0., std::ceil( ( lo - first_ ) / step_ ) ) ) );
+    Int32  k1 = Int32( std::max( -1., std::min<double>( size() - 1, std::floor( ( hi - first_ ) / step_ ) ) ) );
+
+    plan.table = table;
+    plan.first = k0;
+    plan.i0.clear(); plan.i1.clear(); plan.frac.clear(); plan.weight.clear();
+    Int32 j = 0;
+    for ( Int32 k = k0; k <= k1; ++k ) {
+      double x = first_ + double( k ) * step_;
+      while ( j + 2 < np && t[at( j + 1 )] < x )
+        ++j;
+      double f  = ( x - t[at( j )] ) / ( t[at( j + 1 )] - t[at( j )] );
+      f = std::min( 1., std::max( 0., f ) );
+      double pf = up ? j + f : np - 1 - ( j + f );
+      double w  = taper_ > 0. ? std::min( 1., ( std::min( pf, np - 1 - pf ) + 1. ) / ( taper_ + 1. ) ) : 1.;
+      plan.i0.push_back( at( j ) );
+      plan.i1.push_back( at( j + 1 ) );
+      plan.frac.push_back( f );
+      plan.weight.push_back( w );
+    }
+  }
+
+  const double                                   first_, step_, taper_;
+  std::vector<double>                            sum_, weight_;
+  std::map<std::pair<Int32, Position>, Plan>     plans_;
+};
+
+
+struct Registry {
+  std::mutex                                    m;
+  Int32                                         nextId = 1;
+  std::map<Int32, std::shared_ptr<Calibration>> cals;
+  std::map<Int32, std::shared_ptr<Stitch>>      stitches;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+template <class T>
+std::shared_ptr<T> find( std::map<Int32, std::shared_ptr<T>>& map, Int32 id )
+{
+  std::lock_guard<std::mutex> lk( registry().m );
+  auto it = map.find( id );
+  return it == map.end() ? std::shared_ptr<T>() : it->second;
+}
+
+} // namespace
+
+
+Int32 SPEC_API SPEC_create( Int32 pixels, Int32* cal )
+{
+  if ( pixels < 2 || !cal )
+    return SPEC_InvalidParam;
+  try {
+    std::shared_ptr<Calibration> c = std::make_shared<Calibration>( pixels );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *cal = reg.nextId++;
+    reg.cals[*cal] = c;
+    return SPEC_Ok;
+  }
+  catch ( ... ) {
+    return SPEC_Error;
+  }
+}
+
+
+Int32 SPEC_API SPEC_close( Int32 cal )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.cals.erase( cal ) ? SPEC_Ok : SPEC_NotConnected;
+}
+
+
+Int32 SPEC_API SPEC_setDispersion( Int32 cal,
+                                   Int32 grating,
+                                   double centrePixel,
+                                   Int32 order,
+                                   const double* coeffs )
+{
+  if ( order < 1 || order > SPEC_MAX_ORDER || !coeffs )
+    return SPEC_InvalidParam;
+  std::shared_ptr<Calibration> c = find( registry().cals, cal );
+  if ( !c )
+    return SPEC_NotConnected;
+  c->setDispersion( grating, centrePixel, coeffs, order );
+  return SPEC_Ok;
+}
+
+
+Int32 SPEC_API SPEC_setTable( Int32 cal, Int32 grating, double centre, const double* table )
+{
+  std::shared_ptr<Calibration> c = find( registry().cals, cal );
+  if ( !c )
+    return SPEC_NotConnected;
+  TablePtr t;
+  if ( table ) {
+    std::shared_ptr<Table> copy = std::make_shared<Table>( table, table + c->pixels() );
+    if ( !monotonic( *copy ) )
+      return SPEC_InvalidParam;
+    t = copy;
+  }
+  c->setTable( position( grating, centre ), t );
+  return SPEC_Ok;
+}
+
+
+Int32 SPEC_API SPEC_wavelengths( Int32 cal, Int32 grating, double centre, double* table )
+{
+  if ( !table )
+    return SPEC_InvalidParam;
+  std::shared_ptr<Calibration> c = find( registry().cals, cal );
+  if ( !c )
+    return SPEC_NotConnected;
+  TablePtr t = c->table( grating, centre );
+  if ( !t )
+    return SPEC_NoData;
+  std::copy( t->begin(), t->end(), table );
+  return SPEC_Ok;
+}
+
+
+Int32 SPEC_API SPEC_createStitch( double first,
+                                  double last,
+                                  double step,
+                                  double taper,
+                                  Int32* stitch )
+{
+  if ( !( step > 0. ) || !( last >= first ) || !( taper >= 0. ) || !stitch )
+    return SPEC_InvalidParam;
+  double points = std::floor( ( last - first ) / step + 1e-9 ) + 1.;
+  if ( points > 1e8 )
+    return SPEC_InvalidParam;
+  try {
+    std::shared_ptr<Stitch> s = std::make_shared<Stitch>( first, step, Int32( points ), taper );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *stitch = reg.nextId++;
+    reg.stitches[*stitch] = s;
+    return SPEC_Ok;
+  }
+  catch ( ... ) {
+    return SPEC_Error;
+  }
+}
+
+
+Int32 SPEC_API SPEC_closeStitch( Int32 stitch )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.stitches.erase( stitch ) ? SPEC_Ok : SPEC_NotConnected;
+}
+
+
+Int32 SPEC_API SPEC_resetStitch( Int32 stitch )
+{
+  std::shared_ptr<Stitch> s = find( registry().stitches, stitch );
+  if ( !s )
+    return SPEC_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  s->reset();
+  return SPEC_Ok;
+}
+
+
+Int32 SPEC_API SPEC_addWindow( Int32 stitch,
+                               Int32 cal,
+                               Int32 grating,
+                               double centre,
+                               const double* spectrum )
+{
+  if ( !spectrum )
+    return SPEC_InvalidParam;
+  std::shared_ptr<Stitch>      s = find( registry().stitches, stitch );
+  std::shared_ptr<Calibration> c = find( registry().cals, cal );
+  if ( !s || !c )
+    return SPEC_NotConnected;
+  TablePtr t = c->table( grating, centre );
+  if ( !t )
+    return SPEC_NoData;
+  try {
+    std::lock_guard<std::mutex> lk( s->m );
+    s->add( cal, position( grating, centre ), t, spectrum );
+    return SPEC_Ok;
+  }
+  catch ( ... ) {
+    return SPEC_Error;
+  }
+}
+
+
+Int32 SPEC_API SPEC_stitchSize( Int32 stitch, Int32* size )
+{
+  if ( !size )
+    return SPEC_InvalidParam;
+  std::shared_ptr<Stitch> s = find( registry().stitches, stitch );
+  if ( !s )
+    return SPEC_NotConnected;
+  *size = s->size();
+  return SPEC_Ok;
+}
+
+
+Int32 SPEC_API SPEC_result( Int32 stitch,
+                            double* axis,
+                            double* values,
+                            double* weights,
+                            Int32 size )
+{
+  if ( !values )
+    return SPEC_InvalidParam;
+  std::shared_ptr<Stitch> s = find( registry().stitches, stitch );
+  if ( !s )
+    return SPEC_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  if ( size < s->size() )
+    return SPEC_BufferTooSmall;
+  s->result( axis, values, weights );
+  return SPEC_Ok;
+}
@@ -0,0 +1,193 @@
+/******************************************************************/
+/** @file specstitch.h
+ *  Wavelength calibration and spectral stitching DLL
+ *
+ *  Calibration: a pixel to wavelength table per grating and centre
+ *  wavelength, computed once from the grating's dispersion polynomial
+ *  or taken from the spectrograph (ShamrockGetCalibration) and cached,
+ *  replacing the per frame polynomial of Andor_Wavelenght_Conv.vi.
+ *
+ *  Stitching: spectra taken at successive grating positions (Shamrock,
+ *  Triax320 SetPosition.vi) are resampled onto one common, uniform
+ *  wavelength axis as they arrive. Overlapping windows are blended
+ *  with weights falling off towards each window edge, so the merged
+ *  spectrum is complete as soon as the last window has been added.
+ */
+/******************************************************************/
+
+#ifndef __SPECSTITCH_H__
+#define __SPECSTITCH_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define SPEC_API
+#else
+#ifdef  DLL_EXPORT
+#define SPEC_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define SPEC_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define SPEC_Ok                  0              /**< No error                              */
+#define SPEC_Error             (-1)             /**< Unspecified error                     */
+#define SPEC_NotConnected       -2              /**< Handle does not exist                 */
+#define SPEC_InvalidParam       -9              /**< Parameter out of range                */
+#define SPEC_BufferTooSmall    -10              /**< Output array too small                */
+#define SPEC_NoData            -15              /**< Grating not calibrated                */
+
+#define SPEC_MAX_ORDER           5              /**< Highest dispersion polynomial order   */
+
+
+/** @brief Create a calibration cache for a detector
+ *
+ *  @param  pixels    Pixels along the dispersion direction
+ *  @param  cal       Output: calibration handle
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_create( Int32 pixels, Int32* cal );
+
+
+/** @brief Release a calibration cache
+ *
+ *  @param  cal       Calibration handle
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_close( Int32 cal );
+
+
+/** @brief Dispersion of a grating
+ *
+ *  wavelength(p) = centre + sum_k coeffs[k-1] * ( p - centrePixel )^k,
+ *  k = 1 .. order, p the 0-based pixel. Tables cached for this grating
+ *  are recomputed on the next use.
+ *
+ *  @param  cal          Calibration handle
+ *  @param  grating      Grating number
+ *  @param  centrePixel  Pixel at the centre wavelength
+ *  @param  order        Polynomial order, 1 .. @ref SPEC_MAX_ORDER
+ *  @param  coeffs       order coefficients [nm / pixel^k]
+ *  @return              Result of function
+ */
+Int32 SPEC_API SPEC_setDispersion( Int32 cal,
+                                   Int32 grating,
+                                   double centrePixel,
+                                   Int32 order,
+                                   const double* coeffs );
+
+
+/** @brief Explicit table for one grating position
+ *
+ *  Takes precedence over the dispersion polynomial, e.g. the table
+ *  returned by ShamrockGetCalibration.
+ *
+ *  @param  cal       Calibration handle
+ *  @param  grating   Grating number
+ *  @param  centre    Centre wavelength [nm], matched to 1 pm
+ *  @param  table     Wavelength of each pixel [nm], strictly monotonic,
+ *                    NULL to remove the table
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_setTable( Int32 cal, Int32 grating, double centre, const double* table );
+
+
+/** @brief Wavelength of each pixel
+ *
+ *  @param  cal       Calibration handle
+ *  @param  grating   Grating number
+ *  @param  centre    Centre wavelength [nm]
+ *  @param  table     Output: wavelength of each pixel [nm]
+ *  @return           Result of function, @ref SPEC_NoData if the grating
+ *                    has neither a table nor a dispersion
+ */
+Int32 SPEC_API SPEC_wavelengths( Int32 cal, Int32 grating, double centre, double* table );
+
+
+/** @brief Create a stitched spectrum
+ *
+ *  @param  first     First wavelength of the common axis [nm]
+ *  @param  last      Last wavelength of the common axis [nm]
+ *  @param  step      Axis step [nm]
+ *  @param  taper     Pixels over which the weight of a window rises from
+ *                    its edges, 0 for equal weights
+ *  @param  stitch    Output: stitch handle
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_createStitch( double first,
+                                  double last,
+                                  double step,
+                                  double taper,
+                                  Int32* stitch );
+
+
+/** @brief Release a stitched spectrum
+ *
+ *  @param  stitch    Stitch handle
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_closeStitch( Int32 stitch );
+
+
+/** @brief Clear the data, keeping axis and resampling plans for the next scan
+ *
+ *  @param  stitch    Stitch handle
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_resetStitch( Int32 stitch );
+
+
+/** @brief Add a window
+ *
+ *  @param  stitch    Stitch handle
+ *  @param  cal       Calibration handle
+ *  @param  grating   Grating number
+ *  @param  centre    Centre wavelength the spectrum was taken at [nm]
+ *  @param  spectrum  One value per pixel of the calibration
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_addWindow( Int32 stitch,
+                               Int32 cal,
+                               Int32 grating,
+                               double centre,
+                               const double* spectrum );
+
+
+/** @brief Number of points of the common axis
+ *
+ *  @param  stitch    Stitch handle
+ *  @param  size      Output: number of points
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_stitchSize( Int32 stitch, Int32* size );
+
+
+/** @brief Merged spectrum
+ *
+ *  @param  stitch    Stitch handle
+ *  @param  axis      Output: wavelengths (may be NULL)
+ *  @param  values    Output: values, NaN where no window covers the axis
+ *  @param  weights   Output: sum of the window weights (may be NULL)
+ *  @param  size      Size of the output arrays
+ *  @return           Result of function
+ */
+Int32 SPEC_API SPEC_result( Int32 stitch,
+                            double* axis,
+                            double* values,
+                            double* weights,
+                            Int32 size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,167 @@
+/******************************************************************/
+/** @file ag34410burst.cpp
+ *  Agilent 34410A burst acquisition DLL
+ *
+ *  Implementation of @ref ag34410burst.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "ag34410burst.h"
+#include "ioschedule.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+/** Writes a command and waits until it has left the port                 */
+Int32 command( Int32 instrument, const char* cmd )
+{
+  Int32 ticket = 0, len = 0;
+  Int32 r = IOS_write( instrument, cmd, &ticket );
+  return r != IOS_Ok ? r : IOS_wait( ticket, -1, 0, 0, &len );
+}
+
+Int32 query( Int32 instrument, const char* cmd, std::string& reply )
+{
+  char  buf[128];
+  Int32 len = 0;
+  Int32 r   = IOS_queryWait( instrument, cmd, buf, sizeof buf, &len );
+  if ( r == IOS_Ok )
+    reply.assign( buf, size_t( len ) );
+  return r;
+}
+
+/** SENS:FUNC? answers e.g. "VOLT" or "CURR:AC" with quotes; the aperture
+ *  command uses the same prefix.                                           */
+Int32 function( Int32 instrument, std::string& func )
+{
+  std::string reply;
+  Int32 r = query( instrument, "SENS:FUNC?\n", reply );
+  if ( r != IOS_Ok )
+    return r;
+  func.clear();
+  for ( char c : reply )
+    if ( c != '"' && c != '\n' && c != '\r' )
+      func += c;
+  return func.empty() ? AG34410_Error : AG34410_Ok;
+}
+
+} // namespace
+
+
+Int32 AG34410_API AG34410_configureBurst( Int32 instrument, const AG34410_Burst* burst )
+{
+  if ( !burst || burst->sampleCount < 1 || burst->sampleCount > AG34410_MAX_READINGS ||
+       burst->triggerCount < 0 || burst->aperture < 0. || burst->sampleTimer < 0. )
+    return AG34410_InvalidParam;
+
+  static const char* const sources[] = { "IMM", "BUS", "EXT" };
+  if ( burst->trigger < AG34410_trigImmediate || burst->trigger > AG34410_trigExternal )
+    return AG34410_InvalidParam;
+
+  char cmd[256];
+  std::snprintf( cmd, sizeof cmd, "FORM:DATA REAL,64;:FORM:BORD NORM;:TRIG:SOUR %s;:SAMP:COUN %d\n",
+                 sources[burst->trigger], burst->sampleCount );
+  Int32 r = command( instrument, cmd );
+  if ( r != IOS_Ok )
+    return r;
+
+  if ( burst->triggerCount > 0 )
+    std::snprintf( cmd, sizeof cmd, "TRIG:COUN %d\n", burst->triggerCount );
+  else
+    std::snprintf( cmd, sizeof cmd, "TRIG:COUN INF\n" );
+  if ( ( r = command( instrument, cmd ) ) != IOS_Ok )
+    return r;
+
+  if ( burst->sampleTimer > 0. )
+    std::snprintf( cmd, sizeof cmd, "SAMP:SOUR TIM;:SAMP:TIM %.9g\n", burst->sampleTimer );
+  else
+    std::snprintf( cmd, sizeof cmd, "SAMP:SOUR IMM\n" );
+  if ( ( r = command( instrument, cmd ) ) != IOS_Ok )
+    return r;
+
+  if ( burst->aperture > 0. ) {
+    std::string func;
+    if ( ( r = function( instrument, func ) ) != IOS_Ok )
+      return r;
+    std::snprintf( cmd, sizeof cmd, "%s:APER %.9g\n", func.c_str(), burst->aperture );
+    r = command( instrument, cmd );
+  }
+  return r;
+}
+
+
+Int32 AG34410_API AG34410_start( Int32 instrument )
+{
+  return command( instrument, "INIT\n" );
+}
+
+
+Int32 AG34410_API AG34410_trigger( Int32 instrument )
+{
+  return command( instrument, "*TRG\n" );
+}
+
+
+Int32 AG34410_API AG34410_available( Int32 instrument, Int32* count )
+{
+  if ( !count )
+    return AG34410_InvalidParam;
+  std::string reply;
+  Int32 r = query( instrument, "DATA:POIN?\n", reply );
+  if ( r == IOS_Ok )
+    *count = Int32( std::strtol( reply.c_str(), 0, 10 ) );
+  return r;
+}
+
+
+Int32 AG34410_API AG34410_read( Int32 instrument,
+                                double* values,
+                                Int32 size,
+                                Int32* count )
+{
+  if ( !count || size < 1 || !values )
+    return AG34410_InvalidParam;
+  *count = 0;
+
+  char cmd[64];
+  std::snprintf( cmd, sizeof cmd, "R? %d\n", size );
+  Int32 ticket = 0, len = 0;
+  Int32 r = IOS_queryBinary( instrument, cmd, -1, &ticket );
+  if ( r != IOS_Ok )
+    return r;
+  r = IOS_wait( ticket, -1, reinterpret_cast<char*>( values ), 8 * size, &len );
+  if ( r == IOS_BufferTooSmall )
+    IOS_release( ticket );
+  if ( r != IOS_Ok )
+    return r;
+  if ( len % 8 )
+    return AG34410_Error;
+
+  *count = len / 8;
+  AG34410_decodeReal64( reinterpret_cast<const unsigned char*>( values ), *count, 0, values );
+  return AG34410_Ok;
+}
+
+
+void AG34410_API AG34410_decodeReal64( const unsigned char* raw,
+                                       Int32 n,
+                                       Bln32 swapped,
+                                       double* out )
+{
+  for ( Int32 k = 0; k < n; ++k, raw += 8 ) {
+    uint64_t u = 0;
+    if ( swapped )
+      for ( int b = 7; b >= 0; --b )
+        u = ( u << 8 ) | raw[b];
+    else
+      for ( int b = 0; b < 8; ++b )
+        u = ( u << 8 ) | raw[b];
+    std::memcpy( out + k, &u, 8 );
+  }
+}
@@ -0,0 +1,140 @@
+/******************************************************************/
+/** @file ag34410burst.h
+ *  Agilent 34410A burst acquisition DLL
+ *
+ *  Programs the 34410A for burst measurements (sample count, trigger
+ *  source and count, aperture, sample timer) that are stored in the
+ *  instrument's reading memory, then downloads the memory in binary
+ *  REAL,64 blocks. The big endian readings are swapped in bulk straight
+ *  into the caller's array.
+ *
+ *  The measurement function and range stay those selected with the
+ *  existing Agilent34410A Set*.vi. Communication goes through an
+ *  instrument opened with the I/O scheduler (see ioschedule.h); its
+ *  error codes are passed through unchanged.
+ */
+/******************************************************************/
+
+#ifndef __AG34410BURST_H__
+#define __AG34410BURST_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define AG34410_API
+#else
+#ifdef  DLL_EXPORT
+#define AG34410_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define AG34410_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define AG34410_Ok               0              /**< No error                              */
+#define AG34410_Error          (-1)             /**< Unspecified error                     */
+#define AG34410_InvalidParam    -9              /**< Parameter out of range                */
+
+#define AG34410_MAX_READINGS 50000              /**< Reading memory without MEM option     */
+
+
+/** @brief  Trigger source, as in Agilent34410A Set TrigSource.vi                     */
+typedef enum {
+  AG34410_trigImmediate = 0,                 /**< TRIG:SOUR IMM                      */
+  AG34410_trigBus       = 1,                 /**< TRIG:SOUR BUS, see @ref AG34410_trigger */
+  AG34410_trigExternal  = 2                  /**< TRIG:SOUR EXT                      */
+} AG34410_TrigSource;
+
+
+/** @brief  Burst settings                                                          */
+typedef struct {
+  Int32              sampleCount;            /**< Readings per trigger [1..50000]    */
+  Int32              triggerCount;           /**< Triggers accepted, 0 for infinite  */
+  AG34410_TrigSource trigger;                /**< Trigger source                     */
+  double             aperture;               /**< Integration time in s, 0 keeps NPLC */
+  double             sampleTimer;            /**< Sample period in s, 0 samples as
+                                                  fast as the aperture allows       */
+} AG34410_Burst;
+
+
+/** @brief Configure a burst
+ *
+ *  Selects binary REAL,64 transfers and programs trigger and sample
+ *  settings for the active measurement function.
+ *
+ *  @param  instrument  Instrument handle from IOS_openInstrument
+ *  @param  burst       Burst settings
+ *  @return             Result of function
+ */
+Int32 AG34410_API AG34410_configureBurst( Int32 instrument, const AG34410_Burst* burst );
+
+
+/** @brief Arm the burst (INIT)
+ *
+ *  Clears the reading memory; readings accumulate there until fetched.
+ *
+ *  @param  instrument  Instrument handle
+ *  @return             Result of function
+ */
+Int32 AG34410_API AG34410_start( Int32 instrument );
+
+
+/** @brief Software trigger (*TRG) for @ref AG34410_trigBus
+ *
+ *  @param  instrument  Instrument handle
+ *  @return             Result of function
+ */
+Int32 AG34410_API AG34410_trigger( Int32 instrument );
+
+
+/** @brief Number of readings waiting in memory (DATA:POIN?)
+ *
+ *  @param  instrument  Instrument handle
+ *  @param  count       Output: number of readings
+ *  @return             Result of function
+ */
+Int32 AG34410_API AG34410_available( Int32 instrument, Int32* count );
+
+
+/** @brief Download and remove readings from memory (R?)
+ *
+ *  Readings are received as one REAL,64 block directly into values and
+ *  byte swapped in place. Can be called while the burst is running.
+ *
+ *  @param  instrument  Instrument handle
+ *  @param  values      Output: readings in measurement units
+ *  @param  size        Maximum number of readings to fetch
+ *  @param  count       Output: number of readings written
+ *  @return             Result of function
+ */
+Int32 AG34410_API AG34410_read( Int32 instrument,
+                                double* values,
+                                Int32 size,
+                                Int32* count );
+
+
+/** @brief Decode REAL,64 readings
+ *
+ *  @param  raw      8 bytes per reading
+ *  @param  n        Number of readings
+ *  @param  swapped  0: big endian (FORM:BORD NORM); 1: little endian (SWAP)
+ *  @param  out      Output: readings (may alias raw)
+ */
+void AG34410_API AG34410_decodeReal64( const unsigned char* raw,
+                                       Int32 n,
+                                       Bln32 swapped,
+                                       double* out );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,252 @@
+/******************************************************************/
+/** @file ctrrate.cpp
+ *  DAQ6363 counter rate DLL
+ *
+ *  Implementation of @ref ctrrate.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "ctrrate.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define CTR_SSE2
+#endif
+
+namespace {
+
+typedef unsigned long long UInt64;
+
+/** d[k] = raw[k] - raw[k - 1] modulo 2^32, raw[-1] = prev               */
+void difference( const UInt32* raw, Int32 n, UInt32 prev, UInt32* d )
+{
+  if ( n < 1 )
+    return;
+  d[0] = raw[0] - prev;
+  Int32 k = 1;
+#ifdef CTR_SSE2
+  for ( ; k + 4 <= n; k += 4 ) {
+    __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( raw + k ) );
+    __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( raw + k - 1 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( d + k ), _mm_sub_epi32( a, b ) );
+  }
+#endif
+  for ( ; k < n; ++k )
+    d[k] = raw[k] - raw[k - 1];
+}
+
+/** out[k] = d[k] * scale                                                 */
+void scale( const UInt32* d, Int32 n, double s, double* out )
+{
+  Int32 k = 0;
+#ifdef CTR_SSE2
+  /* no unsigned conversion in SSE2: flip the sign bit, convert, add 2^31 */
+  const __m128i bias = _mm_set1_epi32( int( 0x80000000u ) );
+  const __m128d off  = _mm_set1_pd( 2147483648. );
+  const __m128d sv   = _mm_set1_pd( s );
+  for ( ; k + 4 <= n; k += 4 ) {
+    __m128i v  = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( d + k ) ), bias );
+    __m128d lo = _mm_add_pd( _mm_cvtepi32_pd( v ), off );
+    __m128d hi = _mm_add_pd( _mm_cvtepi32_pd( _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) ), off );
+    _mm_storeu_pd( out + k, _mm_mul_pd( lo, sv ) );
+    _mm_storeu_pd( out + k + 2, _mm_mul_pd( hi, sv ) );
+  }
+#endif
+  for ( ; k < n; ++k )
+    out[k] = double( d[k] ) * s;
+}
+
+UInt64 sum( const UInt32* d, Int32 n )
+{
+  UInt64 s = 0;
+  for ( Int32 k = 0; k < n; ++k )
+    s += d[k];
+  return s;
+}
+
+
+struct Counter {
+  UInt32 last  = 0;
+  UInt64 total = 0;
+  UInt64 bin   = 0;      /**< counts of the partial bin                  */
+};
+
+class Rates
+{
+public:
+  Rates( Int32 counters, double gateTime, Int32 binLength )
+    : gate( gateTime ), binSize( binLength ), ch( counters ), fill_( 0 ) {}
+
+  std::mutex  m;
+  const double gate;
+  const Int32  binSize;
+
+  void reset( UInt32 initial )
+  {
+    for ( Counter& c : ch ) {
+      c      = Counter();
+      c.last = initial;
+    }
+    fill_ = 0;
+  }
+
+  /** Bins completed by n more samples                                    */
+  Int32 completed( Int32 n ) const { return binSize ? ( fill_ + n ) / binSize : 0; }
+
+  void process( const UInt32* raw, Int32 n, double* rates, double* bins, Int32 size )
+  {
+    if ( diff_.size() < size_t( n ) )
+      diff_.resize( n );
+    UInt32*      d    = diff_.data();
+    const double perS = 1. / gate;
+    const double perB = binSize ? 1. / ( binSize * gate ) : 0.;
+    Int32        fill = fill_;
+    for ( size_t c = 0; c < ch.size(); ++c ) {
+      Counter&      cc = ch[c];
+      const UInt32* r  = raw + c * size_t( n );
+      difference( r, n, cc.last, d );
+      cc.last = r[n - 1];
+      if ( rates )
+        scale( d, n, perS, rates + c * size_t( n ) );
+      if ( !binSize ) {
+        cc.total += sum( d, n );
+        continue;
+      }
+      double* out = bins + c * size_t( size );
+      fill        = fill_;
+      for ( Int32 k = 0; k < n; ) {
+        Int32  take = std::min( binSize - fill, n - k );
+        UInt64 s    = sum( d + k, take );
+        cc.total += s;
+        cc.bin   += s;
+        fill     += take;
+        k        += take;
+        if ( fill == binSize ) {
+          *out++ = double( cc.bin ) * perB;
+          cc.bin = 0;
+          fill   = 0;
+        }
+      }
+    }
+    if ( binSize )
+      fill_ = fill;
+  }
+
+  std::vector<Counter> ch;
+
+private:
+  Int32               fill_;     /**< samples in the partial bins        */
+  std::vector<UInt32> diff_;
+};
+
+
+struct Registry {
+  std::mutex                              m;
+  Int32                                   nextId = 1;
+  std::map<Int32, std::shared_ptr<Rates>> states;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Rates> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.states.find( handle );
+  return it == reg.states.end() ? std::shared_ptr<Rates>() : it->second;
+}
+
+} // namespace
+
+
+Int32 CTR_API CTR_create( Int32 counters, double gate, Int32 binSize, Int32* handle )
+{
+  if ( counters < 1 || !( gate > 0. ) || binSize < 0 || !handle )
+    return CTR_InvalidParam;
+  try {
+    std::shared_ptr<Rates> r = std::make_shared<Rates>( counters, gate, binSize );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *handle = reg.nextId++;
+    reg.states[*handle] = r;
+    return CTR_Ok;
+  }
+  catch ( ... ) {
+    return CTR_Error;
+  }
+}
+
+
+Int32 CTR_API CTR_close( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.states.erase( handle ) ? CTR_Ok : CTR_NotConnected;
+}
+
+
+Int32 CTR_API CTR_reset( Int32 handle, UInt32 initial )
+{
+  std::shared_ptr<Rates> r = find( handle );
+  if ( !r )
+    return CTR_NotConnected;
+  std::lock_guard<std::mutex> lk( r->m );
+  r->reset( initial );
+  return CTR_Ok;
+}
+
+
+Int32 CTR_API CTR_process( Int32 handle,
+                           const UInt32* raw,
+                           Int32 samples,
+                           double* rates,
+                           double* bins,
+                           Int32 size,
+                           Int32* count )
+{
+  if ( !raw || samples < 0 || size < 0 )
+    return CTR_InvalidParam;
+  std::shared_ptr<Rates> r = find( handle );
+  if ( !r )
+    return CTR_NotConnected;
+  std::lock_guard<std::mutex> lk( r->m );
+  Int32 done = r->completed( samples );
+  if ( done > 0 && ( !bins || size < done ) )
+    return CTR_BufferTooSmall;
+  if ( samples > 0 ) {
+    try {
+      r->process( raw, samples, rates, bins, size );
+    }
+    catch ( ... ) {
+      return CTR_Error;
+    }
+  }
+  if ( count )
+    *count = done;
+  return CTR_Ok;
+}
+
+
+Int32 CTR_API CTR_totals( Int32 handle, double* totals )
+{
+  if ( !totals )
+    return CTR_InvalidParam;
+  std::shared_ptr<Rates> r = find( handle );
+  if ( !r )
+    return CTR_NotConnected;
+  std::lock_guard<std::mutex> lk( r->m );
+  for ( size_t c = 0; c < r->ch.size(); ++c )
+    totals[c] = double( r->ch[c].total );
+  return CTR_Ok;
+}
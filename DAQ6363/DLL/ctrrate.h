@@ -0,0 +1,120 @@
+/******************************************************************/
+/** @file ctrrate.h
+ *  DAQ6363 counter rate DLL
+ *
+ *  Turns the buffered edge count samples of the DAQ6363 counters, as
+ *  read by DAQmx Read (Counter 2D U32, NChan NSamp) in
+ *  DAQ6363_ReadCounters.vi, into count rates; replaces the array
+ *  processing of DAQ6363_ProcRateDat.vi and DAQ6363_RecordGraph.vi.
+ *  Per read buffer and counter it
+ *    - differences successive samples modulo 2^32, which corrects the
+ *      rollover of the 32 bit counter registers
+ *    - scales the differences by the gate time (sample clock period)
+ *    - sums them into bins of a fixed number of samples for time traces;
+ *      partial bins carry over to the next read
+ *  The last sample of each counter is kept between reads. All outputs
+ *  are caller arrays; nothing is allocated after the first read of the
+ *  largest buffer.
+ */
+/******************************************************************/
+
+#ifndef __CTRRATE_H__
+#define __CTRRATE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define CTR_API
+#else
+#ifdef  DLL_EXPORT
+#define CTR_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define CTR_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int          Bln32;                     /**< Boolean compatible to older C      */
+typedef int          Int32;                     /**< Basic type                         */
+typedef unsigned int UInt32;                    /**< Raw counter register value         */
+
+/** Return values of functions */
+#define CTR_Ok                   0              /**< No error                              */
+#define CTR_Error              (-1)             /**< Unspecified error                     */
+#define CTR_NotConnected        -2              /**< Handle does not exist                 */
+#define CTR_InvalidParam        -9              /**< Parameter out of range                */
+#define CTR_BufferTooSmall     -10              /**< Bin array too small                   */
+
+
+/** @brief Create a rate state for a counter task
+ *
+ *  @param  counters  Number of counter channels in the task
+ *  @param  gate      Sample clock period [s]
+ *  @param  binSize   Samples per time trace bin, 0 disables binning
+ *  @param  handle    Output: rate handle
+ *  @return           Result of function
+ */
+Int32 CTR_API CTR_create( Int32 counters, double gate, Int32 binSize, Int32* handle );
+
+
+/** @brief Release a rate state
+ *
+ *  @param  handle    Rate handle
+ *  @return           Result of function
+ */
+Int32 CTR_API CTR_close( Int32 handle );
+
+
+/** @brief Restart after the task was started again
+ *
+ *  The previous sample of every counter is set to initial, the partial
+ *  bins and totals are cleared.
+ *
+ *  @param  handle    Rate handle
+ *  @param  initial   Initial count of the counter channels
+ *  @return           Result of function
+ */
+Int32 CTR_API CTR_reset( Int32 handle, UInt32 initial );
+
+
+/** @brief Process one read buffer
+ *
+ *  @param  handle    Rate handle
+ *  @param  raw       counters * samples register values, channel major
+ *                    (raw[c * samples + k])
+ *  @param  samples   Samples per counter
+ *  @param  rates     Output: counters * samples rates [1/s], channel
+ *                    major (may be NULL)
+ *  @param  bins      Output: completed bin rates [1/s], channel major
+ *                    (bins[c * size + k]); may be NULL without binning
+ *  @param  size      Bins per counter in the bins array
+ *  @param  count     Output: bins completed per counter (may be NULL)
+ *  @return           Result of function; on @ref CTR_BufferTooSmall
+ *                    nothing is consumed
+ */
+Int32 CTR_API CTR_process( Int32 handle,
+                           const UInt32* raw,
+                           Int32 samples,
+                           double* rates,
+                           double* bins,
+                           Int32 size,
+                           Int32* count );
+
+
+/** @brief Counts since create or reset, without rollover
+ *
+ *  @param  handle    Rate handle
+ *  @param  totals    Output: count per counter
+ *  @return           Result of function
+ */
+Int32 CTR_API CTR_totals( Int32 handle, double* totals );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
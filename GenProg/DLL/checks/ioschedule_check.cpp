@@ -0,0 +1,137 @@
+/******************************************************************/
+/** @file ioschedule_check.cpp
+ *  Regression check of @ref ioschedule.h on a pty
+ *
+ *  Build and run from GenProg/DLL:
+ *    g++ -std=c++17 -O2 -I. -pthread checks/ioschedule_check.cpp ioschedule.cpp -lutil
+ *  Exits with 0 if all checks pass.
+ */
+/******************************************************************/
+
+#include "ioschedule.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <pty.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check( bool ok, const char* what )
+{
+  std::printf( "%s %s\n", ok ? "ok  " : "FAIL", what );
+  failures += !ok;
+}
+
+/** Instrument on the pty master: answers each query "X?" with "X!",
+ *  or nothing while muted                                                 */
+class Responder
+{
+public:
+  explicit Responder( int fd ) : mute( false ), fd_( fd ), stop_( false ), thread_( &Responder::run, this ) {}
+  ~Responder() { stop_ = true; thread_.join(); }
+
+  std::atomic<bool> mute;
+
+private:
+  void run()
+  {
+    std::string line;
+    while ( !stop_ ) {
+      pollfd p = { fd_, POLLIN, 0 };
+      if ( ::poll( &p, 1, 20 ) <= 0 )
+        continue;
+      char buf[4096];
+      ssize_t n = ::read( fd_, buf, sizeof buf );
+      for ( ssize_t k = 0; k < n; ++k ) {
+        if ( buf[k] != '\n' ) {
+          line += buf[k];
+          continue;
+        }
+        if ( !line.empty() && line.back() == '?' && !mute ) {
+          line.back() = '!';
+          line += '\n';
+          if ( ::write( fd_, line.data(), line.size() ) < 0 )
+            return;
+        }
+        line.clear();
+      }
+    }
+  }
+
+  int               fd_;
+  std::atomic<bool> stop_;
+  std::thread       thread_;
+};
+
+bool released( Int32 ticket )
+{
+  Bln32 done = 0;
+  return IOS_ready( ticket, &done ) == IOS_NotConnected;
+}
+
+} // namespace
+
+
+int main()
+{
+  int master = -1, slave = -1;
+  char name[256];
+  if ( openpty( &master, &slave, name, 0, 0 ) != 0 ) {
+    std::printf( "FAIL openpty\n" );
+    return 1;
+  }
+  Responder dev( master );
+
+  IOS_Settings s = { 0, '\n', 300, 1, 0 };
+  Int32 bus = 0, inst = 0, t = 0, len = 0;
+  char reply[64];
+  IOS_createBus( &bus );
+  check( IOS_openInstrument( bus, name, &s, &inst ) == IOS_Ok, "open the pty slave" );
+  check( IOS_queryWait( inst, "A?\n", reply, sizeof reply, &len ) == IOS_Ok
+         && std::string( reply, len ) == "A!\n", "query round trip" );
+
+  /* Tickets nobody collects are bounded while the instrument is open */
+  Int32 first = 0;
+  IOS_write( inst, "W\n", &first );
+  for ( int k = 0; k < 70000; ++k )
+    IOS_write( inst, "W\n", &t );
+  check( IOS_wait( t, 10000, 0, 0, &len ) == IOS_Ok, "70000 writes complete" );
+  check( released( first ), "oldest unclaimed ticket dropped" );
+
+  /* Closing fails the queued commands of a muted instrument and
+     releases every ticket of it */
+  std::vector<Int32> tickets( 4 );
+  dev.mute = true;
+  for ( auto& k : tickets )
+    IOS_query( inst, "B?\n", &k );
+  Int32 waited = IOS_Ok;
+  std::thread waiter( [&] { Int32 n; waited = IOS_wait( tickets.back(), -1, reply, sizeof reply, &n ); } );
+  std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+  check( IOS_closeInstrument( inst ) == IOS_Ok, "close instrument with queued queries" );
+  waiter.join();
+  check( waited == IOS_Closed, "waiter fails with IOS_Closed" );
+  bool all = true;
+  for ( auto k : tickets )
+    all = all && released( k );
+  check( all, "tickets of the closed instrument released" );
+  check( IOS_query( inst, "C?\n", &t ) == IOS_NotConnected, "closed instrument refuses queries" );
+
+  /* Same when the bus goes away */
+  dev.mute = false;
+  check( IOS_openInstrument( bus, name, &s, &inst ) == IOS_Ok, "reopen the pty slave" );
+  IOS_query( inst, "D?\n", &t );
+  IOS_closeBus( bus );
+  check( released( t ), "tickets of the closed bus released" );
+
+  ::close( slave );
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+/******************************************************************/
+/** @file scanpattern_check.cpp
+ *  Regression check of @ref scanpattern.h
+ *
+ *  Build and run from GenProg/DLL:
+ *    g++ -std=c++17 -O2 -I. checks/scanpattern_check.cpp scanpattern.cpp
+ *  Exits with 0 if all checks pass.
+ */
+/******************************************************************/
+
+#include "scanpattern.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check( bool ok, const char* what )
+{
+  std::printf( "%s %s\n", ok ? "ok  " : "FAIL", what );
+  failures += !ok;
+}
+
+/** Optimizes a table; true if the result is a permutation of it, no
+ *  slower, and took less than limit seconds                              */
+bool optimize( std::vector<double> x, std::vector<double> y, double limit )
+{
+  SCAN_Motion m = { 10., 10., 0. };
+  std::vector<double> x0 = x, y0 = y;
+  double before = 0., after = 0.;
+  SCAN_duration( x.data(), y.data(), Int32( x.size() ), &m, &before );
+  auto t0 = std::chrono::steady_clock::now();
+  Int32 r = SCAN_optimizeOrder( x.data(), y.data(), Int32( x.size() ), &m, &after );
+  double s = std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+  std::vector<std::pair<double, double>> a, b;
+  for ( size_t k = 0; k < x.size(); ++k ) {
+    a.emplace_back( x0[k], y0[k] );
+    b.emplace_back( x[k], y[k] );
+  }
+  std::sort( a.begin(), a.end() );
+  std::sort( b.begin(), b.end() );
+  return r == SCAN_Ok && a == b && after <= before && s < limit;
+}
+
+} // namespace
+
+
+int main()
+{
+  const Int32 n = 100000;
+  std::mt19937 rng( 3 );
+  std::uniform_real_distribution<double> u( 0., 1000. );
+  std::vector<double> x( n ), y( n ), d( n );
+  for ( Int32 k = 0; k < n; ++k ) {
+    x[k] = u( rng );
+    y[k] = u( rng );
+    d[k] = 2. * x[k] + 1.;
+  }
+  std::vector<double> c( n, 5. );
+
+  /* degenerate axes used to make the nearest neighbour search quadratic */
+  check( optimize( x, y, 2. ), "100k points in 2-D" );
+  check( optimize( x, c, 2. ), "100k points on a line in x" );
+  check( optimize( c, y, 2. ), "100k points on a line in y" );
+  check( optimize( x, d, 2. ), "100k collinear points on a diagonal" );
+
+  SCAN_Grid g = { 0., 0., 1., 1., 1, 5000 };
+  std::vector<double> gx( 5000 ), gy( 5000 );
+  std::vector<Int32> idx( 5000 );
+  SCAN_generate( &g, SCAN_patRaster, gx.data(), gy.data(), 5000 );
+  for ( Int32 k = 0; k < 5000; ++k )
+    idx[k] = ( k * 7919 ) % 5000;
+  std::vector<double> sx( 5000 ), sy( 5000 );
+  for ( Int32 k = 0; k < 5000; ++k ) {
+    sx[k] = gx[idx[k]];
+    sy[k] = gy[idx[k]];
+  }
+  check( optimize( sx, sy, 1. ), "shuffled nx == 1 line scan" );
+
+  return failures ? 1 : 0;
+}
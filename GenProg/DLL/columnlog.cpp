@@ -0,0 +1,843 @@
+/******************************************************************/
+/** @file columnlog.cpp
+ *  Columnar data log DLL
+ *
+ *  Implementation of @ref columnlog.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "columnlog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char   kFileMagic[8]  = { 'G', 'P', 'C', 'O', 'L', '0', '0', '1' };
+const char   kChunkMagic[4] = { 'C', 'H', 'N', 'K' };
+const size_t kBlockHeader   = 32;
+
+enum Codec { kRaw = 0, kPacked = 1 };
+
+size_t width( Int32 type )
+{
+  return ( type == COL_f64 || type == COL_i64 ) ? 8 : 4;
+}
+
+bool validType( Int32 type )
+{
+  return type >= COL_f64 && type <= COL_i64;
+}
+
+void putLe( unsigned char* p, uint64_t v, int n )
+{
+  for ( int k = 0; k < n; ++k, v >>= 8 )
+    p[k] = (unsigned char)( v & 0xff );
+}
+
+uint64_t getLe( const unsigned char* p, int n )
+{
+  uint64_t v = 0;
+  for ( int k = n - 1; k >= 0; --k )
+    v = ( v << 8 ) | p[k];
+  return v;
+}
+
+void putDouble( unsigned char* p, double d )
+{
+  uint64_t u;
+  std::memcpy( &u, &d, 8 );
+  putLe( p, u, 8 );
+}
+
+double getDouble( const unsigned char* p )
+{
+  uint64_t u = getLe( p, 8 );
+  double   d;
+  std::memcpy( &d, &u, 8 );
+  return d;
+}
+
+template <class T>
+T clampTo( double v )
+{
+  const double lo = double( std::numeric_limits<T>::min() );
+  const double hi = double( std::numeric_limits<T>::max() );
+  if ( !( v == v ) )
+    return 0;
+  return v <= lo ? std::numeric_limits<T>::min()
+       : v >= hi ? std::numeric_limits<T>::max()
+                 : T( std::llround( v ) );
+}
+
+/** Stores one double as the column type                                   */
+void store( Int32 type, double v, unsigned char* p )
+{
+  switch ( type ) {
+  case COL_f64: std::memcpy( p, &v, 8 ); break;
+  case COL_f32: { float f = float( v );                std::memcpy( p, &f, 4 ); break; }
+  case COL_i32: { int32_t i = clampTo<int32_t>( v );   std::memcpy( p, &i, 4 ); break; }
+  case COL_u32: { uint32_t u = clampTo<uint32_t>( v ); std::memcpy( p, &u, 4 ); break; }
+  case COL_i64: { int64_t i = clampTo<int64_t>( v );   std::memcpy( p, &i, 8 ); break; }
+  }
+}
+
+double load( Int32 type, const unsigned char* p )
+{
+  switch ( type ) {
+  case COL_f64: { double d;   std::memcpy( &d, p, 8 ); return d; }
+  case COL_f32: { float f;    std::memcpy( &f, p, 4 ); return f; }
+  case COL_i32: { int32_t i;  std::memcpy( &i, p, 4 ); return i; }
+  case COL_u32: { uint32_t u; std::memcpy( &u, p, 4 ); return u; }
+  case COL_i64: { int64_t i;  std::memcpy( &i, p, 8 ); return double( i ); }
+  }
+  return 0.;
+}
+
+/** Integer columns without the round trip through double                  */
+Int64 loadInt( Int32 type, const unsigned char* p )
+{
+  switch ( type ) {
+  case COL_i32: { int32_t i;  std::memcpy( &i, p, 4 ); return i; }
+  case COL_u32: { uint32_t u; std::memcpy( &u, p, 4 ); return u; }
+  case COL_i64: { int64_t i;  std::memcpy( &i, p, 8 ); return i; }
+  }
+  return 0;
+}
+
+
+/* ----- Block codec ---------------------------------------------------------- */
+/* XOR with the previous value turns slowly varying data into words with
+   many zero high bytes; the byte shuffle groups those zero bytes together
+   and a run length code removes them. Control byte c < 128 is followed by
+   c + 1 literal bytes, c >= 128 stands for c - 127 zero bytes.            */
+
+void pack( const unsigned char* in, size_t n, size_t w, std::vector<unsigned char>& out )
+{
+  std::vector<unsigned char> s( n * w );
+  for ( size_t i = 0; i < n; ++i )
+    for ( size_t b = 0; b < w; ++b )
+      s[b * n + i] = in[i * w + b] ^ ( i ? in[( i - 1 ) * w + b] : 0 );
+
+  out.clear();
+  size_t k = 0, total = s.size();
+  while ( k < total ) {
+    if ( s[k] == 0 ) {
+      size_t run = 1;
+      while ( k + run < total && run < 128 && s[k + run] == 0 )
+        ++run;
+      out.push_back( (unsigned char)( 127 + run ) );
+      k += run;
+    }
+    else {
+      size_t run = 1;
+      while ( k + run < total && run < 128 && s[k + run] != 0 )
+        ++run;
+      out.push_back( (unsigned char)( run - 1 ) );
+      out.insert( out.end(), s.begin() + k, s.begin() + k + run );
+      k += run;
+    }
+  }
+}
+
+bool unpack( const unsigned char* in, size_t size, size_t n, size_t w, unsigned char* out )
+{
+  size_t total = n * w;
+  std::vector<unsigned char> s( total );
+  size_t k = 0, p = 0;
+  while ( p < size ) {
+    unsigned char c = in[p++];
+    size_t run = c < 128 ? size_t( c ) + 1 : size_t( c ) - 127;
+    if ( k + run > total || ( c < 128 && p + run > size ) )
+      return false;
+    if ( c < 128 ) {
+      std::memcpy( &s[k], in + p, run );
+      p += run;
+    }
+    else
+      std::memset( &s[k], 0, run );
+    k += run;
+  }
+  if ( k != total )
+    return false;
+  for ( size_t i = 0; i < n; ++i )
+    for ( size_t b = 0; b < w; ++b )
+      out[i * w + b] = s[b * n + i] ^ ( i ? out[( i - 1 ) * w + b] : 0 );
+  return true;
+}
+
+
+/* ----- Writer --------------------------------------------------------------- */
+
+struct Chunk {
+  uint32_t                                rows = 0;
+  std::vector<std::vector<unsigned char>> cols;
+};
+
+int syncFile( std::FILE* f )
+{
+  if ( std::fflush( f ) != 0 )
+    return -1;
+#ifdef _WIN32
+  return _commit( _fileno( f ) );
+#else
+  return fsync( fileno( f ) );
+#endif
+}
+
+class Writer
+{
+public:
+  Writer( std::FILE* f, const std::vector<Int32>& types, uint32_t chunkRows, bool compress )
+    : f_( f ), types_( types ), chunkRows_( chunkRows ), compress_( compress ),
+      queued_( 0 ), written_( 0 ), stop_( false ), failed_( false ), thread_( &Writer::run, this )
+  {
+    reset();
+  }
+
+  ~Writer()
+  {
+    {
+      std::lock_guard<std::mutex> lk( m_ );
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    std::fclose( f_ );
+  }
+
+  /** Called with the slot lock of this writer held; tags, if given, hold
+   *  the values of the COL_i64 columns                                     */
+  void append( const double* values, const Int64* tags, Int32 rows )
+  {
+    size_t nc = types_.size();
+    size_t nt = size_t( std::count( types_.begin(), types_.end(), Int32( COL_i64 ) ) );
+    for ( Int32 r = 0; r < rows; ++r ) {
+      for ( size_t c = 0, t = 0; c < nc; ++c ) {
+        std::vector<unsigned char>& col = current_.cols[c];
+        size_t w = width( types_[c] );
+        col.resize( col.size() + w );
+        if ( tags && types_[c] == COL_i64 ) {
+          int64_t i = tags[size_t( r ) * nt + t++];
+          std::memcpy( &col[col.size() - w], &i, 8 );
+        }
+        else
+          store( types_[c], values[size_t( r ) * nc + c], &col[col.size() - w] );
+      }
+      if ( ++current_.rows == chunkRows_ )
+        submit();
+    }
+  }
+
+  void flush()
+  {
+    if ( current_.rows > 0 )
+      submit();
+    std::unique_lock<std::mutex> lk( m_ );
+    uint64_t target = queued_;
+    done_.wait( lk, [&] { return written_ >= target; } );
+  }
+
+  bool failed() const { return failed_; }
+
+private:
+  void reset()
+  {
+    current_ = Chunk();
+    current_.cols.resize( types_.size() );
+    for ( size_t c = 0; c < types_.size(); ++c )
+      current_.cols[c].reserve( size_t( chunkRows_ ) * width( types_[c] ) );
+  }
+
+  void submit()
+  {
+    {
+      std::lock_guard<std::mutex> lk( m_ );
+      queue_.push_back( std::move( current_ ) );
+      ++queued_;
+    }
+    cv_.notify_all();
+    reset();
+  }
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lk( m_ );
+    for ( ;; ) {
+      cv_.wait( lk, [this] { return stop_ || !queue_.empty(); } );
+      if ( queue_.empty() )
+        return;
+      Chunk c = std::move( queue_.front() );
+      queue_.pop_front();
+      lk.unlock();
+
+      if ( !write( c ) )
+        failed_ = true;
+
+      lk.lock();
+      ++written_;
+      done_.notify_all();
+    }
+  }
+
+  bool write( const Chunk& c )
+  {
+    size_t nc = types_.size();
+    std::vector<std::vector<unsigned char>> packed( nc );
+    std::vector<unsigned char> head( 12 + nc * kBlockHeader, 0 );
+    std::memcpy( &head[0], kChunkMagic, 4 );
+    putLe( &head[4], c.rows, 4 );
+    putLe( &head[8], nc, 4 );
+
+    for ( size_t k = 0; k < nc; ++k ) {
+      size_t w   = width( types_[k] );
+      double lo  = HUGE_VAL, hi = -HUGE_VAL;
+      for ( uint32_t r = 0; r < c.rows; ++r ) {
+        double v = load( types_[k], &c.cols[k][r * w] );
+        if ( v < lo ) lo = v;
+        if ( v > hi ) hi = v;
+      }
+      unsigned char codec = kRaw;
+      if ( compress_ ) {
+        pack( c.cols[k].data(), c.rows, w, packed[k] );
+        if ( packed[k].size() < c.cols[k].size() )
+          codec = kPacked;
+      }
+      unsigned char* b = &head[12 + k * kBlockHeader];
+      b[0] = codec;
+      putLe( b + 8, codec == kPacked ? packed[k].size() : c.cols[k].size(), 8 );
+      putDouble( b + 16, lo );
+      putDouble( b + 24, hi );
+    }
+
+    if ( std::fwrite( head.data(), 1, head.size(), f_ ) != head.size() )
+      return false;
+    for ( size_t k = 0; k < nc; ++k ) {
+      const std::vector<unsigned char>& d = head[12 + k * kBlockHeader] == kPacked ? packed[k] : c.cols[k];
+      if ( !d.empty() && std::fwrite( d.data(), 1, d.size(), f_ ) != d.size() )
+        return false;
+    }
+    return syncFile( f_ ) == 0;
+  }
+
+  std::FILE*              f_;
+  std::vector<Int32>      types_;
+  uint32_t                chunkRows_;
+  bool                    compress_;
+  Chunk                   current_;   /**< Rows being collected, caller side only */
+
+  std::mutex              m_;
+  std::condition_variable cv_;
+  std::condition_variable done_;
+  std::deque<Chunk>       queue_;
+  uint64_t                queued_;
+  uint64_t                written_;
+  bool                    stop_;
+  std::atomic<bool>       failed_;
+  std::thread             thread_;
+};
+
+
+/* ----- Reader --------------------------------------------------------------- */
+
+/** Read only memory mapping of a whole file                               */
+class Mapping
+{
+public:
+  Mapping() : data_( 0 ), size_( 0 )
+#ifdef _WIN32
+    , file_( INVALID_HANDLE_VALUE ), map_( 0 )
+#endif
+  {}
+
+  ~Mapping()
+  {
+#ifdef _WIN32
+    if ( data_ ) UnmapViewOfFile( data_ );
+    if ( map_ ) CloseHandle( map_ );
+    if ( file_ != INVALID_HANDLE_VALUE ) CloseHandle( file_ );
+#else
+    if ( data_ ) munmap( const_cast<unsigned char*>( data_ ), size_ );
+#endif
+  }
+
+  bool open( const char* path )
+  {
+#ifdef _WIN32
+    file_ = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+    if ( file_ == INVALID_HANDLE_VALUE )
+      return false;
+    LARGE_INTEGER sz;
+    if ( !GetFileSizeEx( file_, &sz ) )
+      return false;
+    size_ = size_t( sz.QuadPart );
+    if ( size_ == 0 )
+      return true;
+    map_ = CreateFileMappingA( file_, 0, PAGE_READONLY, 0, 0, 0 );
+    if ( !map_ )
+      return false;
+    data_ = static_cast<const unsigned char*>( MapViewOfFile( map_, FILE_MAP_READ, 0, 0, 0 ) );
+    return data_ != 0;
+#else
+    int fd = ::open( path, O_RDONLY );
+    if ( fd < 0 )
+      return false;
+    struct stat st;
+    bool ok = fstat( fd, &st ) == 0;
+    size_ = ok ? size_t( st.st_size ) : 0;
+    if ( ok && size_ > 0 ) {
+      void* p = mmap( 0, size_, PROT_READ, MAP_SHARED, fd, 0 );
+      ok    = p != MAP_FAILED;
+      data_ = ok ? static_cast<const unsigned char*>( p ) : 0;
+    }
+    ::close( fd );
+    return ok;
+#endif
+  }
+
+  const unsigned char* data() const { return data_; }
+  size_t               size() const { return size_; }
+
+private:
+  const unsigned char* data_;
+  size_t               size_;
+#ifdef _WIN32
+  HANDLE file_, map_;
+#endif
+};
+
+struct Block {
+  size_t        offset;
+  size_t        size;
+  unsigned char codec;
+  double        min, max;
+};
+
+struct ChunkInfo {
+  Int64              row0;
+  uint32_t           rows;
+  std::vector<Block> blocks;
+};
+
+class Reader
+{
+public:
+  Int32 open( const char* path )
+  {
+    if ( !map_.open( path ) )
+      return COL_FileError;
+    const unsigned char* d = map_.data();
+    size_t size = map_.size(), p = 12;
+    if ( size < p || std::memcmp( d, kFileMagic, 8 ) != 0 )
+      return COL_BadFormat;
+    uint32_t nc = uint32_t( getLe( d + 8, 4 ) );
+    for ( uint32_t c = 0; c < nc; ++c ) {
+      if ( p + 4 > size )
+        return COL_BadFormat;
+      Int32  type = d[p];
+      size_t len  = size_t( getLe( d + p + 2, 2 ) );
+      if ( !validType( type ) || p + 4 + len > size )
+        return COL_BadFormat;
+      types.push_back( type );
+      names.push_back( std::string( reinterpret_cast<const char*>( d + p + 4 ), len ) );
+      p += 4 + len;
+    }
+
+    rows = 0;
+    for ( ;; ) {
+      size_t head = 12 + nc * kBlockHeader;
+      if ( p + head > size || std::memcmp( d + p, kChunkMagic, 4 ) != 0 ||
+           getLe( d + p + 8, 4 ) != nc )
+        break;
+      ChunkInfo ci;
+      ci.row0 = rows;
+      ci.rows = uint32_t( getLe( d + p + 4, 4 ) );
+      size_t data = p + head;
+      bool   ok   = true;
+      for ( uint32_t c = 0; c < nc && ok; ++c ) {
+        const unsigned char* b = d + p + 12 + c * kBlockHeader;
+        Block blk;
+        blk.codec  = b[0];
+        blk.size   = size_t( getLe( b + 8, 8 ) );
+        blk.offset = data;
+        blk.min    = getDouble( b + 16 );
+        blk.max    = getDouble( b + 24 );
+        ok = blk.codec <= kPacked && blk.size <= size - data &&
+             ( blk.codec == kPacked || blk.size == size_t( ci.rows ) * width( types[c] ) );
+        data += blk.size;
+        ci.blocks.push_back( blk );
+      }
+      if ( !ok )
+        break;   /* chunk being written or cut short */
+      chunks.push_back( ci );
+      rows += ci.rows;
+      p = data;
+    }
+    return COL_Ok;
+  }
+
+  /** Decoded bytes of one column of one chunk; keeps the last one          */
+  const unsigned char* decode( size_t chunk, Int32 column )
+  {
+    const ChunkInfo& ci = chunks[chunk];
+    const Block&     b  = ci.blocks[column];
+    if ( b.codec == kRaw )
+      return map_.data() + b.offset;
+    if ( cacheChunk_ == chunk && cacheColumn_ == column )
+      return cache_.data();
+    size_t w = width( types[column] );
+    cache_.resize( size_t( ci.rows ) * w );
+    cacheChunk_ = size_t( -1 );
+    if ( !unpack( map_.data() + b.offset, b.size, ci.rows, w, cache_.data() ) )
+      return 0;
+    cacheChunk_  = chunk;
+    cacheColumn_ = column;
+    return cache_.data();
+  }
+
+  std::mutex               m;
+  std::vector<Int32>       types;
+  std::vector<std::string> names;
+  std::vector<ChunkInfo>   chunks;
+  Int64                    rows = 0;
+
+private:
+  Mapping                    map_;
+  std::vector<unsigned char> cache_;
+  size_t                     cacheChunk_  = size_t( -1 );
+  Int32                      cacheColumn_ = -1;
+};
+
+
+/* ----- Handle registry ------------------------------------------------------ */
+
+struct WriterSlot {
+  std::mutex              m;
+  std::unique_ptr<Writer> w;
+};
+
+struct Registry {
+  std::mutex                                   m;
+  Int32                                        nextId = 1;
+  std::map<Int32, std::shared_ptr<WriterSlot>> writers;
+  std::map<Int32, std::shared_ptr<Reader>>     readers;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+template <class T>
+std::shared_ptr<T> find( std::map<Int32, std::shared_ptr<T>>& map, Int32 id )
+{
+  std::lock_guard<std::mutex> lk( registry().m );
+  auto it = map.find( id );
+  return it == map.end() ? std::shared_ptr<T>() : it->second;
+}
+
+Int32 append( Int32 writer, const double* values, const Int64* tags, Int32 rows )
+{
+  std::shared_ptr<WriterSlot> s = find( registry().writers, writer );
+  if ( !s )
+    return COL_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  try {
+    s->w->append( values, tags, rows );
+  }
+  catch ( ... ) {
+    return COL_Error;
+  }
+  return s->w->failed() ? COL_FileError : COL_Ok;
+}
+
+/** Rows [first, first + count) of a column, each converted by get( type,
+ *  bytes ); reader mutex held                                             */
+template <class T, class Get>
+Int32 readRows( Reader& r, Int32 column, Int64 first, Int32 count, T* values, Int32* read, Get get )
+{
+  Int64  end  = std::min( r.rows, first + count );
+  Int32  type = r.types[column];
+  size_t w    = width( type );
+  auto   it   = std::upper_bound( r.chunks.begin(), r.chunks.end(), first,
+                                  []( Int64 row, const ChunkInfo& c ) { return row < c.row0; } );
+  size_t k    = it == r.chunks.begin() ? 0 : size_t( it - r.chunks.begin() ) - 1;
+  Int32  n    = 0;
+  for ( Int64 row = first; row < end; ++k ) {
+    const ChunkInfo&     ci = r.chunks[k];
+    const unsigned char* d  = r.decode( k, column );
+    if ( !d )
+      return COL_BadFormat;
+    Int64 stop = std::min<Int64>( end, ci.row0 + ci.rows );
+    for ( ; row < stop; ++row )
+      values[n++] = get( type, d + size_t( row - ci.row0 ) * w );
+  }
+  *read = n;
+  return COL_Ok;
+}
+
+} // namespace
+
+
+Int32 COL_API COL_create( const char* path,
+                          Int32 columns,
+                          const char* names,
+                          const Int32* types,
+                          Int32 chunkRows,
+                          Bln32 compress,
+                          Int32* writer )
+{
+  if ( !path || columns < 1 || !names || !types || chunkRows < 1 || !writer )
+    return COL_InvalidParam;
+  for ( Int32 c = 0; c < columns; ++c )
+    if ( !validType( types[c] ) )
+      return COL_InvalidParam;
+
+  try {
+    std::vector<unsigned char> head( 12 );
+    std::memcpy( &head[0], kFileMagic, 8 );
+    putLe( &head[8], uint32_t( columns ), 4 );
+    const char* p = names;
+    for ( Int32 c = 0; c < columns; ++c ) {
+      const char* e   = std::strchr( p, '\n' );
+      size_t      len = std::min<size_t>( e ? size_t( e - p ) : std::strlen( p ), 0xffff );
+      size_t      at  = head.size();
+      head.resize( at + 4 + len );
+      head[at]     = (unsigned char)types[c];
+      head[at + 1] = 0;
+      putLe( &head[at + 2], len, 2 );
+      std::memcpy( &head[at + 4], p, len );
+      p += e ? size_t( e - p ) + 1 : std::strlen( p );
+    }
+
+    std::FILE* f = std::fopen( path, "wb" );
+    if ( !f )
+      return COL_FileError;
+    if ( std::fwrite( head.data(), 1, head.size(), f ) != head.size() || syncFile( f ) != 0 ) {
+      std::fclose( f );
+      return COL_FileError;
+    }
+
+    std::shared_ptr<WriterSlot> slot = std::make_shared<WriterSlot>();
+    slot->w.reset( new Writer( f, std::vector<Int32>( types, types + columns ),
+                               uint32_t( chunkRows ), compress != 0 ) );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *writer = reg.nextId++;
+    reg.writers[*writer] = slot;
+    return COL_Ok;
+  }
+  catch ( ... ) {
+    return COL_Error;
+  }
+}
+
+
+Int32 COL_API COL_append( Int32 writer, const double* values, Int32 rows )
+{
+  if ( rows < 0 || ( rows > 0 && !values ) )
+    return COL_InvalidParam;
+  return append( writer, values, 0, rows );
+}
+
+
+Int32 COL_API COL_appendI64( Int32 writer, const double* values, const Int64* tags, Int32 rows )
+{
+  if ( rows < 0 || ( rows > 0 && ( !values || !tags ) ) )
+    return COL_InvalidParam;
+  return append( writer, values, tags, rows );
+}
+
+
+Int32 COL_API COL_flush( Int32 writer )
+{
+  std::shared_ptr<WriterSlot> s = find( registry().writers, writer );
+  if ( !s )
+    return COL_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  s->w->flush();
+  return s->w->failed() ? COL_FileError : COL_Ok;
+}
+
+
+Int32 COL_API COL_closeWriter( Int32 writer )
+{
+  std::shared_ptr<WriterSlot> s;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.writers.find( writer );
+    if ( it == reg.writers.end() )
+      return COL_NotConnected;
+    s = it->second;
+    reg.writers.erase( it );
+  }
+  std::lock_guard<std::mutex> lk( s->m );
+  s->w->flush();
+  bool failed = s->w->failed();
+  s->w.reset();
+  return failed ? COL_FileError : COL_Ok;
+}
+
+
+Int32 COL_API COL_open( const char* path, Int32* reader )
+{
+  if ( !path || !reader )
+    return COL_InvalidParam;
+  try {
+    std::shared_ptr<Reader> r = std::make_shared<Reader>();
+    Int32 res = r->open( path );
+    if ( res != COL_Ok )
+      return res;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *reader = reg.nextId++;
+    reg.readers[*reader] = r;
+    return COL_Ok;
+  }
+  catch ( ... ) {
+    return COL_Error;
+  }
+}
+
+
+Int32 COL_API COL_info( Int32 reader, Int32* columns, Int64* rows )
+{
+  if ( !columns || !rows )
+    return COL_InvalidParam;
+  std::shared_ptr<Reader> r = find( registry().readers, reader );
+  if ( !r )
+    return COL_NotConnected;
+  *columns = Int32( r->types.size() );
+  *rows    = r->rows;
+  return COL_Ok;
+}
+
+
+Int32 COL_API COL_column( Int32 reader,
+                          Int32 column,
+                          char* name,
+                          Int32 size,
+                          Int32* type )
+{
+  if ( !name || size < 1 || !type )
+    return COL_InvalidParam;
+  std::shared_ptr<Reader> r = find( registry().readers, reader );
+  if ( !r )
+    return COL_NotConnected;
+  if ( column < 0 || column >= Int32( r->types.size() ) )
+    return COL_InvalidParam;
+  const std::string& n = r->names[column];
+  *type = r->types[column];
+  if ( n.size() >= size_t( size ) )
+    return COL_BufferTooSmall;
+  std::memcpy( name, n.c_str(), n.size() + 1 );
+  return COL_Ok;
+}
+
+
+Int32 COL_API COL_read( Int32 reader,
+                        Int32 column,
+                        Int64 first,
+                        Int32 count,
+                        double* values,
+                        Int32* read )
+{
+  if ( !read || first < 0 || count < 0 || ( count > 0 && !values ) )
+    return COL_InvalidParam;
+  *read = 0;
+  std::shared_ptr<Reader> r = find( registry().readers, reader );
+  if ( !r )
+    return COL_NotConnected;
+  if ( column < 0 || column >= Int32( r->types.size() ) )
+    return COL_InvalidParam;
+
+  std::lock_guard<std::mutex> lk( r->m );
+  return readRows( *r, column, first, count, values, read, load );
+}
+
+
+Int32 COL_API COL_readI64( Int32 reader,
+                           Int32 column,
+                           Int64 first,
+                           Int32 count,
+                           Int64* values,
+                           Int32* read )
+{
+  if ( !read || first < 0 || count < 0 || ( count > 0 && !values ) )
+    return COL_InvalidParam;
+  *read = 0;
+  std::shared_ptr<Reader> r = find( registry().readers, reader );
+  if ( !r )
+    return COL_NotConnected;
+  if ( column < 0 || column >= Int32( r->types.size() ) ||
+       r->types[column] == COL_f64 || r->types[column] == COL_f32 )
+    return COL_InvalidParam;
+
+  std::lock_guard<std::mutex> lk( r->m );
+  return readRows( *r, column, first, count, values, read, loadInt );
+}
+
+
+Int32 COL_API COL_findRange( Int32 reader,
+                             Int32 column,
+                             double low,
+                             double high,
+                             Int64* first,
+                             Int64* last )
+{
+  if ( !first || !last )
+    return COL_InvalidParam;
+  std::shared_ptr<Reader> r = find( registry().readers, reader );
+  if ( !r )
+    return COL_NotConnected;
+  if ( column < 0 || column >= Int32( r->types.size() ) )
+    return COL_InvalidParam;
+
+  *first = *last = 0;
+  bool found = false;
+  for ( const ChunkInfo& ci : r->chunks ) {
+    const Block& b = ci.blocks[column];
+    if ( b.max < low || b.min > high )
+      continue;
+    if ( !found )
+      *first = ci.row0;
+    *last = ci.row0 + ci.rows;
+    found = true;
+  }
+  return COL_Ok;
+}
+
+
+Int32 COL_API COL_closeReader( Int32 reader )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.readers.erase( reader ) ? COL_Ok : COL_NotConnected;
+}
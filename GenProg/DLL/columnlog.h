@@ -0,0 +1,244 @@
+/******************************************************************/
+/** @file columnlog.h
+ *  Columnar data log DLL
+ *
+ *  Chunked, typed, column oriented data files as a replacement for the
+ *  text and flat binary files of the DataWrite*Gen.vi / DataRead*Gen.vi
+ *  family. The writer only ever appends: rows are collected into chunks
+ *  which a background thread encodes, writes and syncs to disk. The
+ *  reader maps the file into memory and decodes only the chunks that
+ *  cover the requested column and row range; a min/max index per chunk
+ *  and column allows range searches without decoding.
+ *
+ *  File layout (values little endian):
+ *    header  "GPCOL001", uint32 columns, per column
+ *            { uint8 type; uint8 0; uint16 length; char name[length] }
+ *    chunks  "CHNK", uint32 rows, uint32 columns, per column
+ *            { uint8 codec; uint8 0[7]; uint64 size; double min; double max }
+ *            followed by the column blocks in column order
+ *  A chunk cut short by a crash is ignored by the reader.
+ */
+/******************************************************************/
+
+#ifndef __COLUMNLOG_H__
+#define __COLUMNLOG_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define COL_API
+#else
+#ifdef  DLL_EXPORT
+#define COL_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define COL_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int       Bln32;                        /**< Boolean compatible to older C      */
+typedef int       Int32;                        /**< Basic type                         */
+typedef long long Int64;                        /**< Row numbers                        */
+
+/** Return values of functions */
+#define COL_Ok                   0              /**< No error                              */
+#define COL_Error              (-1)             /**< Unspecified error                     */
+#define COL_NotConnected        -2              /**< Handle does not exist                 */
+#define COL_FileError           -8              /**< File cannot be opened, written or read */
+#define COL_InvalidParam        -9              /**< Parameter out of range                */
+#define COL_BufferTooSmall     -10              /**< Output buffer too small               */
+#define COL_BadFormat          -16              /**< Not a columnar log file               */
+
+
+/** @brief  Column types                                                             */
+typedef enum {
+  COL_f64 = 0,                               /**< double                             */
+  COL_f32 = 1,                               /**< float                              */
+  COL_i32 = 2,                               /**< 32 bit signed integer              */
+  COL_u32 = 3,                               /**< 32 bit unsigned integer (counts)   */
+  COL_i64 = 4                                /**< 64 bit signed integer (time tags);
+                                                  exact through @ref COL_appendI64 and
+                                                  @ref COL_readI64, as double only up
+                                                  to 2^53                            */
+} COL_Type;
+
+
+/** @brief Create a log file for writing
+ *
+ *  @param  path       File path; an existing file is overwritten
+ *  @param  columns    Number of columns
+ *  @param  names      Column names separated by '\\n'
+ *  @param  types      Column types, see @ref COL_Type
+ *  @param  chunkRows  Rows per chunk, e.g. 65536
+ *  @param  compress   Encode chunks (xor delta, byte shuffle, zero runs)
+ *                     when this makes them smaller
+ *  @param  writer     Output: writer handle
+ *  @return            Result of function
+ */
+Int32 COL_API COL_create( const char* path,
+                          Int32 columns,
+                          const char* names,
+                          const Int32* types,
+                          Int32 chunkRows,
+                          Bln32 compress,
+                          Int32* writer );
+
+
+/** @brief Append rows
+ *
+ *  Values are given row by row as doubles (a LabVIEW 2D DBL array) and
+ *  converted to the column types. Returns as soon as the rows are
+ *  queued; completed chunks are written by the background thread.
+ *
+ *  @param  writer   Writer handle
+ *  @param  values   rows * columns values, row major
+ *  @param  rows     Number of rows
+ *  @return          Result of function, @ref COL_FileError if an earlier
+ *                   background write failed
+ */
+Int32 COL_API COL_append( Int32 writer, const double* values, Int32 rows );
+
+
+/** @brief Append rows with exact 64 bit integer columns
+ *
+ *  As @ref COL_append, but the @ref COL_i64 columns take their values
+ *  from tags instead of values, so time tags beyond 2^53 keep every bit.
+ *
+ *  @param  writer   Writer handle
+ *  @param  values   rows * columns values, row major; the entries of
+ *                   COL_i64 columns are not used
+ *  @param  tags     rows * (number of COL_i64 columns) values, row major
+ *  @param  rows     Number of rows
+ *  @return          Result of function
+ */
+Int32 COL_API COL_appendI64( Int32 writer, const double* values, const Int64* tags, Int32 rows );
+
+
+/** @brief Write the pending rows as a chunk and wait until it is on disk
+ *
+ *  @param  writer   Writer handle
+ *  @return          Result of function
+ */
+Int32 COL_API COL_flush( Int32 writer );
+
+
+/** @brief Flush and close a writer
+ *
+ *  @param  writer   Writer handle
+ *  @return          Result of function
+ */
+Int32 COL_API COL_closeWriter( Int32 writer );
+
+
+/** @brief Open a log file for reading
+ *
+ *  Chunks appended after opening are not seen; reopen to refresh.
+ *
+ *  @param  path     File path
+ *  @param  reader   Output: reader handle
+ *  @return          Result of function
+ */
+Int32 COL_API COL_open( const char* path, Int32* reader );
+
+
+/** @brief File contents
+ *
+ *  @param  reader   Reader handle
+ *  @param  columns  Output: number of columns
+ *  @param  rows     Output: number of rows
+ *  @return          Result of function
+ */
+Int32 COL_API COL_info( Int32 reader, Int32* columns, Int64* rows );
+
+
+/** @brief Column description
+ *
+ *  @param  reader   Reader handle
+ *  @param  column   Column index
+ *  @param  name     Output: column name, NULL-terminated
+ *  @param  size     Size of the name buffer
+ *  @param  type     Output: column type
+ *  @return          Result of function
+ */
+Int32 COL_API COL_column( Int32 reader,
+                          Int32 column,
+                          char* name,
+                          Int32 size,
+                          Int32* type );
+
+
+/** @brief Read a row range of one column
+ *
+ *  @param  reader   Reader handle
+ *  @param  column   Column index
+ *  @param  first    First row
+ *  @param  count    Number of rows wanted
+ *  @param  values   Output: values converted to double
+ *  @param  read     Output: number of rows read (less at end of file)
+ *  @return          Result of function
+ */
+Int32 COL_API COL_read( Int32 reader,
+                        Int32 column,
+                        Int64 first,
+                        Int32 count,
+                        double* values,
+                        Int32* read );
+
+
+/** @brief Read a row range of an integer column without rounding
+ *
+ *  @param  reader   Reader handle
+ *  @param  column   Column index of a COL_i32, COL_u32 or COL_i64 column
+ *  @param  first    First row
+ *  @param  count    Number of rows wanted
+ *  @param  values   Output: values
+ *  @param  read     Output: number of rows read (less at end of file)
+ *  @return          Result of function
+ */
+Int32 COL_API COL_readI64( Int32 reader,
+                           Int32 column,
+                           Int64 first,
+                           Int32 count,
+                           Int64* values,
+                           Int32* read );
+
+
+/** @brief Rows whose chunks may hold values in [low, high]
+ *
+ *  Uses the per chunk min/max index only, so the result is a superset
+ *  made of whole chunks. For a monotonic column (time, scan index) it
+ *  locates a window without decoding any data.
+ *
+ *  @param  reader   Reader handle
+ *  @param  column   Column index
+ *  @param  low      Lower bound
+ *  @param  high     Upper bound
+ *  @param  first    Output: first row of the first matching chunk
+ *  @param  last     Output: one past the last row of the last matching
+ *                   chunk; first == last if nothing matches
+ *  @return          Result of function
+ */
+Int32 COL_API COL_findRange( Int32 reader,
+                             Int32 column,
+                             double low,
+                             double high,
+                             Int64* first,
+                             Int64* last );
+
+
+/** @brief Close a reader
+ *
+ *  @param  reader   Reader handle
+ *  @return          Result of function
+ */
+Int32 COL_API COL_closeReader( Int32 reader );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
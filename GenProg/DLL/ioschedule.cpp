@@ -0,0 +1,841 @@
+/******************************************************************/
+/** @file ioschedule.cpp
+ *  Instrument I/O scheduler DLL
+ *
+ *  Implementation of @ref ioschedule.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "ioschedule.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(unix) || defined(__unix__)
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#ifdef IOS_USE_VISA
+#include <visa.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const IOS_Settings kDefaultSettings = { 9600, '\n', 2000, 1, 0 };
+const size_t       kChunk           = 4096;
+const size_t       kMaxTickets      = 65536;    /**< Unclaimed tickets kept */
+
+
+/* ----- Transports ----------------------------------------------------------- */
+
+class Transport
+{
+public:
+  virtual ~Transport() {}
+  /** Writes all bytes or fails                                              */
+  virtual Int32 send( const char* data, size_t n, Int32 timeout ) = 0;
+  /** Reads at least one byte, at most n                                     */
+  virtual Int32 receive( char* data, size_t n, size_t& got, Int32 timeout ) = 0;
+};
+
+#if defined(unix) || defined(__unix__)
+
+speed_t baudConstant( Int32 baud )
+{
+  switch ( baud ) {
+  case 1200:   return B1200;
+  case 2400:   return B2400;
+  case 4800:   return B4800;
+  case 9600:   return B9600;
+  case 19200:  return B19200;
+  case 38400:  return B38400;
+  case 57600:  return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  default:     return B0;
+  }
+}
+
+/** Serial port, pty or any other character device                        */
+class FdTransport : public Transport
+{
+public:
+  FdTransport() : fd_( -1 ) {}
+  ~FdTransport() { if ( fd_ >= 0 ) ::close( fd_ ); }
+
+  Int32 open( const char* path, const IOS_Settings& s )
+  {
+    fd_ = ::open( path, O_RDWR | O_NOCTTY | O_NONBLOCK );
+    if ( fd_ < 0 )
+      return IOS_NotConnected;
+    if ( isatty( fd_ ) ) {
+      termios t;
+      if ( tcgetattr( fd_, &t ) != 0 )
+        return IOS_DriverError;
+      cfmakeraw( &t );
+      t.c_cflag |= CLOCAL | CREAD;
+      t.c_cc[VMIN]  = 0;
+      t.c_cc[VTIME] = 0;
+      if ( s.baudRate > 0 ) {
+        speed_t b = baudConstant( s.baudRate );
+        if ( b == B0 )
+          return IOS_InvalidParam;
+        cfsetispeed( &t, b );
+        cfsetospeed( &t, b );
+      }
+      if ( tcsetattr( fd_, TCSANOW, &t ) != 0 )
+        return IOS_DriverError;
+      tcflush( fd_, TCIOFLUSH );
+    }
+    return IOS_Ok;
+  }
+
+  Int32 send( const char* data, size_t n, Int32 timeout ) override
+  {
+    Clock::time_point end = Clock::now() + std::chrono::milliseconds( timeout );
+    while ( n > 0 ) {
+      ssize_t w = ::write( fd_, data, n );
+      if ( w > 0 ) {
+        data += w;
+        n    -= size_t( w );
+        continue;
+      }
+      if ( w < 0 && errno != EAGAIN && errno != EINTR )
+        return IOS_DriverError;
+      Int32 r = waitFor( POLLOUT, end );
+      if ( r != IOS_Ok )
+        return r;
+    }
+    return IOS_Ok;
+  }
+
+  Int32 receive( char* data, size_t n, size_t& got, Int32 timeout ) override
+  {
+    Clock::time_point end = Clock::now() + std::chrono::milliseconds( timeout );
+    for ( ;; ) {
+      ssize_t r = ::read( fd_, data, n );
+      if ( r > 0 ) {
+        got = size_t( r );
+        return IOS_Ok;
+      }
+      if ( r < 0 && errno != EAGAIN && errno != EINTR )
+        return IOS_DriverError;
+      Int32 w = waitFor( POLLIN, end );
+      if ( w != IOS_Ok )
+        return w;
+    }
+  }
+
+private:
+  Int32 waitFor( short events, Clock::time_point end )
+  {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>( end - Clock::now() ).count();
+    if ( left <= 0 )
+      return IOS_Timeout;
+    pollfd p = { fd_, events, 0 };
+    int r = ::poll( &p, 1, int( left ) );
+    if ( r == 0 )
+      return IOS_Timeout;
+    if ( r < 0 && errno != EINTR )
+      return IOS_DriverError;
+    if ( p.revents & ( POLLERR | POLLNVAL ) )
+      return IOS_DriverError;
+    return IOS_Ok;
+  }
+
+  int fd_;
+};
+
+#endif
+
+#ifdef IOS_USE_VISA
+
+/** Any VISA resource; one default resource manager for the whole DLL      */
+class VisaTransport : public Transport
+{
+public:
+  VisaTransport() : vi_( VI_NULL ) {}
+  ~VisaTransport() { if ( vi_ != VI_NULL ) viClose( vi_ ); }
+
+  Int32 open( const char* resource, const IOS_Settings& s )
+  {
+    static ViSession rm = VI_NULL;
+    static std::once_flag once;
+    std::call_once( once, [] { if ( viOpenDefaultRM( &rm ) < VI_SUCCESS ) rm = VI_NULL; } );
+    if ( rm == VI_NULL )
+      return IOS_DriverError;
+    if ( viOpen( rm, (ViRsrc)resource, VI_NULL, VI_NULL, &vi_ ) < VI_SUCCESS ) {
+      vi_ = VI_NULL;
+      return IOS_NotConnected;
+    }
+    viSetAttribute( vi_, VI_ATTR_TMO_VALUE, ViAttrState( s.timeout ) );
+    if ( s.termChar >= 0 ) {
+      viSetAttribute( vi_, VI_ATTR_TERMCHAR, ViAttrState( s.termChar ) );
+      viSetAttribute( vi_, VI_ATTR_TERMCHAR_EN, VI_TRUE );
+      viSetAttribute( vi_, VI_ATTR_ASRL_END_IN, VI_ASRL_END_TERMCHAR );
+    }
+    if ( s.baudRate > 0 )
+      viSetAttribute( vi_, VI_ATTR_ASRL_BAUD, ViAttrState( s.baudRate ) );
+    return IOS_Ok;
+  }
+
+  Int32 send( const char* data, size_t n, Int32 ) override
+  {
+    ViUInt32 done = 0;
+    ViStatus st   = viWrite( vi_, (ViBuf)data, ViUInt32( n ), &done );
+    if ( st == VI_ERROR_TMO )
+      return IOS_Timeout;
+    return ( st < VI_SUCCESS || done != n ) ? IOS_DriverError : IOS_Ok;
+  }
+
+  Int32 receive( char* data, size_t n, size_t& got, Int32 ) override
+  {
+    ViUInt32 done = 0;
+    ViStatus st   = viRead( vi_, (ViPBuf)data, ViUInt32( n ), &done );
+    if ( st == VI_ERROR_TMO )
+      return IOS_Timeout;
+    if ( st < VI_SUCCESS )
+      return IOS_DriverError;
+    got = done;
+    return done > 0 ? IOS_Ok : IOS_Timeout;
+  }
+
+private:
+  ViSession vi_;
+};
+
+#endif
+
+Int32 openTransport( const char* resource, const IOS_Settings& s, std::unique_ptr<Transport>& io )
+{
+#if defined(unix) || defined(__unix__)
+  if ( resource[0] == '/' ) {
+    std::unique_ptr<FdTransport> fd( new FdTransport );
+    Int32 r = fd->open( resource, s );
+    if ( r == IOS_Ok )
+      io = std::move( fd );
+    return r;
+  }
+#endif
+#ifdef IOS_USE_VISA
+  std::unique_ptr<VisaTransport> vi( new VisaTransport );
+  Int32 r = vi->open( resource, s );
+  if ( r == IOS_Ok )
+    io = std::move( vi );
+  return r;
+#else
+  return IOS_NotConnected;
+#endif
+}
+
+
+/* ----- Tickets, instruments and buses --------------------------------------- */
+
+struct Ticket {
+  std::mutex              m;
+  std::condition_variable cv;
+  Int32                   instrument = 0;
+  bool                    done   = false;
+  Int32                   status = IOS_Pending;
+  std::string             reply;
+
+  void complete( Int32 result, std::string data = std::string() )
+  {
+    {
+      std::lock_guard<std::mutex> lk( m );
+      status = result;
+      reply.swap( data );
+      done = true;
+    }
+    cv.notify_all();
+  }
+};
+
+struct Request {
+  enum Kind { Write, Query, Binary } kind;
+  std::string             command;
+  Int32                   nBytes;
+  std::shared_ptr<Ticket> ticket;
+};
+
+struct Instrument {
+  Int32                      id;
+  IOS_Settings               settings;
+  std::unique_ptr<Transport> io;
+  std::deque<Request>        queue;           /**< Guarded by the bus mutex      */
+  std::string                rx;              /**< Bytes read ahead, worker only */
+};
+
+class Bus
+{
+public:
+  Bus() : next_( 0 ), stop_( false ), worker_( &Bus::run, this ) {}
+
+  ~Bus()
+  {
+    {
+      std::lock_guard<std::mutex> lk( m_ );
+      stop_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+    for ( auto& inst : instruments_ )
+      failAll( *inst );
+  }
+
+  void add( const std::shared_ptr<Instrument>& inst )
+  {
+    std::lock_guard<std::mutex> lk( m_ );
+    instruments_.push_back( inst );
+  }
+
+  void remove( const std::shared_ptr<Instrument>& inst )
+  {
+    std::lock_guard<std::mutex> lk( m_ );
+    instruments_.erase( std::remove( instruments_.begin(), instruments_.end(), inst ),
+                        instruments_.end() );
+    failAll( *inst );
+  }
+
+  void push( Instrument& inst, std::vector<Request>& requests )
+  {
+    {
+      std::lock_guard<std::mutex> lk( m_ );
+      /* Closed since its tickets were handed out */
+      if ( std::none_of( instruments_.begin(), instruments_.end(),
+                         [&inst]( const std::shared_ptr<Instrument>& i ) { return i.get() == &inst; } ) ) {
+        for ( auto& r : requests )
+          r.ticket->complete( IOS_Closed );
+        return;
+      }
+      for ( auto& r : requests )
+        inst.queue.push_back( std::move( r ) );
+    }
+    cv_.notify_all();
+  }
+
+private:
+  static void failAll( Instrument& inst )
+  {
+    for ( auto& r : inst.queue )
+      r.ticket->complete( IOS_Closed );
+    inst.queue.clear();
+  }
+
+  bool pending() const
+  {
+    for ( auto& inst : instruments_ )
+      if ( !inst->queue.empty() )
+        return true;
+    return false;
+  }
+
+  /** Serves the instruments round robin, one batch of up to
+   *  pipelineDepth commands per turn.                                      */
+  void run()
+  {
+    std::unique_lock<std::mutex> lk( m_ );
+    for ( ;; ) {
+      cv_.wait( lk, [this] { return stop_ || pending(); } );
+      if ( stop_ )
+        return;
+
+      std::shared_ptr<Instrument> inst;
+      for ( size_t k = 0; k < instruments_.size() && !inst; ++k ) {
+        size_t idx = ( next_ + k ) % instruments_.size();
+        if ( !instruments_[idx]->queue.empty() ) {
+          inst  = instruments_[idx];
+          next_ = idx + 1;
+        }
+      }
+      size_t depth = size_t( std::max( 1, inst->settings.pipelineDepth ) );
+      std::vector<Request> batch;
+      while ( !inst->queue.empty() && batch.size() < depth ) {
+        batch.push_back( std::move( inst->queue.front() ) );
+        inst->queue.pop_front();
+      }
+
+      lk.unlock();
+      execute( *inst, batch );
+      lk.lock();
+    }
+  }
+
+  static void execute( Instrument& inst, std::vector<Request>& batch )
+  {
+    const IOS_Settings& s = inst.settings;
+    size_t written = 0;
+    Int32  result  = IOS_Ok;
+    for ( ; written < batch.size(); ++written ) {
+      const std::string& c = batch[written].command;
+      result = inst.io->send( c.data(), c.size(), s.timeout );
+      if ( result != IOS_Ok )
+        break;
+      if ( s.delay > 0 )
+        std::this_thread::sleep_for( std::chrono::milliseconds( s.delay ) );
+    }
+
+    for ( size_t k = 0; k < batch.size(); ++k ) {
+      Request& r = batch[k];
+      if ( k >= written || result != IOS_Ok ) {
+        r.ticket->complete( result != IOS_Ok ? result : IOS_Error );
+        continue;
+      }
+      if ( r.kind == Request::Write ) {
+        r.ticket->complete( IOS_Ok );
+        continue;
+      }
+      std::string reply;
+      Clock::time_point end = Clock::now() + std::chrono::milliseconds( s.timeout );
+      result = r.kind == Request::Query ? readLine( inst, end, reply )
+             : r.nBytes >= 0            ? readExact( inst, end, size_t( r.nBytes ), reply )
+                                        : readBlock( inst, end, reply );
+      if ( result != IOS_Ok )
+        inst.rx.clear();
+      r.ticket->complete( result, std::move( reply ) );
+    }
+  }
+
+  static Int32 fill( Instrument& inst, Clock::time_point end )
+  {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>( end - Clock::now() ).count();
+    if ( left <= 0 )
+      return IOS_Timeout;
+    char   buf[kChunk];
+    size_t got = 0;
+    Int32  r   = inst.io->receive( buf, sizeof buf, got, Int32( left ) );
+    if ( r == IOS_Ok )
+      inst.rx.append( buf, got );
+    return r;
+  }
+
+  static Int32 readLine( Instrument& inst, Clock::time_point end, std::string& out )
+  {
+    if ( inst.settings.termChar < 0 )
+      return readAvailable( inst, end, out );
+    size_t from = 0;
+    for ( ;; ) {
+      size_t pos = inst.rx.find( char( inst.settings.termChar ), from );
+      if ( pos != std::string::npos ) {
+        out.assign( inst.rx, 0, pos + 1 );
+        inst.rx.erase( 0, pos + 1 );
+        return IOS_Ok;
+      }
+      from = inst.rx.size();
+      Int32 r = fill( inst, end );
+      if ( r != IOS_Ok )
+        return r;
+    }
+  }
+
+  /** Without terminator a reply is whatever arrives in one transfer        */
+  static Int32 readAvailable( Instrument& inst, Clock::time_point end, std::string& out )
+  {
+    if ( inst.rx.empty() ) {
+      Int32 r = fill( inst, end );
+      if ( r != IOS_Ok )
+        return r;
+    }
+    out.swap( inst.rx );
+    inst.rx.clear();
+    return IOS_Ok;
+  }
+
+  static Int32 readExact( Instrument& inst, Clock::time_point end, size_t n, std::string& out )
+  {
+    while ( inst.rx.size() < n ) {
+      Int32 r = fill( inst, end );
+      if ( r != IOS_Ok )
+        return r;
+    }
+    out.assign( inst.rx, 0, n );
+    inst.rx.erase( 0, n );
+    return IOS_Ok;
+  }
+
+  static Int32 readBlock( Instrument& inst, Clock::time_point end, std::string& out )
+  {
+    std::string head;
+    Int32 r = readExact( inst, end, 2, head );
+    if ( r != IOS_Ok )
+      return r;
+    if ( head[0] != '#' || head[1] < '1' || head[1] > '9' )
+      return IOS_DriverError;
+    r = readExact( inst, end, size_t( head[1] - '0' ), head );
+    if ( r != IOS_Ok )
+      return r;
+    r = readExact( inst, end, size_t( std::strtoul( head.c_str(), 0, 10 ) ), out );
+    if ( r != IOS_Ok )
+      return r;
+
+    /* Drop the terminator sent after the block so it does not prefix the
+       next reply; it normally arrives with the data */
+    if ( inst.settings.termChar >= 0 ) {
+      if ( inst.rx.empty() )
+        fill( inst, std::min( end, Clock::now() + std::chrono::milliseconds( 50 ) ) );
+      if ( !inst.rx.empty() && inst.rx[0] == char( inst.settings.termChar ) )
+        inst.rx.erase( 0, 1 );
+    }
+    return IOS_Ok;
+  }
+
+  std::mutex                               m_;
+  std::condition_variable                  cv_;
+  std::vector<std::shared_ptr<Instrument>> instruments_;
+  size_t                                   next_;
+  bool                                     stop_;
+  std::thread                              worker_;
+};
+
+
+/* ----- Handle registry ------------------------------------------------------ */
+
+struct Registry {
+  std::mutex                                m;
+  Int32                                     nextId = 1;
+  std::map<Int32, std::shared_ptr<Bus>>     buses;
+  std::map<Int32, std::shared_ptr<Ticket>>  tickets;
+  std::map<Int32, std::pair<std::shared_ptr<Bus>, std::shared_ptr<Instrument>>> instruments;
+  size_t                                    purgeAt = kMaxTickets;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+/** Drops the tickets of closed instruments; registry mutex held. Their
+ *  waiters keep the ticket and still see it complete.                     */
+void dropTickets( Registry& reg, const std::set<Int32>& instruments )
+{
+  for ( auto i = reg.tickets.begin(); i != reg.tickets.end(); )
+    i = instruments.count( i->second->instrument ) ? reg.tickets.erase( i ) : std::next( i );
+}
+
+/** Bounds the tickets nobody waits for or releases: once more than
+ *  kMaxTickets are held, the oldest completed ones are dropped until half
+ *  of them remain. Registry mutex held.                                    */
+void purgeTickets( Registry& reg )
+{
+  if ( reg.tickets.size() <= reg.purgeAt )
+    return;
+  for ( auto i = reg.tickets.begin(); i != reg.tickets.end() && reg.tickets.size() > kMaxTickets / 2; ) {
+    bool done;
+    {
+      std::lock_guard<std::mutex> lk( i->second->m );
+      done = i->second->done;
+    }
+    i = done ? reg.tickets.erase( i ) : std::next( i );
+  }
+  /* Mostly pending: do not rescan on every call */
+  reg.purgeAt = std::max( kMaxTickets, reg.tickets.size() + kMaxTickets / 4 );
+}
+
+/** Queues requests for an instrument and hands out their tickets           */
+Int32 enqueue( Int32 instrument, std::vector<Request>& requests, Int32* tickets )
+{
+  Registry& reg = registry();
+  std::shared_ptr<Bus>        bus;
+  std::shared_ptr<Instrument> inst;
+  {
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.instruments.find( instrument );
+    if ( it == reg.instruments.end() )
+      return IOS_NotConnected;
+    bus  = it->second.first;
+    inst = it->second.second;
+    purgeTickets( reg );
+    for ( size_t k = 0; k < requests.size(); ++k ) {
+      requests[k].ticket = std::make_shared<Ticket>();
+      requests[k].ticket->instrument = instrument;
+      tickets[k]         = reg.nextId++;
+      reg.tickets[tickets[k]] = requests[k].ticket;
+    }
+  }
+  bus->push( *inst, requests );
+  return IOS_Ok;
+}
+
+Int32 enqueueOne( Int32 instrument, Request::Kind kind, const char* command, Int32 nBytes, Int32* ticket )
+{
+  if ( !command || !ticket )
+    return IOS_InvalidParam;
+  std::vector<Request> r( 1 );
+  r[0].kind    = kind;
+  r[0].command = command;
+  r[0].nBytes  = nBytes;
+  try {
+    return enqueue( instrument, r, ticket );
+  }
+  catch ( ... ) {
+    return IOS_Error;
+  }
+}
+
+} // namespace
+
+
+Int32 IOS_API IOS_createBus( Int32* bus )
+{
+  if ( !bus )
+    return IOS_InvalidParam;
+  try {
+    std::shared_ptr<Bus> b = std::make_shared<Bus>();
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *bus = reg.nextId++;
+    reg.buses[*bus] = b;
+    return IOS_Ok;
+  }
+  catch ( ... ) {
+    return IOS_Error;
+  }
+}
+
+
+Int32 IOS_API IOS_closeBus( Int32 bus )
+{
+  Registry& reg = registry();
+  std::shared_ptr<Bus> b;
+  {
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.buses.find( bus );
+    if ( it == reg.buses.end() )
+      return IOS_NotConnected;
+    b = it->second;
+    reg.buses.erase( it );
+    std::set<Int32> closed;
+    for ( auto i = reg.instruments.begin(); i != reg.instruments.end(); ) {
+      if ( i->second.first == b ) {
+        closed.insert( i->first );
+        i = reg.instruments.erase( i );
+      }
+      else
+        ++i;
+    }
+    dropTickets( reg, closed );
+  }
+  b.reset();   /* joins the worker once the last enqueue has finished */
+  return IOS_Ok;
+}
+
+
+Int32 IOS_API IOS_openInstrument( Int32 bus,
+                                  const char* resource,
+                                  const IOS_Settings* settings,
+                                  Int32* instrument )
+{
+  if ( !resource || !instrument )
+    return IOS_InvalidParam;
+  const IOS_Settings& s = settings ? *settings : kDefaultSettings;
+  if ( s.timeout <= 0 || s.termChar > 255 || s.delay < 0 )
+    return IOS_InvalidParam;
+
+  try {
+    Registry& reg = registry();
+    std::shared_ptr<Bus> b;
+    {
+      std::lock_guard<std::mutex> lk( reg.m );
+      auto it = reg.buses.find( bus );
+      if ( it == reg.buses.end() )
+        return IOS_NotConnected;
+      b = it->second;
+    }
+
+    std::shared_ptr<Instrument> inst = std::make_shared<Instrument>();
+    inst->settings = s;
+    Int32 r = openTransport( resource, s, inst->io );
+    if ( r != IOS_Ok )
+      return r;
+
+    std::lock_guard<std::mutex> lk( reg.m );
+    if ( !reg.buses.count( bus ) )
+      return IOS_NotConnected;
+    inst->id    = reg.nextId++;
+    *instrument = inst->id;
+    reg.instruments[inst->id] = std::make_pair( b, inst );
+    b->add( inst );
+    return IOS_Ok;
+  }
+  catch ( ... ) {
+    return IOS_Error;
+  }
+}
+
+
+Int32 IOS_API IOS_closeInstrument( Int32 instrument )
+{
+  Registry& reg = registry();
+  std::shared_ptr<Bus>        b;
+  std::shared_ptr<Instrument> inst;
+  {
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.instruments.find( instrument );
+    if ( it == reg.instruments.end() )
+      return IOS_NotConnected;
+    b    = it->second.first;
+    inst = it->second.second;
+    reg.instruments.erase( it );
+    dropTickets( reg, std::set<Int32>{ instrument } );
+  }
+  b->remove( inst );
+  return IOS_Ok;
+}
+
+
+Int32 IOS_API IOS_write( Int32 instrument, const char* command, Int32* ticket )
+{
+  return enqueueOne( instrument, Request::Write, command, 0, ticket );
+}
+
+
+Int32 IOS_API IOS_query( Int32 instrument, const char* command, Int32* ticket )
+{
+  return enqueueOne( instrument, Request::Query, command, 0, ticket );
+}
+
+
+Int32 IOS_API IOS_queryBinary( Int32 instrument,
+                               const char* command,
+                               Int32 nBytes,
+                               Int32* ticket )
+{
+  return enqueueOne( instrument, Request::Binary, command, nBytes < 0 ? -1 : nBytes, ticket );
+}
+
+
+Int32 IOS_API IOS_queryBatch( Int32 instrument,
+                              const char* commands,
+                              const char* terminator,
+                              Int32* tickets,
+                              Int32 count,
+                              Int32* queued )
+{
+  if ( !commands || !terminator || !queued || count < 0 || ( count > 0 && !tickets ) )
+    return IOS_InvalidParam;
+  try {
+    std::vector<Request> r;
+    for ( const char* p = commands; *p; ) {
+      const char* e = std::strchr( p, '\n' );
+      size_t      n = e ? size_t( e - p ) : std::strlen( p );
+      if ( n > 0 ) {
+        Request q;
+        q.kind    = Request::Query;
+        q.command.assign( p, n );
+        q.command += terminator;
+        q.nBytes  = 0;
+        r.push_back( std::move( q ) );
+      }
+      p += n + ( e ? 1 : 0 );
+    }
+    *queued = Int32( r.size() );
+    if ( Int32( r.size() ) > count )
+      return IOS_BufferTooSmall;
+    return enqueue( instrument, r, tickets );
+  }
+  catch ( ... ) {
+    return IOS_Error;
+  }
+}
+
+
+Int32 IOS_API IOS_ready( Int32 ticket, Bln32* done )
+{
+  if ( !done )
+    return IOS_InvalidParam;
+  Registry& reg = registry();
+  std::shared_ptr<Ticket> t;
+  {
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.tickets.find( ticket );
+    if ( it == reg.tickets.end() )
+      return IOS_NotConnected;
+    t = it->second;
+  }
+  std::lock_guard<std::mutex> lk( t->m );
+  *done = t->done;
+  return IOS_Ok;
+}
+
+
+Int32 IOS_API IOS_wait( Int32 ticket,
+                        Int32 timeout,
+                        char* reply,
+                        Int32 size,
+                        Int32* length )
+{
+  if ( !length || size < 0 || ( size > 0 && !reply ) )
+    return IOS_InvalidParam;
+  Registry& reg = registry();
+  std::shared_ptr<Ticket> t;
+  {
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.tickets.find( ticket );
+    if ( it == reg.tickets.end() )
+      return IOS_NotConnected;
+    t = it->second;
+  }
+
+  std::unique_lock<std::mutex> lk( t->m );
+  auto isDone = [&t] { return t->done; };
+  if ( timeout < 0 )
+    t->cv.wait( lk, isDone );
+  else if ( !t->cv.wait_for( lk, std::chrono::milliseconds( timeout ), isDone ) )
+    return IOS_Pending;
+
+  *length = Int32( t->reply.size() );
+  if ( t->reply.size() > size_t( size ) )
+    return IOS_BufferTooSmall;
+  if ( !t->reply.empty() )
+    std::memcpy( reply, t->reply.data(), t->reply.size() );
+  Int32 status = t->status;
+  lk.unlock();
+
+  std::lock_guard<std::mutex> rl( reg.m );
+  reg.tickets.erase( ticket );
+  return status;
+}
+
+
+Int32 IOS_API IOS_release( Int32 ticket )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.tickets.erase( ticket ) ? IOS_Ok : IOS_NotConnected;
+}
+
+
+Int32 IOS_API IOS_queryWait( Int32 instrument,
+                             const char* command,
+                             char* reply,
+                             Int32 size,
+                             Int32* length )
+{
+  Int32 ticket = 0;
+  Int32 r = IOS_query( instrument, command, &ticket );
+  if ( r != IOS_Ok )
+    return r;
+  r = IOS_wait( ticket, -1, reply, size, length );
+  if ( r == IOS_BufferTooSmall )
+    IOS_release( ticket );
+  return r;
+}
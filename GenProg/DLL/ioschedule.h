@@ -0,0 +1,239 @@
+/******************************************************************/
+/** @file ioschedule.h
+ *  Instrument I/O scheduler DLL
+ *
+ *  Runs the read/write traffic of the instrument drivers (the *VisaRW.vi
+ *  family and VisaRWGen.vi) on background workers, one per bus or
+ *  serial port, so that instruments on different buses are queried
+ *  concurrently. Each instrument owns a command queue; every queued
+ *  command returns a ticket that is waited on later, so a measurement
+ *  loop costs the slowest instrument rather than the sum of all of them.
+ *
+ *  Instruments are opened either on a POSIX device (serial port, pty) or,
+ *  when the DLL is built with IOS_USE_VISA, on any VISA resource.
+ */
+/******************************************************************/
+
+#ifndef __IOSCHEDULE_H__
+#define __IOSCHEDULE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define IOS_API
+#else
+#ifdef  DLL_EXPORT
+#define IOS_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define IOS_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define IOS_Ok                   0              /**< No error                              */
+#define IOS_Error              (-1)             /**< Unspecified error                     */
+#define IOS_NotConnected        -2              /**< Handle does not exist (anymore)       */
+#define IOS_DriverError         -3              /**< Error reported by the port or VISA    */
+#define IOS_Timeout             -6              /**< Instrument did not answer in time     */
+#define IOS_InvalidParam        -9              /**< Parameter out of range                */
+#define IOS_BufferTooSmall     -10              /**< Reply does not fit, ticket is kept    */
+#define IOS_Pending            -11              /**< Ticket not completed yet              */
+#define IOS_Closed             -12              /**< Instrument closed before completion   */
+
+
+/** @brief  Instrument settings                                                      */
+typedef struct {
+  Int32 baudRate;                            /**< Serial baud rate, 0 keeps the port setting */
+  Int32 termChar;                            /**< Reply terminator, -1 for none      */
+  Int32 timeout;                             /**< Read/write timeout in ms           */
+  Int32 pipelineDepth;                       /**< Queries written before reading back,
+                                                  1 disables pipelining             */
+  Int32 delay;                               /**< Pause after each write in ms       */
+} IOS_Settings;
+
+
+/** @brief Create a bus
+ *
+ *  A bus owns one worker thread. Instruments sharing a physical bus
+ *  (GPIB, RS-485) must be opened on the same bus; instruments on separate
+ *  ports should get one bus each to be served in parallel.
+ *
+ *  @param  bus      Output: bus handle
+ *  @return          Result of function
+ */
+Int32 IOS_API IOS_createBus( Int32* bus );
+
+
+/** @brief Close a bus
+ *
+ *  Stops the worker and closes every instrument of the bus. Pending
+ *  tickets complete with @ref IOS_Closed; like all tickets of the bus they
+ *  are released, so only calls already waiting see the result.
+ *
+ *  @param  bus      Bus handle
+ *  @return          Result of function
+ */
+Int32 IOS_API IOS_closeBus( Int32 bus );
+
+
+/** @brief Open an instrument
+ *
+ *  @param  bus        Bus handle
+ *  @param  resource   Device path ("/dev/ttyUSB0", pty slave) or, with VISA
+ *                     support, a VISA resource ("GPIB0::8::INSTR")
+ *  @param  settings   Port settings, NULL for 9600 baud, LF, 2 s, no pipelining
+ *  @param  instrument Output: instrument handle
+ *  @return            Result of function
+ */
+Int32 IOS_API IOS_openInstrument( Int32 bus,
+                                  const char* resource,
+                                  const IOS_Settings* settings,
+                                  Int32* instrument );
+
+
+/** @brief Close an instrument
+ *
+ *  Queued tickets complete with @ref IOS_Closed, the command in progress
+ *  finishes. All tickets of the instrument are released; only calls
+ *  already waiting see their result.
+ *
+ *  @param  instrument Instrument handle
+ *  @return            Result of function
+ */
+Int32 IOS_API IOS_closeInstrument( Int32 instrument );
+
+
+/** @brief Queue a command without reply
+ *
+ *  @param  instrument Instrument handle
+ *  @param  command    Command including its terminator
+ *  @param  ticket     Output: ticket completed once the command is written
+ *  @return            Result of function
+ */
+Int32 IOS_API IOS_write( Int32 instrument, const char* command, Int32* ticket );
+
+
+/** @brief Queue a query
+ *
+ *  The reply is read up to and including the terminator character.
+ *
+ *  @param  instrument Instrument handle
+ *  @param  command    Command including its terminator
+ *  @param  ticket     Output: ticket holding the reply
+ *  @return            Result of function
+ */
+Int32 IOS_API IOS_query( Int32 instrument, const char* command, Int32* ticket );
+
+
+/** @brief Queue a binary query
+ *
+ *  Reads exactly nBytes bytes of reply. With nBytes < 0 the reply is
+ *  an IEEE 488.2 definite length block ("#<n><length><data>") and only
+ *  the data bytes are kept; a trailing terminator is consumed.
+ *
+ *  @param  instrument Instrument handle
+ *  @param  command    Command including its terminator
+ *  @param  nBytes     Reply length in bytes, or -1 for a 488.2 block
+ *  @param  ticket     Output: ticket holding the reply
+ *  @return            Result of function
+ */
+Int32 IOS_API IOS_queryBinary( Int32 instrument,
+                               const char* command,
+                               Int32 nBytes,
+                               Int32* ticket );
+
+
+/** @brief Queue a batch of queries
+ *
+ *  Queues count queries in one call; commands are separated by '\\n'
+ *  in commands and the terminator is appended to each of them.
+ *  Consecutive queries are pipelined up to the instrument's
+ *  pipelineDepth.
+ *
+ *  @param  instrument Instrument handle
+ *  @param  commands   '\\n' separated commands
+ *  @param  terminator Terminator appended to each command
+ *  @param  tickets    Output: one ticket per query
+ *  @param  count      Number of elements of tickets
+ *  @param  queued     Output: number of queries queued
+ *  @return            Result of function
+ */
+Int32 IOS_API IOS_queryBatch( Int32 instrument,
+                              const char* commands,
+                              const char* terminator,
+                              Int32* tickets,
+                              Int32 count,
+                              Int32* queued );
+
+
+/** @brief Check a ticket without blocking
+ *
+ *  @param  ticket   Ticket
+ *  @param  done     Output: true if the ticket is completed
+ *  @return          Result of function
+ */
+Int32 IOS_API IOS_ready( Int32 ticket, Bln32* done );
+
+
+/** @brief Wait for a ticket and fetch its reply
+ *
+ *  The ticket is released once its reply has been copied, unless the
+ *  buffer is too small; length then holds the required size.
+ *
+ *  @param  ticket   Ticket
+ *  @param  timeout  Maximum waiting time in ms, < 0 waits forever
+ *  @param  reply    Output: reply bytes (may be NULL if size is 0)
+ *  @param  size     Size of the reply buffer
+ *  @param  length   Output: number of reply bytes
+ *  @return          Result of the command, @ref IOS_Pending on timeout
+ */
+Int32 IOS_API IOS_wait( Int32 ticket,
+                        Int32 timeout,
+                        char* reply,
+                        Int32 size,
+                        Int32* length );
+
+
+/** @brief Discard a ticket
+ *
+ *  The command still runs but its reply is dropped. Tickets neither
+ *  waited on nor released are dropped when their instrument is closed,
+ *  and the oldest completed ones once 65536 tickets are outstanding.
+ *
+ *  @param  ticket   Ticket
+ *  @return          Result of function
+ */
+Int32 IOS_API IOS_release( Int32 ticket );
+
+
+/** @brief Synchronous query
+ *
+ *  Shorthand for @ref IOS_query followed by @ref IOS_wait. Commands
+ *  queued earlier on the instrument are executed first.
+ *
+ *  @param  instrument Instrument handle
+ *  @param  command    Command including its terminator
+ *  @param  reply      Output: reply bytes
+ *  @param  size       Size of the reply buffer
+ *  @param  length     Output: number of reply bytes
+ *  @return            Result of function
+ */
+Int32 IOS_API IOS_queryWait( Int32 instrument,
+                             const char* command,
+                             char* reply,
+                             Int32 size,
+                             Int32* length );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,655 @@
+/******************************************************************/
+/** @file motionstart.cpp
+ *  Motion startup orchestration DLL
+ *
+ *  Implementation of @ref motionstart.h
+ */
+/******************************************************************/
+
+/* Imported interfaces first, so that DLL_EXPORT applies to this DLL only */
+#include "ioschedule.h"
+#ifdef MOT_USE_AMC
+#include <cstddef>
+#include "amc.h"
+#endif
+
+#define DLL_EXPORT
+#include "motionstart.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const Int32 kAmcPoll   = 50;       /**< status poll interval of AMC axes [ms] */
+const Int32 kSchedPoll = 50;       /**< timeout check of external stages [ms] */
+
+enum Kind { kAmcConnect, kAmcReference, kSerial, kExternal };
+
+struct Stage {
+  Kind               kind = kExternal;
+  std::string        name;
+  Int32              timeout = 0;
+  std::string        address;
+  Int32              connect = 0, handle = -1, axis = 0, target = 0;
+  Int32              instrument = 0, interval = 100;
+  std::string        setup, poll, done;
+  std::vector<Int32> after;           /**< prerequisite stage ids        */
+  Int32              state   = MOT_Waiting;
+  Int32              result  = MOT_Ok;
+  bool               claimed = false;
+  Clock::time_point  t0, t1;
+};
+
+bool terminal( Int32 state ) { return state >= MOT_Done; }
+
+std::string trim( const std::string& s )
+{
+  size_t a = s.find_first_not_of( " \t\r\n" ), b = s.find_last_not_of( " \t\r\n" );
+  return a == std::string::npos ? std::string() : s.substr( a, b - a + 1 );
+}
+
+
+class Plan
+{
+public:
+  ~Plan() { stop(); }
+
+  std::mutex              m;
+  std::condition_variable cv;
+  std::vector<Stage>      stages;        /**< stage id = index + 1        */
+  bool                    started  = false;
+  bool                    finished = false;
+  std::atomic<bool>       aborted{ false };
+  Clock::time_point       t0;
+
+  Stage* stage( Int32 id ) { return id >= 1 && size_t( id ) <= stages.size() ? &stages[id - 1] : 0; }
+
+  Int32 add( const Stage& s, Int32* id )
+  {
+    std::lock_guard<std::mutex> lk( m );
+    if ( started )
+      return MOT_Busy;
+    stages.push_back( s );
+    *id = Int32( stages.size() );
+    return MOT_Ok;
+  }
+
+  /** Kahn's algorithm over the prerequisites                             */
+  bool acyclic() const
+  {
+    std::vector<Int32> pending( stages.size() );
+    std::vector<Int32> ready;
+    for ( size_t k = 0; k < stages.size(); ++k )
+      if ( !( pending[k] = Int32( stages[k].after.size() ) ) )
+        ready.push_back( Int32( k ) );
+    size_t seen = 0;
+    while ( !ready.empty() ) {
+      Int32 k = ready.back();
+      ready.pop_back();
+      ++seen;
+      for ( size_t j = 0; j < stages.size(); ++j )
+        for ( Int32 b : stages[j].after )
+          if ( b == k + 1 && !--pending[j] )
+            ready.push_back( Int32( j ) );
+    }
+    return seen == stages.size();
+  }
+
+  void start()
+  {
+    started     = true;
+    t0          = Clock::now();
+    coordinator = std::thread( [this] { schedule(); } );
+  }
+
+  void stop()
+  {
+    aborted = true;
+    cv.notify_all();
+    if ( coordinator.joinable() )
+      coordinator.join();
+    std::vector<std::thread> pending;
+    {
+      std::lock_guard<std::mutex> lk( m );
+      pending.swap( connectors );
+    }
+    for ( std::thread& t : pending )
+      t.join();
+  }
+
+  /** Sleeps, false if aborted meanwhile                                  */
+  bool pause( Int32 ms )
+  {
+    std::unique_lock<std::mutex> lk( m );
+    return !cv.wait_for( lk, std::chrono::milliseconds( ms ), [this] { return aborted.load(); } );
+  }
+
+  /** Ends a stage run by a worker or the caller; call with m held       */
+  void end( Stage& s, Int32 result )
+  {
+    s.t1     = Clock::now();
+    s.result = result;
+    s.state  = result == MOT_Ok ? MOT_Done : aborted ? MOT_Aborted : MOT_Failed;
+    cv.notify_all();
+  }
+
+private:
+  std::thread              coordinator;
+  std::vector<std::thread> workers;
+  std::vector<std::thread> connectors;   /**< AMC_Connect calls, joined by stop */
+
+  void schedule()
+  {
+    std::unique_lock<std::mutex> lk( m );
+    for ( ;; ) {
+      bool all = true;
+      for ( size_t k = 0; k < stages.size(); ++k ) {
+        Stage& s = stages[k];
+        if ( s.state == MOT_Waiting ) {
+          bool ready = true, broken = false;
+          for ( Int32 b : s.after ) {
+            Int32 st = stages[b - 1].state;
+            ready  = ready && st == MOT_Done;
+            broken = broken || ( terminal( st ) && st != MOT_Done );
+          }
+          if ( aborted ) {
+            s.state  = MOT_Aborted;
+            s.result = MOT_Abort;
+          }
+          else if ( broken ) {
+            s.state  = MOT_Skipped;
+            s.result = MOT_Error;
+          }
+          else if ( ready ) {
+            s.state = MOT_Running;
+            s.t0    = Clock::now();
+            if ( s.kind != kExternal ) {
+              Int32 id = Int32( k + 1 );
+              workers.emplace_back( [this, id] { work( id ); } );
+            }
+          }
+        }
+        if ( s.state == MOT_Running && s.kind == kExternal ) {
+          if ( aborted )
+            end( s, MOT_Abort );
+          else if ( Clock::now() - s.t0 > std::chrono::milliseconds( s.timeout ) )
+            end( s, MOT_Timeout );
+        }
+        all = all && terminal( s.state );
+      }
+      if ( all )
+        break;
+      cv.wait_for( lk, std::chrono::milliseconds( kSchedPoll ) );
+    }
+    finished = true;
+    cv.notify_all();
+    lk.unlock();
+    for ( std::thread& t : workers )
+      t.join();
+  }
+
+  void work( Int32 id )
+  {
+    Stage s;
+    {
+      std::lock_guard<std::mutex> lk( m );
+      s = stages[id - 1];
+      if ( s.kind == kAmcReference && s.connect )
+        s.handle = stages[s.connect - 1].handle;
+    }
+    Clock::time_point deadline = s.t0 + std::chrono::milliseconds( s.timeout );
+    Int32 handle = -1, r;
+    switch ( s.kind ) {
+    case kAmcConnect:   r = amcConnect( s, deadline, handle ); break;
+    case kAmcReference: r = amcReference( s, deadline ); break;
+    case kSerial:       r = serial( s, deadline ); break;
+    default:            r = MOT_Error; break;
+    }
+    std::lock_guard<std::mutex> lk( m );
+    if ( s.kind == kAmcConnect && r == MOT_Ok )
+      stages[id - 1].handle = handle;
+    end( stages[id - 1], r );
+  }
+
+  /** AMC_Connect cannot be interrupted, so the stage stops waiting for
+   *  it at the deadline or an abort; a connection completing later is
+   *  closed. The call itself is joined when the plan is released, so no
+   *  thread outlives the DLL.                                            */
+  Int32 amcConnect( const Stage& s, Clock::time_point deadline, Int32& handle )
+  {
+#ifdef MOT_USE_AMC
+    struct Attempt {
+      std::mutex              m;
+      std::condition_variable cv;
+      bool                    done = false, abandoned = false;
+      Int32                   result = MOT_Error, handle = -1;
+    };
+    std::shared_ptr<Attempt> at = std::make_shared<Attempt>();
+    std::string address = s.address;
+    std::thread t( [at, address] {
+      Int32 h = -1, r = AMC_Connect( address.c_str(), &h );
+      std::lock_guard<std::mutex> lk( at->m );
+      if ( at->abandoned ) {
+        if ( r == NCB_Ok )
+          AMC_Close( h );
+        return;
+      }
+      at->done   = true;
+      at->result = r;
+      at->handle = h;
+      at->cv.notify_all();
+    } );
+    {
+      std::lock_guard<std::mutex> lk( m );
+      connectors.push_back( std::move( t ) );
+    }
+
+    std::unique_lock<std::mutex> lk( at->m );
+    while ( !at->done && !aborted && Clock::now() < deadline )
+      at->cv.wait_until( lk, std::min( deadline, Clock::now() + std::chrono::milliseconds( kAmcPoll ) ) );
+    if ( !at->done ) {
+      at->abandoned = true;
+      return aborted ? MOT_Abort : MOT_Timeout;
+    }
+    handle = at->handle;
+    return at->result;
+#else
+    ( void )s;
+    ( void )deadline;
+    ( void )handle;
+    return MOT_NotSupported;
+#endif
+  }
+
+  Int32 amcReference( const Stage& s, Clock::time_point deadline )
+  {
+#ifdef MOT_USE_AMC
+    Bln32 on = 1, off = 0, valid = 0, inRange = 0;
+    Int32 target = s.target, r;
+    if ( ( r = AMC_getStatusReference( s.handle, s.axis, &valid ) ) != NCB_Ok || valid )
+      return r;
+    if ( ( r = AMC_controlOutput( s.handle, s.axis, &on, 1 ) ) != NCB_Ok
+         || ( r = AMC_controlTargetPosition( s.handle, s.axis, &target, 1 ) ) != NCB_Ok
+         || ( r = AMC_controlMove( s.handle, s.axis, &on, 1 ) ) != NCB_Ok )
+      return r;
+    for ( ;; ) {
+      if ( !pause( kAmcPoll ) ) {
+        AMC_controlMove( s.handle, s.axis, &off, 1 );
+        return MOT_Abort;
+      }
+      if ( ( r = AMC_getStatusReference( s.handle, s.axis, &valid ) ) != NCB_Ok )
+        break;
+      if ( valid )
+        break;
+      if ( ( r = AMC_getStatusTargetRange( s.handle, s.axis, &inRange ) ) != NCB_Ok )
+        break;
+      if ( inRange ) {
+        r = MOT_NoReference;
+        break;
+      }
+      if ( Clock::now() > deadline ) {
+        r = MOT_Timeout;
+        break;
+      }
+    }
+    AMC_controlMove( s.handle, s.axis, &off, 1 );
+    return r;
+#else
+    ( void )s;
+    ( void )deadline;
+    return MOT_NotSupported;
+#endif
+  }
+
+  Int32 serial( const Stage& s, Clock::time_point deadline )
+  {
+    Int32 r, length = 0, ticket;
+    if ( !s.setup.empty() ) {
+      if ( ( r = IOS_write( s.instrument, s.setup.c_str(), &ticket ) ) != IOS_Ok )
+        return r;
+      Int32 left = Int32( std::chrono::duration_cast<std::chrono::milliseconds>( deadline - Clock::now() ).count() );
+      if ( ( r = IOS_wait( ticket, left > 0 ? left : 0, 0, 0, &length ) ) != IOS_Ok ) {
+        IOS_release( ticket );
+        return r == IOS_Pending ? MOT_Timeout : r;
+      }
+    }
+    for ( ;; ) {
+      char reply[256];
+      if ( ( r = IOS_queryWait( s.instrument, s.poll.c_str(), reply, sizeof reply - 1, &length ) ) != IOS_Ok )
+        return r;
+      reply[length] = '\0';
+      if ( trim( reply ) == s.done )
+        return MOT_Ok;
+      if ( Clock::now() > deadline )
+        return MOT_Timeout;
+      if ( !pause( s.interval ) )
+        return MOT_Abort;
+    }
+  }
+};
+
+
+struct Registry {
+  std::mutex                             m;
+  Int32                                  nextId = 1;
+  std::map<Int32, std::shared_ptr<Plan>> plans;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Plan> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.plans.find( handle );
+  return it == reg.plans.end() ? std::shared_ptr<Plan>() : it->second;
+}
+
+} // namespace
+
+
+Int32 MOT_API MOT_create( Int32* plan )
+{
+  if ( !plan )
+    return MOT_InvalidParam;
+  try {
+    std::shared_ptr<Plan> p = std::make_shared<Plan>();
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *plan = reg.nextId++;
+    reg.plans[*plan] = p;
+    return MOT_Ok;
+  }
+  catch ( ... ) {
+    return MOT_Error;
+  }
+}
+
+
+Int32 MOT_API MOT_close( Int32 plan )
+{
+  std::shared_ptr<Plan> p;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.plans.find( plan );
+    if ( it == reg.plans.end() )
+      return MOT_NotConnected;
+    p = it->second;
+    reg.plans.erase( it );
+  }
+  p->stop();
+  return MOT_Ok;
+}
+
+
+Int32 MOT_API MOT_addAmcConnect( Int32 plan,
+                                 const char* name,
+                                 const char* address,
+                                 Int32 timeout,
+                                 Int32* stage )
+{
+  if ( !name || !address || timeout < 1 || !stage )
+    return MOT_InvalidParam;
+#ifndef MOT_USE_AMC
+  ( void )plan;
+  return MOT_NotSupported;
+#else
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  Stage s;
+  s.kind    = kAmcConnect;
+  s.name    = name;
+  s.address = address;
+  s.timeout = timeout;
+  return p->add( s, stage );
+#endif
+}
+
+
+Int32 MOT_API MOT_addAmcReference( Int32 plan,
+                                   const char* name,
+                                   Int32 connect,
+                                   Int32 handle,
+                                   Int32 axis,
+                                   Int32 target,
+                                   Int32 timeout,
+                                   Int32* stage )
+{
+  if ( !name || axis < 0 || axis > 2 || timeout < 1 || !stage || ( !connect && handle < 0 ) )
+    return MOT_InvalidParam;
+#ifndef MOT_USE_AMC
+  ( void )plan;
+  ( void )target;
+  return MOT_NotSupported;
+#else
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  Stage s;
+  s.kind    = kAmcReference;
+  s.name    = name;
+  s.connect = connect;
+  s.handle  = handle;
+  s.axis    = axis;
+  s.target  = target;
+  s.timeout = timeout;
+  if ( connect ) {
+    std::lock_guard<std::mutex> lk( p->m );
+    Stage* c = p->stage( connect );
+    if ( !c || c->kind != kAmcConnect )
+      return MOT_InvalidParam;
+    s.after.push_back( connect );
+  }
+  return p->add( s, stage );
+#endif
+}
+
+
+Int32 MOT_API MOT_addSerial( Int32 plan,
+                             const char* name,
+                             Int32 instrument,
+                             const char* setup,
+                             const char* poll,
+                             const char* done,
+                             Int32 interval,
+                             Int32 timeout,
+                             Int32* stage )
+{
+  if ( !name || !setup || !poll || !*poll || !done || interval < 1 || timeout < 1 || !stage )
+    return MOT_InvalidParam;
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  Stage s;
+  s.kind       = kSerial;
+  s.name       = name;
+  s.instrument = instrument;
+  s.setup      = setup;
+  s.poll       = poll;
+  s.done       = trim( done );
+  s.interval   = interval;
+  s.timeout    = timeout;
+  return p->add( s, stage );
+}
+
+
+Int32 MOT_API MOT_addExternal( Int32 plan, const char* name, Int32 timeout, Int32* stage )
+{
+  if ( !name || timeout < 1 || !stage )
+    return MOT_InvalidParam;
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  Stage s;
+  s.kind    = kExternal;
+  s.name    = name;
+  s.timeout = timeout;
+  return p->add( s, stage );
+}
+
+
+Int32 MOT_API MOT_after( Int32 plan, Int32 stage, Int32 before )
+{
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  if ( p->started )
+    return MOT_Busy;
+  Stage* s = p->stage( stage );
+  if ( !s || !p->stage( before ) || stage == before )
+    return MOT_InvalidParam;
+  s->after.push_back( before );
+  return MOT_Ok;
+}
+
+
+Int32 MOT_API MOT_start( Int32 plan )
+{
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  if ( p->started )
+    return MOT_Busy;
+  if ( !p->acyclic() )
+    return MOT_Cycle;
+  try {
+    p->start();
+  }
+  catch ( ... ) {
+    return MOT_Error;
+  }
+  return MOT_Ok;
+}
+
+
+Int32 MOT_API MOT_claim( Int32 plan, Int32* stage )
+{
+  if ( !stage )
+    return MOT_InvalidParam;
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  for ( size_t k = 0; k < p->stages.size(); ++k ) {
+    Stage& s = p->stages[k];
+    if ( s.kind == kExternal && s.state == MOT_Running && !s.claimed ) {
+      s.claimed = true;
+      *stage    = Int32( k + 1 );
+      return MOT_Ok;
+    }
+  }
+  return MOT_NoData;
+}
+
+
+Int32 MOT_API MOT_finish( Int32 plan, Int32 stage, Int32 result )
+{
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  Stage* s = p->stage( stage );
+  if ( !s || s->kind != kExternal || !s->claimed )
+    return MOT_InvalidParam;
+  if ( s->state == MOT_Running )
+    p->end( *s, result );
+  return MOT_Ok;
+}
+
+
+Int32 MOT_API MOT_wait( Int32 plan, Int32 timeout, Int32* failed )
+{
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  std::unique_lock<std::mutex> lk( p->m );
+  if ( !p->started )
+    return MOT_InvalidParam;
+  auto over = [&] { return p->finished; };
+  if ( timeout < 0 )
+    p->cv.wait( lk, over );
+  else
+    p->cv.wait_for( lk, std::chrono::milliseconds( timeout ), over );
+  if ( failed ) {
+    *failed = 0;
+    for ( const Stage& s : p->stages )
+      *failed += s.state != MOT_Done;
+  }
+  return p->finished ? MOT_Ok : MOT_Timeout;
+}
+
+
+Int32 MOT_API MOT_abort( Int32 plan )
+{
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  p->aborted = true;
+  p->cv.notify_all();
+  return MOT_Ok;
+}
+
+
+Int32 MOT_API MOT_status( Int32 plan,
+                          Int32 stage,
+                          Int32* state,
+                          Int32* result,
+                          double* started,
+                          double* elapsed )
+{
+  if ( !state )
+    return MOT_InvalidParam;
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  Stage* s = p->stage( stage );
+  if ( !s )
+    return MOT_NotConnected;
+  typedef std::chrono::duration<double> Seconds;
+  bool run = s->state != MOT_Waiting && s->t0 != Clock::time_point();
+  *state = s->state;
+  if ( result )
+    *result = s->result;
+  if ( started )
+    *started = run ? Seconds( s->t0 - p->t0 ).count() : -1.;
+  if ( elapsed )
+    *elapsed = !run ? 0. : Seconds( ( terminal( s->state ) ? s->t1 : Clock::now() ) - s->t0 ).count();
+  return MOT_Ok;
+}
+
+
+Int32 MOT_API MOT_amcHandle( Int32 plan, Int32 stage, Int32* handle )
+{
+  if ( !handle )
+    return MOT_InvalidParam;
+  std::shared_ptr<Plan> p = find( plan );
+  if ( !p )
+    return MOT_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  Stage* s = p->stage( stage );
+  if ( !s || s->kind != kAmcConnect )
+    return MOT_InvalidParam;
+  if ( s->state != MOT_Done )
+    return MOT_NoData;
+  *handle = s->handle;
+  return MOT_Ok;
+}
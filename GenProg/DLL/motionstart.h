@@ -0,0 +1,258 @@
+/******************************************************************/
+/** @file motionstart.h
+ *  Motion startup orchestration DLL
+ *
+ *  Runs the initialization and homing of all motion stages of the rig
+ *  concurrently instead of one after another, so that a cold start
+ *  takes as long as the slowest chain of stages. A stage is one of
+ *    - AMC connect: @ref AMC_Connect of a controller
+ *    - AMC reference: approach of a target past the reference mark
+ *      until @ref AMC_getStatusReference is valid
+ *    - serial: setup commands and a polled "done" query on an
+ *      instrument of @ref ioschedule.h (ESP301 "1MO;1OR" / "1MD?",
+ *      Triax320 initialization...)
+ *    - external: done by LabVIEW (KDC101_Init.vi / KDC101_Home.vi over
+ *      Kinesis), which claims the stage when it may start and reports
+ *      its result
+ *  Stages that must not move at the same time, or need another stage
+ *  first, are ordered with @ref MOT_after; a stage whose prerequisite
+ *  fails is skipped. AMC stages are available when the DLL is built
+ *  with MOT_USE_AMC and linked with the AMC100 library.
+ */
+/******************************************************************/
+
+#ifndef __MOTIONSTART_H__
+#define __MOTIONSTART_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define MOT_API
+#else
+#ifdef  DLL_EXPORT
+#define MOT_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define MOT_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define MOT_Ok                   0              /**< No error                              */
+#define MOT_Error              (-1)             /**< Unspecified error                     */
+#define MOT_NotConnected        -2              /**< Handle or stage does not exist        */
+#define MOT_Timeout             -6              /**< Stage or wait did not finish in time  */
+#define MOT_InvalidParam        -9              /**< Parameter out of range                */
+#define MOT_NoData             -15              /**< No external stage ready to start      */
+#define MOT_Busy               -16              /**< Already started, stages are fixed     */
+#define MOT_Cycle              -20              /**< Dependencies form a cycle             */
+#define MOT_NoReference        -21              /**< Axis stopped without reference mark   */
+#define MOT_NotSupported       -22              /**< Built without MOT_USE_AMC             */
+#define MOT_Abort              -23              /**< Stage stopped by @ref MOT_abort       */
+
+
+/** @brief  State of a stage                                                         */
+typedef enum {
+  MOT_Waiting = 0,                           /**< Prerequisites not done yet         */
+  MOT_Running = 1,                           /**< Started                            */
+  MOT_Done    = 2,                           /**< Finished successfully              */
+  MOT_Failed  = 3,                           /**< Finished with an error             */
+  MOT_Skipped = 4,                           /**< A prerequisite did not succeed     */
+  MOT_Aborted = 5                            /**< Stopped by @ref MOT_abort          */
+} MOT_State;
+
+
+/** @brief Create an empty startup plan
+ *
+ *  @param  plan      Output: plan handle
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_create( Int32* plan );
+
+
+/** @brief Release a plan, aborting it if it runs
+ *
+ *  AMC handles opened by connect stages stay open. Waits for an
+ *  AMC_Connect that a connect stage gave up on to return.
+ *
+ *  @param  plan      Plan handle
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_close( Int32 plan );
+
+
+/** @brief Add a stage connecting an AMC controller
+ *
+ *  @param  plan      Plan handle
+ *  @param  name      Stage name for the status display
+ *  @param  address   IP address, see @ref AMC_Connect
+ *  @param  timeout   Time limit of the stage [ms]
+ *  @param  stage     Output: stage id
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_addAmcConnect( Int32 plan,
+                                 const char* name,
+                                 const char* address,
+                                 Int32 timeout,
+                                 Int32* stage );
+
+
+/** @brief Add a reference search of an AMC axis
+ *
+ *  Enables the output, sets target and starts the approach; done when
+ *  the reference becomes valid, the approach is then stopped.
+ *
+ *  @param  plan      Plan handle
+ *  @param  name      Stage name
+ *  @param  connect   Connect stage giving the handle (a prerequisite), or 0
+ *  @param  handle    AMC handle if connect is 0
+ *  @param  axis      Axis [0..2]
+ *  @param  target    Target past the reference mark [nm or micro degree]
+ *  @param  timeout   Time limit of the stage [ms]
+ *  @param  stage     Output: stage id
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_addAmcReference( Int32 plan,
+                                   const char* name,
+                                   Int32 connect,
+                                   Int32 handle,
+                                   Int32 axis,
+                                   Int32 target,
+                                   Int32 timeout,
+                                   Int32* stage );
+
+
+/** @brief Add a serial stage
+ *
+ *  Writes setup, then sends poll every interval until the reply,
+ *  without surrounding white space, equals done.
+ *
+ *  @param  plan       Plan handle
+ *  @param  name       Stage name
+ *  @param  instrument Instrument handle of @ref IOS_openInstrument
+ *  @param  setup      Commands starting the homing, with terminator (may be empty)
+ *  @param  poll       Status query, with terminator
+ *  @param  done       Reply of the finished stage, e.g. "1"
+ *  @param  interval   Poll interval [ms]
+ *  @param  timeout    Time limit of the stage [ms]
+ *  @param  stage      Output: stage id
+ *  @return            Result of function
+ */
+Int32 MOT_API MOT_addSerial( Int32 plan,
+                             const char* name,
+                             Int32 instrument,
+                             const char* setup,
+                             const char* poll,
+                             const char* done,
+                             Int32 interval,
+                             Int32 timeout,
+                             Int32* stage );
+
+
+/** @brief Add a stage run by the caller
+ *
+ *  @param  plan      Plan handle
+ *  @param  name      Stage name
+ *  @param  timeout   Time limit from its start to @ref MOT_finish [ms]
+ *  @param  stage     Output: stage id
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_addExternal( Int32 plan, const char* name, Int32 timeout, Int32* stage );
+
+
+/** @brief Let a stage start only after another one is done
+ *
+ *  @param  plan      Plan handle
+ *  @param  stage     Stage id
+ *  @param  before    Stage that must be done first
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_after( Int32 plan, Int32 stage, Int32 before );
+
+
+/** @brief Start all stages whose prerequisites are met
+ *
+ *  @param  plan      Plan handle
+ *  @return           Result of function, @ref MOT_Cycle if the order
+ *                    cannot be satisfied
+ */
+Int32 MOT_API MOT_start( Int32 plan );
+
+
+/** @brief Take an external stage that may start now
+ *
+ *  @param  plan      Plan handle
+ *  @param  stage     Output: stage id
+ *  @return           Result of function, @ref MOT_NoData if none is ready
+ */
+Int32 MOT_API MOT_claim( Int32 plan, Int32* stage );
+
+
+/** @brief Report the end of an external stage
+ *
+ *  @param  plan      Plan handle
+ *  @param  stage     Stage id
+ *  @param  result    0 for success, else the error code of the driver
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_finish( Int32 plan, Int32 stage, Int32 result );
+
+
+/** @brief Wait until every stage has ended
+ *
+ *  @param  plan      Plan handle
+ *  @param  timeout   Maximum waiting time [ms], < 0 waits forever
+ *  @param  failed    Output: number of stages not done (may be NULL)
+ *  @return           Result of function, @ref MOT_Timeout if stages still run
+ */
+Int32 MOT_API MOT_wait( Int32 plan, Int32 timeout, Int32* failed );
+
+
+/** @brief Stop all running stages; waiting ones are not started
+ *
+ *  @param  plan      Plan handle
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_abort( Int32 plan );
+
+
+/** @brief State of a stage
+ *
+ *  @param  plan      Plan handle
+ *  @param  stage     Stage id
+ *  @param  state     Output: see @ref MOT_State
+ *  @param  result    Output: error code of a failed, skipped or aborted
+ *                    stage, @ref MOT_Abort if aborted (may be NULL)
+ *  @param  started   Output: start since @ref MOT_start [s], -1 if not started (may be NULL)
+ *  @param  elapsed   Output: run time [s] (may be NULL)
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_status( Int32 plan,
+                          Int32 stage,
+                          Int32* state,
+                          Int32* result,
+                          double* started,
+                          double* elapsed );
+
+
+/** @brief AMC handle opened by a connect stage
+ *
+ *  @param  plan      Plan handle
+ *  @param  stage     Connect stage id
+ *  @param  handle    Output: handle for the other AMC functions
+ *  @return           Result of function
+ */
+Int32 MOT_API MOT_amcHandle( Int32 plan, Int32 stage, Int32* handle );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
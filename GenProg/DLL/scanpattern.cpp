@@ -0,0 +1,385 @@
+/******************************************************************/
+/** @file scanpattern.cpp
+ *  Scan pattern DLL
+ *
+ *  Implementation of @ref scanpattern.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "scanpattern.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+/** Number of following points tried by the 2-opt refinement               */
+const Int32 kTwoOptWindow = 32;
+/** Maximum number of 2-opt passes over the tour                            */
+const int   kTwoOptPasses = 4;
+
+bool validGrid( const SCAN_Grid* grid )
+{
+  return grid && grid->nx > 0 && grid->ny > 0;
+}
+
+bool validMotion( const SCAN_Motion* motion )
+{
+  return motion && motion->speedX > 0. && motion->speedY > 0. && motion->settle >= 0.;
+}
+
+/** Writes grid point (i, j) to slot k of the output table                   */
+inline void put( const SCAN_Grid& g, double* x, double* y, int64_t k, Int32 i, Int32 j )
+{
+  x[k] = g.x0 + i * g.dx;
+  y[k] = g.y0 + j * g.dy;
+}
+
+/** Hilbert index d -> (i, j) on an n x n curve from (0,0) to (n-1,0)      */
+void hilbertPoint( int64_t n, int64_t d, int64_t& i, int64_t& j )
+{
+  i = j = 0;
+  for ( int64_t s = 1; s < n; s *= 2 ) {
+    int64_t rx = 1 & ( d / 2 );
+    int64_t ry = 1 & ( d ^ rx );
+    if ( ry == 0 ) {
+      if ( rx == 1 ) {
+        i = s - 1 - i;
+        j = s - 1 - j;
+      }
+      std::swap( i, j );
+    }
+    i += s * rx;
+    j += s * ry;
+    d /= 4;
+  }
+}
+
+void raster( const SCAN_Grid& g, double* x, double* y, bool serpentine )
+{
+  int64_t k = 0;
+  for ( Int32 j = 0; j < g.ny; ++j ) {
+    bool back = serpentine && ( j & 1 );
+    for ( Int32 i = 0; i < g.nx; ++i )
+      put( g, x, y, k++, back ? g.nx - 1 - i : i, j );
+  }
+}
+
+/** Walks the grid boundary inwards and stores it backwards, so the table
+ *  starts at the center and ends on the outer ring.                        */
+void spiral( const SCAN_Grid& g, double* x, double* y )
+{
+  int64_t k = int64_t( g.nx ) * g.ny;
+  Int32 left = 0, right = g.nx - 1, top = 0, bottom = g.ny - 1;
+  while ( left <= right && top <= bottom ) {
+    for ( Int32 i = left; i <= right; ++i )
+      put( g, x, y, --k, i, top );
+    for ( Int32 j = top + 1; j <= bottom; ++j )
+      put( g, x, y, --k, right, j );
+    if ( top < bottom )
+      for ( Int32 i = right - 1; i >= left; --i )
+        put( g, x, y, --k, i, bottom );
+    if ( left < right )
+      for ( Int32 j = bottom - 1; j > top; --j )
+        put( g, x, y, --k, left, j );
+    ++left; --right; ++top; --bottom;
+  }
+}
+
+/** Hilbert order on square tiles laid along the longer grid axis. Each
+ *  tile curve ends next to the start of the following tile.              */
+void hilbert( const SCAN_Grid& g, double* x, double* y )
+{
+  bool    alongX = g.nx >= g.ny;
+  int64_t lng    = alongX ? g.nx : g.ny;
+  int64_t shrt   = alongX ? g.ny : g.nx;
+  int64_t side   = 1;
+  while ( side < shrt )
+    side *= 2;
+
+  int64_t k = 0;
+  for ( int64_t base = 0; base < lng; base += side ) {
+    for ( int64_t d = 0; d < side * side; ++d ) {
+      int64_t a, b;
+      hilbertPoint( side, d, a, b );
+      a += base;
+      if ( a >= lng || b >= shrt )
+        continue;
+      if ( alongX )
+        put( g, x, y, k++, Int32( a ), Int32( b ) );
+      else
+        put( g, x, y, k++, Int32( b ), Int32( a ) );
+    }
+  }
+}
+
+
+/** Point coordinates in units of travel time                               */
+struct TimeSpace {
+  std::vector<double> u, v;
+
+  TimeSpace( const double* x, const double* y, Int32 n, const SCAN_Motion& m )
+    : u( n ), v( n )
+  {
+    for ( Int32 k = 0; k < n; ++k ) {
+      u[k] = x[k] / m.speedX;
+      v[k] = y[k] / m.speedY;
+    }
+  }
+
+  double cost( Int32 a, Int32 b ) const
+  {
+    return std::max( std::fabs( u[a] - u[b] ), std::fabs( v[a] - v[b] ) );
+  }
+};
+
+/** Nearest neighbour tour using a uniform bucket grid. Distances are
+ *  Chebyshev in time space, so the search rings are exact squares.        */
+std::vector<Int32> nearestNeighbourTour( const TimeSpace& ts, Int32 n )
+{
+  double umin = *std::min_element( ts.u.begin(), ts.u.end() );
+  double umax = *std::max_element( ts.u.begin(), ts.u.end() );
+  double vmin = *std::min_element( ts.v.begin(), ts.v.end() );
+  double vmax = *std::max_element( ts.v.begin(), ts.v.end() );
+  /* An axis without extent (line scans, collinear tables) gets a single
+   * cell, the other axis about two points per cell                       */
+  double du = umax - umin, dv = vmax - vmin, ext = std::max( du, dv );
+  bool   fu = du > 1e-9 * ext, fv = dv > 1e-9 * ext;
+  double h  = fu && fv ? std::sqrt( 2. * du * dv / n ) : 2. * ext / n;
+  if ( !( h > 0. ) )
+    h = 1.;
+  double cmax = fu && fv ? double( 1 << 14 ) : double( 1 << 22 );
+  Int32  cu   = fu ? Int32( std::min( cmax, du / h + 1. ) ) : 1;
+  Int32  cv   = fv ? Int32( std::min( cmax, dv / h + 1. ) ) : 1;
+  double hu = std::max( ( umax - umin ) / cu, 1e-300 );
+  double hv = std::max( ( vmax - vmin ) / cv, 1e-300 );
+  /* Points outside ring r are at least r cells away along an axis that
+   * has more than one cell; a degenerate axis (line scans, collinear
+   * tables) must not shrink the bound or the early exit never fires.     */
+  h = cu > 1 && cv > 1 ? std::min( hu, hv ) : cu > 1 ? hu : cv > 1 ? hv : 1.;
+
+  auto cellOf = [&]( Int32 p, Int32& a, Int32& b ) {
+    a = std::min<Int32>( cu - 1, Int32( ( ts.u[p] - umin ) / hu ) );
+    b = std::min<Int32>( cv - 1, Int32( ( ts.v[p] - vmin ) / hv ) );
+  };
+
+  /* Bucket contents in CSR layout; removal swaps with the last live item */
+  std::vector<Int32> start( size_t( cu ) * cv + 1, 0 ), fill( size_t( cu ) * cv, 0 );
+  std::vector<Int32> items( n ), slot( n ), cellIdx( n );
+  for ( Int32 p = 0; p < n; ++p ) {
+    Int32 a, b;
+    cellOf( p, a, b );
+    cellIdx[p] = b * cu + a;
+    ++start[cellIdx[p] + 1];
+  }
+  for ( size_t c = 0; c + 1 < start.size(); ++c )
+    start[c + 1] += start[c];
+  for ( Int32 p = 0; p < n; ++p ) {
+    Int32 c = cellIdx[p];
+    slot[p] = start[c] + fill[c]++;
+    items[slot[p]] = p;
+  }
+  auto remove = [&]( Int32 p ) {
+    Int32 c    = cellIdx[p];
+    Int32 last = start[c] + --fill[c];
+    Int32 q    = items[last];
+    items[slot[p]] = q;
+    slot[q]        = slot[p];
+    items[last]    = p;
+    slot[p]        = last;
+  };
+
+  std::vector<Int32> tour;
+  tour.reserve( n );
+  Int32 cur = 0;
+  remove( cur );
+  tour.push_back( cur );
+  for ( Int32 left = n - 1; left > 0; --left ) {
+    Int32 a0, b0;
+    cellOf( cur, a0, b0 );
+    Int32  best  = -1;
+    double bestD = 0.;
+    Int32  rmax  = std::max( std::max( a0, cu - 1 - a0 ), std::max( b0, cv - 1 - b0 ) );
+    for ( Int32 r = 0; r <= rmax; ++r ) {
+      /* only the cells of ring r inside the grid are visited: on a long
+       * thin grid most of each ring lies outside it                       */
+      for ( Int32 b = std::max( 0, b0 - r ), bEnd = std::min( cv - 1, b0 + r ); b <= bEnd; ++b ) {
+        bool edge = ( b == b0 - r || b == b0 + r );
+        Int32 aStep = ( edge || r == 0 ) ? 1 : 2 * r;
+        Int32 a     = edge ? std::max( 0, a0 - r ) : a0 - r;
+        Int32 aEnd  = edge ? std::min( cu - 1, a0 + r ) : a0 + r;
+        for ( ; a <= aEnd; a += aStep ) {
+          if ( a < 0 || a >= cu )
+            continue;
+          Int32 c = b * cu + a;
+          for ( Int32 s = start[c], e = start[c] + fill[c]; s < e; ++s ) {
+            double d = ts.cost( cur, items[s] );
+            if ( best < 0 || d < bestD ) {
+              best  = items[s];
+              bestD = d;
+            }
+          }
+        }
+      }
+      if ( best >= 0 && bestD <= r * h )
+        break;
+    }
+    remove( best );
+    tour.push_back( best );
+    cur = best;
+  }
+  return tour;
+}
+
+/** Windowed 2-opt on an open path with a fixed first point               */
+void twoOpt( const TimeSpace& ts, std::vector<Int32>& t )
+{
+  Int32 n = Int32( t.size() );
+  for ( int pass = 0; pass < kTwoOptPasses; ++pass ) {
+    bool improved = false;
+    for ( Int32 i = 0; i + 2 < n; ++i ) {
+      Int32 jmax = std::min( n - 1, i + kTwoOptWindow );
+      for ( Int32 j = i + 2; j <= jmax; ++j ) {
+        double before = ts.cost( t[i], t[i + 1] );
+        double after  = ts.cost( t[i], t[j] );
+        if ( j + 1 < n ) {
+          before += ts.cost( t[j], t[j + 1] );
+          after  += ts.cost( t[i + 1], t[j + 1] );
+        }
+        if ( after < before - 1e-12 * ( before + 1. ) ) {
+          std::reverse( t.begin() + i + 1, t.begin() + j + 1 );
+          improved = true;
+        }
+      }
+    }
+    if ( !improved )
+      break;
+  }
+}
+
+double pathDuration( const double* x, const double* y, Int32 n, const SCAN_Motion& m )
+{
+  double t = n * m.settle;
+  for ( Int32 k = 1; k < n; ++k )
+    t += std::max( std::fabs( x[k] - x[k - 1] ) / m.speedX,
+                   std::fabs( y[k] - y[k - 1] ) / m.speedY );
+  return t;
+}
+
+} // namespace
+
+
+Int32 SCAN_API SCAN_generate( const SCAN_Grid* grid,
+                              SCAN_Pattern pattern,
+                              double* x,
+                              double* y,
+                              Int32 size )
+{
+  if ( !validGrid( grid ) || !x || !y )
+    return SCAN_InvalidParam;
+  if ( int64_t( grid->nx ) * grid->ny > size )
+    return SCAN_BufferTooSmall;
+
+  switch ( pattern ) {
+  case SCAN_patRaster:     raster( *grid, x, y, false ); break;
+  case SCAN_patSerpentine: raster( *grid, x, y, true );  break;
+  case SCAN_patSpiral:     spiral( *grid, x, y );        break;
+  case SCAN_patHilbert:    hilbert( *grid, x, y );       break;
+  default:                 return SCAN_InvalidParam;
+  }
+  return SCAN_Ok;
+}
+
+
+Int32 SCAN_API SCAN_generateRoi( const SCAN_Grid* grid,
+                                 const unsigned char* mask,
+                                 double* x,
+                                 double* y,
+                                 Int32 size,
+                                 Int32* count )
+{
+  if ( !validGrid( grid ) || !mask || !count )
+    return SCAN_InvalidParam;
+
+  int64_t total = int64_t( grid->nx ) * grid->ny;
+  int64_t n     = 0;
+  for ( int64_t k = 0; k < total; ++k )
+    n += mask[k] != 0;
+  *count = Int32( n );
+  if ( n > size )
+    return SCAN_BufferTooSmall;
+  if ( n > 0 && ( !x || !y ) )
+    return SCAN_InvalidParam;
+
+  int64_t k = 0;
+  for ( Int32 j = 0; j < grid->ny; ++j ) {
+    const unsigned char* line = mask + int64_t( j ) * grid->nx;
+    bool back = j & 1;
+    for ( Int32 c = 0; c < grid->nx; ++c ) {
+      Int32 i = back ? grid->nx - 1 - c : c;
+      if ( line[i] )
+        put( *grid, x, y, k++, i, j );
+    }
+  }
+  return SCAN_Ok;
+}
+
+
+double SCAN_API SCAN_axisSpeed( Int32 frequency, double stepSize )
+{
+  return frequency * 1e-3 * std::fabs( stepSize );
+}
+
+
+Int32 SCAN_API SCAN_duration( const double* x,
+                              const double* y,
+                              Int32 count,
+                              const SCAN_Motion* motion,
+                              double* duration )
+{
+  if ( !validMotion( motion ) || !duration || count < 0 || ( count > 0 && ( !x || !y ) ) )
+    return SCAN_InvalidParam;
+  *duration = pathDuration( x, y, count, *motion );
+  return SCAN_Ok;
+}
+
+
+Int32 SCAN_API SCAN_optimizeOrder( double* x,
+                                   double* y,
+                                   Int32 count,
+                                   const SCAN_Motion* motion,
+                                   double* duration )
+{
+  if ( !validMotion( motion ) || count < 0 || ( count > 0 && ( !x || !y ) ) )
+    return SCAN_InvalidParam;
+
+  double current = pathDuration( x, y, count, *motion );
+  if ( count > 2 ) {
+    try {
+      TimeSpace ts( x, y, count, *motion );
+      std::vector<Int32> tour = nearestNeighbourTour( ts, count );
+      twoOpt( ts, tour );
+
+      std::vector<double> nx( count ), ny( count );
+      for ( Int32 k = 0; k < count; ++k ) {
+        nx[k] = x[tour[k]];
+        ny[k] = y[tour[k]];
+      }
+      double reordered = pathDuration( nx.data(), ny.data(), count, *motion );
+      if ( reordered < current ) {
+        std::copy( nx.begin(), nx.end(), x );
+        std::copy( ny.begin(), ny.end(), y );
+        current = reordered;
+      }
+    }
+    catch ( ... ) {
+      return SCAN_Error;
+    }
+  }
+  if ( duration )
+    *duration = current;
+  return SCAN_Ok;
+}
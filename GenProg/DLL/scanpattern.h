@@ -0,0 +1,169 @@
+/******************************************************************/
+/** @file scanpattern.h
+ *  Scan pattern DLL
+ *
+ *  Generates position tables for positioner scans (raster, serpentine,
+ *  spiral, Hilbert and sparse ROI) and reorders arbitrary tables to
+ *  minimize the travel time of the stages. Tables are written straight
+ *  into caller allocated arrays so they can be wired to LabVIEW in place
+ *  of the tables built by the GenProg position table VIs.
+ */
+/******************************************************************/
+
+#ifndef __SCANPATTERN_H__
+#define __SCANPATTERN_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define SCAN_API
+#else
+#ifdef  DLL_EXPORT
+#define SCAN_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define SCAN_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define SCAN_Ok                  0              /**< No error                              */
+#define SCAN_Error             (-1)             /**< Unspecified error                     */
+#define SCAN_InvalidParam       -9              /**< Parameter out of range                */
+#define SCAN_BufferTooSmall    -10              /**< Output arrays cannot hold the table   */
+
+
+/** @brief  Scan patterns                                                            */
+typedef enum {
+  SCAN_patRaster     = 0,                    /**< Every line in the same direction   */
+  SCAN_patSerpentine = 1,                    /**< Line direction alternates          */
+  SCAN_patSpiral     = 2,                    /**< Square spiral from the center out  */
+  SCAN_patHilbert    = 3                     /**< Hilbert curve over the grid        */
+} SCAN_Pattern;
+
+
+/** @brief  Regular scan grid                                                        */
+typedef struct {
+  double x0;                                 /**< Position of the first column       */
+  double y0;                                 /**< Position of the first line         */
+  double dx;                                 /**< Step between columns (may be < 0)  */
+  double dy;                                 /**< Step between lines (may be < 0)    */
+  Int32  nx;                                 /**< Number of columns                  */
+  Int32  ny;                                 /**< Number of lines                    */
+} SCAN_Grid;
+
+
+/** @brief  Stage motion model used to estimate and minimize scan duration
+ *
+ *  Both axes move at the same time, so a move takes the time of the
+ *  slower axis; every point adds a constant settling time.
+ */
+typedef struct {
+  double speedX;                             /**< Speed of the X axis in units/s     */
+  double speedY;                             /**< Speed of the Y axis in units/s     */
+  double settle;                             /**< Settling time per point in s       */
+} SCAN_Motion;
+
+
+/** @brief Generate a scan table
+ *
+ *  Fills x and y with the nx * ny positions of the grid, ordered
+ *  according to the selected pattern.
+ *
+ *  @param  grid     Scan grid
+ *  @param  pattern  Order of the points, see @ref SCAN_Pattern
+ *  @param  x        Output: X positions
+ *  @param  y        Output: Y positions
+ *  @param  size     Number of elements of x and y; must be >= nx * ny
+ *  @return          Result of function
+ */
+Int32 SCAN_API SCAN_generate( const SCAN_Grid* grid,
+                              SCAN_Pattern pattern,
+                              double* x,
+                              double* y,
+                              Int32 size );
+
+
+/** @brief Generate a sparse ROI scan table
+ *
+ *  Only grid points whose mask element is non-zero are emitted, in
+ *  serpentine order. The mask is stored line by line (nx * ny bytes).
+ *
+ *  @param  grid     Scan grid
+ *  @param  mask     Region of interest, one byte per grid point
+ *  @param  x        Output: X positions
+ *  @param  y        Output: Y positions
+ *  @param  size     Number of elements of x and y
+ *  @param  count    Output: number of points written
+ *  @return          Result of function
+ */
+Int32 SCAN_API SCAN_generateRoi( const SCAN_Grid* grid,
+                                 const unsigned char* mask,
+                                 double* x,
+                                 double* y,
+                                 Int32 size,
+                                 Int32* count );
+
+
+/** @brief Axis speed from actuator settings
+ *
+ *  Converts the actuator frequency as returned by AMC_controlFrequency
+ *  and the mean step size of the actor into a speed for @ref SCAN_Motion.
+ *
+ *  @param  frequency  Actuator frequency in mHz
+ *  @param  stepSize   Mean step size in position units per step
+ *  @return            Speed in position units per second
+ */
+double SCAN_API SCAN_axisSpeed( Int32 frequency, double stepSize );
+
+
+/** @brief Scan duration
+ *
+ *  Estimated time needed to visit the points in table order, starting
+ *  at the first point.
+ *
+ *  @param  x        X positions
+ *  @param  y        Y positions
+ *  @param  count    Number of points
+ *  @param  motion   Stage motion model
+ *  @param  duration Output: duration in s
+ *  @return          Result of function
+ */
+Int32 SCAN_API SCAN_duration( const double* x,
+                              const double* y,
+                              Int32 count,
+                              const SCAN_Motion* motion,
+                              double* duration );
+
+
+/** @brief Reorder a scan table for minimum travel time
+ *
+ *  Reorders the points in place, starting from the first point, with a
+ *  nearest neighbour tour refined by local 2-opt moves. The table is left
+ *  untouched if the new order is not faster.
+ *
+ *  @param  x        X positions, reordered in place
+ *  @param  y        Y positions, reordered in place
+ *  @param  count    Number of points
+ *  @param  motion   Stage motion model
+ *  @param  duration Output: duration of the resulting order in s (may be NULL)
+ *  @return          Result of function
+ */
+Int32 SCAN_API SCAN_optimizeOrder( double* x,
+                                   double* y,
+                                   Int32 count,
+                                   const SCAN_Motion* motion,
+                                   double* duration );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
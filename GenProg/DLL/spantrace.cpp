@@ -0,0 +1,381 @@
+/******************************************************************/
+/** @file spantrace.cpp
+ *  Span tracing DLL
+ *
+ *  Implementation of @ref spantrace.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "spantrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRC_TSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TRC_TSC
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+enum Kind { kSpan, kInstant, kCounter };
+
+/** Raw time stamp; converted to time only on export                     */
+inline UInt64 ticks()
+{
+#if defined(TRC_TSC)
+  return __rdtsc();
+#elif defined(_WIN32)
+  LARGE_INTEGER t;
+  QueryPerformanceCounter( &t );
+  return UInt64( t.QuadPart );
+#else
+  timespec t;
+  clock_gettime( CLOCK_MONOTONIC_RAW, &t );
+  return UInt64( t.tv_sec ) * 1000000000ull + UInt64( t.tv_nsec );
+#endif
+}
+
+
+struct Event {
+  UInt64 t0, t1;
+  double value;
+  Int32  id;
+  Int32  kind;
+};
+
+/** Event ring of one thread. Only the owner writes; head is published
+ *  after the slot, so a reader takes [max(base, head - size), head) and
+ *  drops what the owner overwrote meanwhile, or may be overwriting now  */
+struct Buffer {
+  explicit Buffer( size_t size ) : ev( size ), mask( size - 1 ) {}
+
+  std::vector<Event>  ev;
+  const UInt64        mask;
+  std::atomic<UInt64> head{ 0 };
+  std::atomic<UInt64> base{ 0 };     /**< first event since TRC_start     */
+  Int32               tid  = 0;
+  std::string         name;
+  bool                ended = false;  /**< owner thread has exited        */
+};
+
+
+/** Everything except the event writes is guarded by m                    */
+struct State {
+  std::mutex                           m;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+  Int32                                nextTid = 1;
+  UInt64                               tick0   = 0;
+  Clock::time_point                    time0;
+
+  std::mutex                           names;
+  std::map<std::string, Int32>         ids;
+  std::vector<std::string>             byId{ std::string() };
+};
+
+State& state()
+{
+  static State s;
+  return s;
+}
+
+std::atomic<bool>   g_on{ false };
+std::atomic<size_t> g_size{ 0 };     /**< ring size of TRC_start        */
+
+
+/** Buffer of the calling thread, kept for export after the thread ends */
+struct Holder {
+  Buffer*     b      = 0;
+  size_t      failed = 0;                   /**< ring size that could not be allocated */
+  std::string name;
+  ~Holder()
+  {
+    if ( b ) {
+      std::lock_guard<std::mutex> lk( state().m );
+      b->ended = true;
+    }
+  }
+};
+
+thread_local Holder tls;
+
+/** Creates the buffer of the thread or replaces one of an older size;
+ *  NULL drops the event. Runs inside the C API, so nothing may escape.   */
+Buffer* attach()
+{
+  size_t size = g_size.load( std::memory_order_relaxed );
+  if ( !size || size == tls.failed )
+    return 0;
+  State& s = state();
+  std::lock_guard<std::mutex> lk( s.m );
+  std::unique_ptr<Buffer> b;
+  try {
+    b.reset( new Buffer( size ) );
+    b->name = tls.name;
+    s.buffers.reserve( s.buffers.size() + 1 );
+  }
+  catch ( ... ) {
+    tls.failed = size;
+    return 0;
+  }
+  Buffer* nb = b.get();
+  if ( tls.b ) {
+    nb->tid = tls.b->tid;
+    for ( auto& p : s.buffers )
+      if ( p.get() == tls.b ) {
+        p = std::move( b );
+        break;
+      }
+  }
+  else {
+    nb->tid = s.nextTid++;
+    s.buffers.push_back( std::move( b ) );
+  }
+  tls.b = nb;
+  return nb;
+}
+
+inline void record( Int32 kind, Int32 id, UInt64 t0, UInt64 t1, double value )
+{
+  Buffer* b = tls.b;
+  if ( !b || b->ev.size() != g_size.load( std::memory_order_relaxed ) ) {
+    b = attach();
+    if ( !b )
+      return;
+  }
+  UInt64 h = b->head.load( std::memory_order_relaxed );
+  Event& e = b->ev[h & b->mask];
+  e.t0     = t0;
+  e.t1     = t1;
+  e.value  = value;
+  e.id     = id;
+  e.kind   = kind;
+  b->head.store( h + 1, std::memory_order_release );
+}
+
+
+void writeString( std::FILE* f, const std::string& s )
+{
+  std::fputc( '"', f );
+  for ( unsigned char c : s ) {
+    if ( c == '"' || c == '\\' )
+      std::fprintf( f, "\\%c", c );
+    else if ( c < 0x20 )
+      std::fprintf( f, "\\u%04x", c );
+    else
+      std::fputc( c, f );
+  }
+  std::fputc( '"', f );
+}
+
+Int32 processId()
+{
+#ifdef _WIN32
+  return Int32( GetCurrentProcessId() );
+#else
+  return Int32( getpid() );
+#endif
+}
+
+} // namespace
+
+
+Int32 TRC_API TRC_start( Int32 events )
+{
+  if ( events < 1 || events > TRC_MAX_EVENTS )
+    return TRC_InvalidParam;
+  size_t size = 1;
+  while ( size < size_t( events ) )
+    size <<= 1;
+
+  State& s = state();
+  std::lock_guard<std::mutex> lk( s.m );
+  g_on.store( false );
+  for ( size_t k = 0; k < s.buffers.size(); )
+    if ( s.buffers[k]->ended )
+      s.buffers.erase( s.buffers.begin() + k );
+    else {
+      s.buffers[k]->base.store( s.buffers[k]->head.load() );
+      ++k;
+    }
+  s.tick0 = ticks();
+  s.time0 = Clock::now();
+  g_size.store( size );
+  g_on.store( true );
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_stop( void )
+{
+  g_on.store( false );
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_name( const char* name, Int32* id )
+{
+  if ( !name || !id )
+    return TRC_InvalidParam;
+  State& s = state();
+  std::lock_guard<std::mutex> lk( s.names );
+  std::string n( name, std::min( std::strlen( name ), size_t( TRC_MAX_NAME ) ) );
+  auto it = s.ids.find( n );
+  if ( it == s.ids.end() ) {
+    it = s.ids.insert( std::make_pair( n, Int32( s.byId.size() ) ) ).first;
+    s.byId.push_back( n );
+  }
+  *id = it->second;
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_threadName( const char* name )
+{
+  if ( !name )
+    return TRC_InvalidParam;
+  std::lock_guard<std::mutex> lk( state().m );
+  tls.name.assign( name, std::min( std::strlen( name ), size_t( TRC_MAX_NAME ) ) );
+  if ( tls.b )
+    tls.b->name = tls.name;
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_begin( UInt64* start )
+{
+  if ( start )
+    *start = g_on.load( std::memory_order_relaxed ) ? ticks() : 0;
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_end( Int32 id, UInt64 start )
+{
+  if ( start && g_on.load( std::memory_order_relaxed ) )
+    record( kSpan, id, start, ticks(), 0. );
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_instant( Int32 id )
+{
+  if ( g_on.load( std::memory_order_relaxed ) ) {
+    UInt64 t = ticks();
+    record( kInstant, id, t, t, 0. );
+  }
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_counter( Int32 id, double value )
+{
+  if ( g_on.load( std::memory_order_relaxed ) ) {
+    UInt64 t = ticks();
+    record( kCounter, id, t, t, value );
+  }
+  return TRC_Ok;
+}
+
+
+Int32 TRC_API TRC_export( const char* path, double* events, double* lost )
+{
+  if ( !path )
+    return TRC_InvalidParam;
+  State& s = state();
+
+  std::vector<std::string> names;
+  {
+    std::lock_guard<std::mutex> lk( s.names );
+    names = s.byId;
+  }
+
+  std::lock_guard<std::mutex> lk( s.m );
+  if ( !g_size.load() )
+    return TRC_InvalidParam;
+
+  /* Tick rate from the time since TRC_start; wait if that is too short */
+  if ( Clock::now() - s.time0 < std::chrono::milliseconds( 20 ) )
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+  UInt64            tick1 = ticks();
+  Clock::time_point time1 = Clock::now();
+  double usPerTick = std::chrono::duration<double, std::micro>( time1 - s.time0 ).count()
+                     / double( tick1 - s.tick0 );
+
+  std::FILE* f = std::fopen( path, "wb" );
+  if ( !f )
+    return TRC_FileError;
+  const Int32 pid = processId();
+  double written = 0., dropped = 0.;
+  bool   first   = true;
+  std::fputs( "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f );
+
+  std::vector<Event> copy;
+  for ( auto& b : s.buffers ) {
+    UInt64 size = b->ev.size();
+    UInt64 base = b->base.load();
+    UInt64 head = b->head.load( std::memory_order_acquire );
+    UInt64 lo   = head - base > size ? head - size : base;
+    copy.assign( size_t( head - lo ), Event() );
+    for ( UInt64 k = lo; k < head; ++k )
+      copy[size_t( k - lo )] = b->ev[k & b->mask];
+    std::atomic_thread_fence( std::memory_order_acquire );
+    /* The owner may be writing event now, into the slot of now - size */
+    UInt64 now  = b->head.load( std::memory_order_acquire );
+    UInt64 keep = now + 1 - lo > size ? now + 1 - size : lo;
+    dropped += double( keep - base );
+
+    if ( head > keep || !b->name.empty() ) {
+      std::fprintf( f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+                       "\"args\":{\"name\":", first ? "" : ",\n", pid, b->tid );
+      writeString( f, b->name.empty() ? "thread " + std::to_string( b->tid ) : b->name );
+      std::fputs( "}}", f );
+      first = false;
+    }
+    for ( UInt64 k = keep; k < head; ++k ) {
+      const Event& e  = copy[size_t( k - lo )];
+      double       ts = double( ( long long )( e.t0 - s.tick0 ) ) * usPerTick;
+      std::fputs( ",\n{\"name\":", f );
+      writeString( f, e.id > 0 && size_t( e.id ) < names.size() ? names[e.id]
+                                                                  : "#" + std::to_string( e.id ) );
+      std::fprintf( f, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f", pid, b->tid, ts );
+      if ( e.kind == kSpan )
+        std::fprintf( f, ",\"ph\":\"X\",\"dur\":%.3f}", double( e.t1 - e.t0 ) * usPerTick );
+      else if ( e.kind == kInstant )
+        std::fputs( ",\"ph\":\"i\",\"s\":\"t\"}", f );
+      else
+        std::fprintf( f, ",\"ph\":\"C\",\"args\":{\"value\":%.17g}}", e.value );
+      written += 1.;
+    }
+  }
+  std::fputs( "\n]}\n", f );
+  bool ok = std::fclose( f ) == 0;
+
+  if ( events )
+    *events = written;
+  if ( lost )
+    *lost = dropped;
+  return ok ? TRC_Ok : TRC_FileError;
+}
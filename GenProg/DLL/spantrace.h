@@ -0,0 +1,180 @@
+/******************************************************************/
+/** @file spantrace.h
+ *  Span tracing DLL
+ *
+ *  Low overhead replacement for Time BenchmarkGen.vi, TimerGen.vi and
+ *  TimerRateGen.vi. Spans, instants and counter values are time stamped
+ *  with the TSC (CLOCK_MONOTONIC_RAW / QueryPerformanceCounter where
+ *  there is none) and written without locking into a ring buffer owned
+ *  by the calling thread. @ref TRC_export writes everything recorded
+ *  since @ref TRC_start as a Chrome trace (chrome://tracing, Perfetto),
+ *  one row per thread.
+ *
+ *  From LabVIEW, register the names once with @ref TRC_name, then wrap
+ *  the code of interest in @ref TRC_begin / @ref TRC_end; both nodes must
+ *  run in the same thread (any thread but the UI thread). Native code
+ *  uses @ref TRC_SCOPE. When tracing is stopped every call returns at
+ *  once, so the nodes can stay in the diagram.
+ */
+/******************************************************************/
+
+#ifndef __SPANTRACE_H__
+#define __SPANTRACE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define TRC_API
+#else
+#ifdef  DLL_EXPORT
+#define TRC_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define TRC_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int                Bln32;               /**< Boolean compatible to older C      */
+typedef int                Int32;               /**< Basic type                         */
+typedef unsigned long long UInt64;              /**< Time stamp in ticks                */
+
+/** Return values of functions */
+#define TRC_Ok                   0              /**< No error                              */
+#define TRC_Error              (-1)             /**< Unspecified error                     */
+#define TRC_FileError           -8              /**< Trace file cannot be written          */
+#define TRC_InvalidParam        -9              /**< Parameter out of range                */
+
+#define TRC_MAX_NAME            64              /**< Longer names are cut                  */
+#define TRC_MAX_EVENTS   (1 << 22)              /**< Largest ring, 128 MiB per thread      */
+
+
+/** @brief Start recording
+ *
+ *  Discards the events recorded before. Threads keep the last events
+ *  events each; older ones are overwritten. A thread whose ring cannot
+ *  be allocated records nothing.
+ *
+ *  @param  events    Ring size per thread, 1..@ref TRC_MAX_EVENTS, rounded
+ *                    up to a power of two
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_start( Int32 events );
+
+
+/** @brief Stop recording
+ *
+ *  The recorded events stay available for @ref TRC_export.
+ *
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_stop( void );
+
+
+/** @brief Id of an event name
+ *
+ *  The same name always gives the same id; ids stay valid over
+ *  @ref TRC_start.
+ *
+ *  @param  name      Event name, e.g. "AMC_getPosition"
+ *  @param  id        Output: name id
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_name( const char* name, Int32* id );
+
+
+/** @brief Name the calling thread in the exported trace
+ *
+ *  @param  name      Thread name, e.g. the loop name
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_threadName( const char* name );
+
+
+/** @brief Begin a span
+ *
+ *  @param  start     Output: time stamp to pass to @ref TRC_end
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_begin( UInt64* start );
+
+
+/** @brief End a span and record it
+ *
+ *  @param  id        Name id of the span
+ *  @param  start     Time stamp from @ref TRC_begin
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_end( Int32 id, UInt64 start );
+
+
+/** @brief Record an instant event
+ *
+ *  @param  id        Name id of the event
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_instant( Int32 id );
+
+
+/** @brief Record a counter value (buffer level, count rate...)
+ *
+ *  @param  id        Name id of the counter
+ *  @param  value     Value
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_counter( Int32 id, double value );
+
+
+/** @brief Write the recorded events as Chrome trace JSON
+ *
+ *  Can be called while recording; events overwritten during the export
+ *  are left out.
+ *
+ *  @param  path      Output file, usually *.json
+ *  @param  events    Output: number of events written (may be NULL)
+ *  @param  lost      Output: events overwritten in full rings (may be NULL)
+ *  @return           Result of function
+ */
+Int32 TRC_API TRC_export( const char* path, double* events, double* lost );
+
+#ifdef __cplusplus
+}
+
+
+/** @brief  Span from construction to the end of the scope                          */
+class TRC_Scope
+{
+public:
+  explicit TRC_Scope( Int32 id ) : id_( id ), start_( 0 ) { TRC_begin( &start_ ); }
+  ~TRC_Scope() { TRC_end( id_, start_ ); }
+
+  TRC_Scope( const TRC_Scope& ) = delete;
+  TRC_Scope& operator=( const TRC_Scope& ) = delete;
+
+private:
+  Int32  id_;
+  UInt64 start_;
+};
+
+/** @brief Id of a name, for static initialisation */
+inline Int32 TRC_id( const char* name )
+{
+  Int32 id = 0;
+  TRC_name( name, &id );
+  return id;
+}
+
+#define TRC_CAT2( a, b ) a##b
+#define TRC_CAT( a, b )  TRC_CAT2( a, b )
+
+/** @brief Trace the rest of the enclosing scope as span name */
+#define TRC_SCOPE( name )                                                                \
+  static const Int32 TRC_CAT( trcId_, __LINE__ ) = TRC_id( name );                       \
+  TRC_Scope TRC_CAT( trcScope_, __LINE__ )( TRC_CAT( trcId_, __LINE__ ) )
+
+#endif
+
+#endif
@@ -0,0 +1,336 @@
+/******************************************************************/
+/** @file streamstats.cpp
+ *  Streaming statistics DLL
+ *
+ *  Implementation of @ref streamstats.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "streamstats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define STAT_SSE2
+#endif
+
+namespace {
+
+/** Welford update of all channels with one sample row                     */
+void welford( const double* x, double* mean, double* m2, double invN, Int32 nc )
+{
+  Int32 c = 0;
+#ifdef STAT_SSE2
+  const __m128d inv = _mm_set1_pd( invN );
+  for ( ; c + 2 <= nc; c += 2 ) {
+    __m128d xv    = _mm_loadu_pd( x + c );
+    __m128d mv    = _mm_loadu_pd( mean + c );
+    __m128d delta = _mm_sub_pd( xv, mv );
+    mv = _mm_add_pd( mv, _mm_mul_pd( delta, inv ) );
+    _mm_storeu_pd( mean + c, mv );
+    _mm_storeu_pd( m2 + c, _mm_add_pd( _mm_loadu_pd( m2 + c ),
+                                       _mm_mul_pd( delta, _mm_sub_pd( xv, mv ) ) ) );
+  }
+#endif
+  for ( ; c < nc; ++c ) {
+    double delta = x[c] - mean[c];
+    mean[c] += delta * invN;
+    m2[c]   += delta * ( x[c] - mean[c] );
+  }
+}
+
+/** ema += alpha (x - ema); sum += x                                       */
+void emaAndSum( const double* x, double* ema, double* sum, double alpha, Int32 nc )
+{
+  Int32 c = 0;
+#ifdef STAT_SSE2
+  const __m128d a = _mm_set1_pd( alpha );
+  for ( ; c + 2 <= nc; c += 2 ) {
+    __m128d xv = _mm_loadu_pd( x + c );
+    __m128d ev = _mm_loadu_pd( ema + c );
+    _mm_storeu_pd( ema + c, _mm_add_pd( ev, _mm_mul_pd( a, _mm_sub_pd( xv, ev ) ) ) );
+    _mm_storeu_pd( sum + c, _mm_add_pd( _mm_loadu_pd( sum + c ), xv ) );
+  }
+#endif
+  for ( ; c < nc; ++c ) {
+    ema[c] += alpha * ( x[c] - ema[c] );
+    sum[c] += x[c];
+  }
+}
+
+class Stats
+{
+public:
+  Stats( Int32 channels, Int32 window, double alpha, Int32 block )
+    : nc_( channels ), window_( window ), alpha_( alpha ), block_( block ),
+      mean_( channels ), m2_( channels ), ema_( channels ), sum_( channels ),
+      ring_( size_t( channels ) * window ), sorted_( size_t( channels ) * window ),
+      blocks_( block > 0 ? size_t( channels ) * STAT_BLOCK_HISTORY : 0 )
+  {
+    reset();
+  }
+
+  std::mutex m;
+
+  void reset()
+  {
+    n_ = 0;
+    filled_ = head_ = 0;
+    inBlock_ = 0;
+    blockHead_ = blockCount_ = 0;
+    std::fill( mean_.begin(), mean_.end(), 0. );
+    std::fill( m2_.begin(), m2_.end(), 0. );
+    std::fill( sum_.begin(), sum_.end(), 0. );
+  }
+
+  void push( const double* x )
+  {
+    ++n_;
+    if ( n_ == 1 )
+      std::copy( x, x + nc_, ema_.begin() );
+    welford( x, mean_.data(), m2_.data(), 1. / double( n_ ), nc_ );
+    emaAndSum( x, ema_.data(), sum_.data(), alpha_, nc_ );
+
+    if ( window_ > 0 )
+      slide( x );
+
+    if ( block_ > 0 && ++inBlock_ == block_ ) {
+      double* out = &blocks_[size_t( blockHead_ ) * nc_];
+      for ( Int32 c = 0; c < nc_; ++c )
+        out[c] = sum_[c] / block_;
+      std::fill( sum_.begin(), sum_.end(), 0. );
+      inBlock_   = 0;
+      blockHead_ = ( blockHead_ + 1 ) % STAT_BLOCK_HISTORY;
+      blockCount_ = std::min( blockCount_ + 1, STAT_BLOCK_HISTORY );
+    }
+  }
+
+  size_t channels() const { return size_t( nc_ ); }
+  double count() const { return double( n_ ); }
+  const double* mean() const { return mean_.data(); }
+  const double* ema() const { return ema_.data(); }
+
+  void variance( double* v ) const
+  {
+    for ( Int32 c = 0; c < nc_; ++c )
+      v[c] = n_ > 1 ? m2_[c] / double( n_ - 1 ) : 0.;
+  }
+
+  bool percentile( double p, double* out ) const
+  {
+    if ( window_ <= 0 || filled_ == 0 )
+      return false;
+    double pos = p / 100. * ( filled_ - 1 );
+    Int32  lo  = Int32( std::floor( pos ) );
+    Int32  hi  = std::min( lo + 1, filled_ - 1 );
+    double f   = pos - lo;
+    for ( Int32 c = 0; c < nc_; ++c ) {
+      const double* s = &sorted_[size_t( c ) * window_];
+      out[c] = s[lo] + f * ( s[hi] - s[lo] );
+    }
+    return true;
+  }
+
+  Int32 blocks( double* out, Int32 size )
+  {
+    Int32 n     = std::min( size, blockCount_ );
+    Int32 first = ( blockHead_ - blockCount_ + STAT_BLOCK_HISTORY ) % STAT_BLOCK_HISTORY;
+    for ( Int32 k = 0; k < n; ++k ) {
+      const double* b = &blocks_[size_t( ( first + k ) % STAT_BLOCK_HISTORY ) * nc_];
+      std::copy( b, b + nc_, out + size_t( k ) * nc_ );
+    }
+    blockCount_ -= n;
+    return n;
+  }
+
+  bool hasData() const { return n_ > 0; }
+
+private:
+  /** Replaces the oldest window sample of each channel, keeping the sorted
+   *  copy ordered with two binary searches and one move.                 */
+  void slide( const double* x )
+  {
+    for ( Int32 c = 0; c < nc_; ++c ) {
+      double* ring = &ring_[size_t( c ) * window_];
+      double* s    = &sorted_[size_t( c ) * window_];
+      double  v    = x[c];
+      if ( filled_ < window_ ) {
+        double* at = std::upper_bound( s, s + filled_, v );
+        std::memmove( at + 1, at, size_t( s + filled_ - at ) * sizeof( double ) );
+        *at = v;
+      }
+      else {
+        double  old = ring[head_];
+        double* from = std::lower_bound( s, s + window_, old );
+        double* to   = std::upper_bound( s, s + window_, v );
+        if ( from < to ) {
+          std::memmove( from, from + 1, size_t( to - from - 1 ) * sizeof( double ) );
+          to[-1] = v;
+        }
+        else {
+          std::memmove( to + 1, to, size_t( from - to ) * sizeof( double ) );
+          *to = v;
+        }
+      }
+      ring[head_] = v;
+    }
+    head_ = ( head_ + 1 ) % window_;
+    if ( filled_ < window_ )
+      ++filled_;
+  }
+
+  Int32  nc_, window_;
+  double alpha_;
+  Int32  block_;
+  long long n_;
+  Int32  filled_, head_;
+  Int32  inBlock_, blockHead_, blockCount_;
+  std::vector<double> mean_, m2_, ema_, sum_;
+  std::vector<double> ring_, sorted_;   /**< window samples per channel, channel major */
+  std::vector<double> blocks_;          /**< ring of completed block means             */
+};
+
+
+struct Registry {
+  std::mutex                              m;
+  Int32                                   nextId = 1;
+  std::map<Int32, std::shared_ptr<Stats>> stats;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Stats> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.stats.find( handle );
+  return it == reg.stats.end() ? std::shared_ptr<Stats>() : it->second;
+}
+
+} // namespace
+
+
+Int32 STAT_API STAT_create( Int32 channels,
+                            Int32 window,
+                            double alpha,
+                            Int32 block,
+                            Int32* handle )
+{
+  if ( channels < 1 || window < 0 || block < 0 || !( alpha > 0. && alpha <= 1. ) || !handle )
+    return STAT_InvalidParam;
+  try {
+    std::shared_ptr<Stats> s = std::make_shared<Stats>( channels, window, alpha, block );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *handle = reg.nextId++;
+    reg.stats[*handle] = s;
+    return STAT_Ok;
+  }
+  catch ( ... ) {
+    return STAT_Error;
+  }
+}
+
+
+Int32 STAT_API STAT_close( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.stats.erase( handle ) ? STAT_Ok : STAT_NotConnected;
+}
+
+
+Int32 STAT_API STAT_reset( Int32 handle )
+{
+  std::shared_ptr<Stats> s = find( handle );
+  if ( !s )
+    return STAT_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  s->reset();
+  return STAT_Ok;
+}
+
+
+Int32 STAT_API STAT_push( Int32 handle, const double* samples, Int32 n )
+{
+  if ( n < 0 || ( n > 0 && !samples ) )
+    return STAT_InvalidParam;
+  std::shared_ptr<Stats> s = find( handle );
+  if ( !s )
+    return STAT_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  for ( Int32 k = 0; k < n; ++k )
+    s->push( samples + size_t( k ) * s->channels() );
+  return STAT_Ok;
+}
+
+
+Int32 STAT_API STAT_mean( Int32 handle, double* mean, double* variance, double* count )
+{
+  if ( !mean )
+    return STAT_InvalidParam;
+  std::shared_ptr<Stats> s = find( handle );
+  if ( !s )
+    return STAT_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  if ( count )
+    *count = s->count();
+  if ( !s->hasData() )
+    return STAT_NoData;
+  std::copy( s->mean(), s->mean() + s->channels(), mean );
+  if ( variance )
+    s->variance( variance );
+  return STAT_Ok;
+}
+
+
+Int32 STAT_API STAT_ema( Int32 handle, double* ema )
+{
+  if ( !ema )
+    return STAT_InvalidParam;
+  std::shared_ptr<Stats> s = find( handle );
+  if ( !s )
+    return STAT_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  if ( !s->hasData() )
+    return STAT_NoData;
+  std::copy( s->ema(), s->ema() + s->channels(), ema );
+  return STAT_Ok;
+}
+
+
+Int32 STAT_API STAT_percentile( Int32 handle, double p, double* value )
+{
+  if ( !value || !( p >= 0. && p <= 100. ) )
+    return STAT_InvalidParam;
+  std::shared_ptr<Stats> s = find( handle );
+  if ( !s )
+    return STAT_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  return s->percentile( p, value ) ? STAT_Ok : STAT_NoData;
+}
+
+
+Int32 STAT_API STAT_blocks( Int32 handle, double* means, Int32 size, Int32* count )
+{
+  if ( size < 0 || ( size > 0 && !means ) || !count )
+    return STAT_InvalidParam;
+  std::shared_ptr<Stats> s = find( handle );
+  if ( !s )
+    return STAT_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  *count = s->blocks( means, size );
+  return STAT_Ok;
+}
@@ -0,0 +1,141 @@
+/******************************************************************/
+/** @file streamstats.h
+ *  Streaming statistics DLL
+ *
+ *  One preallocated statistics state for an array of channels, shared by
+ *  the averaging VIs of all instruments (Running Avg.vi, the TIO field
+ *  data averages, MH_RateDatAvg.vi...). Each pushed sample updates, for
+ *  every channel at once:
+ *    - running mean and variance since the last reset (Welford)
+ *    - an exponential moving average
+ *    - a sliding window for median and percentiles
+ *    - block averages over a fixed number of samples
+ *  The per sample cost is constant and nothing is allocated after
+ *  @ref STAT_create.
+ */
+/******************************************************************/
+
+#ifndef __STREAMSTATS_H__
+#define __STREAMSTATS_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define STAT_API
+#else
+#ifdef  DLL_EXPORT
+#define STAT_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define STAT_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define STAT_Ok                  0              /**< No error                              */
+#define STAT_Error             (-1)             /**< Unspecified error                     */
+#define STAT_NotConnected       -2              /**< Handle does not exist                 */
+#define STAT_InvalidParam       -9              /**< Parameter out of range                */
+#define STAT_NoData            -15              /**< No sample pushed yet                  */
+
+#define STAT_BLOCK_HISTORY    1024              /**< Completed blocks kept until fetched   */
+
+
+/** @brief Create a statistics state
+ *
+ *  @param  channels  Number of channels
+ *  @param  window    Samples in the median/percentile window, 0 disables it
+ *  @param  alpha     EMA weight of a new sample (0..1]
+ *  @param  block     Samples per block average, 0 disables it
+ *  @param  handle    Output: statistics handle
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_create( Int32 channels,
+                            Int32 window,
+                            double alpha,
+                            Int32 block,
+                            Int32* handle );
+
+
+/** @brief Release a statistics state
+ *
+ *  @param  handle    Statistics handle
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_close( Int32 handle );
+
+
+/** @brief Forget all samples
+ *
+ *  @param  handle    Statistics handle
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_reset( Int32 handle );
+
+
+/** @brief Push samples
+ *
+ *  @param  handle    Statistics handle
+ *  @param  samples   n samples of all channels, sample major
+ *                    (samples[k * channels + c]); values must be finite
+ *  @param  n         Number of samples
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_push( Int32 handle, const double* samples, Int32 n );
+
+
+/** @brief Running mean and variance since the last reset
+ *
+ *  @param  handle    Statistics handle
+ *  @param  mean      Output: mean per channel
+ *  @param  variance  Output: sample variance per channel (may be NULL)
+ *  @param  count     Output: number of samples (may be NULL)
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_mean( Int32 handle, double* mean, double* variance, double* count );
+
+
+/** @brief Exponential moving average
+ *
+ *  @param  handle    Statistics handle
+ *  @param  ema       Output: EMA per channel
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_ema( Int32 handle, double* ema );
+
+
+/** @brief Percentile over the sliding window
+ *
+ *  @param  handle    Statistics handle
+ *  @param  p         Percentile [0..100], 50 for the median
+ *  @param  value     Output: percentile per channel, linear interpolation
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_percentile( Int32 handle, double p, double* value );
+
+
+/** @brief Fetch completed block averages
+ *
+ *  Returns the blocks completed since the previous call, oldest first;
+ *  at most @ref STAT_BLOCK_HISTORY blocks are kept.
+ *
+ *  @param  handle    Statistics handle
+ *  @param  means     Output: count * channels means, block major
+ *  @param  size      Maximum number of blocks to fetch
+ *  @param  count     Output: number of blocks written
+ *  @return           Result of function
+ */
+Int32 STAT_API STAT_blocks( Int32 handle, double* means, Int32 size, Int32* count );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
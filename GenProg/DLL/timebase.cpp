@@ -0,0 +1,425 @@
+/******************************************************************/
+/** @file timebase.cpp
+ *  Host timebase DLL
+ *
+ *  Implementation of @ref timebase.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "timebase.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define TB_SSE2
+#endif
+
+namespace {
+
+const double kMinSpread   = 1e-6;   /**< floor of the read interval [s]      */
+const double kUtcInterval = 1.;     /**< UTC sampling interval in TB_now [s] */
+const double kUtcMemory   = 3600.;  /**< time constant of the UTC fit [s]    */
+const double kUtcStep     = 0.5;    /**< system clock step restarting it [s] */
+
+double hostNow()
+{
+  return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+double systemNow()
+{
+  return std::chrono::duration<double>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+
+/** Weighted linear fit y = y0 + a + b (x - x0) with exponential forgetting
+ *  over y. Sums are kept relative to the first sample so that the
+ *  absolute clock values do not cost precision                          */
+class Fit
+{
+public:
+  explicit Fit( double memory ) : memory_( memory ) { reset(); }
+
+  void reset()
+  {
+    n_ = s_ = sx_ = sy_ = sxx_ = sxy_ = syy_ = 0.;
+    x0_ = y0_ = last_ = a_ = 0.;
+    b_ = 1.;
+  }
+
+  double samples() const { return n_; }
+
+  void add( double x, double y, double w )
+  {
+    if ( n_ == 0. ) {
+      x0_   = x;
+      y0_   = y;
+      last_ = y;
+    }
+    if ( memory_ > 0. && y > last_ ) {
+      double f = std::exp( ( last_ - y ) / memory_ );
+      s_   *= f;
+      sx_  *= f;
+      sy_  *= f;
+      sxx_ *= f;
+      sxy_ *= f;
+      syy_ *= f;
+      last_ = y;
+    }
+    double dx = x - x0_, dy = y - y0_;
+    s_   += w;
+    sx_  += w * dx;
+    sy_  += w * dy;
+    sxx_ += w * dx * dx;
+    sxy_ += w * dx * dy;
+    syy_ += w * dy * dy;
+    n_   += 1.;
+
+    double det = s_ * sxx_ - sx_ * sx_;
+    b_ = n_ > 1. && det > 1e-12 * s_ * sxx_ ? ( s_ * sxy_ - sx_ * sy_ ) / det : 1.;
+    a_ = ( sy_ - b_ * sx_ ) / s_;
+  }
+
+  /** y of x */
+  double y( double x ) const { return y0_ + a_ + b_ * ( x - x0_ ); }
+
+  /** y of n values of x; in and out may be the same array               */
+  void y( const double* x, double* out, Int32 n ) const
+  {
+    transform( x, out, n, x0_, b_, y0_ + a_ );
+  }
+
+  /** x of n values of y; in and out may be the same array               */
+  void x( const double* y, double* out, Int32 n ) const
+  {
+    transform( y, out, n, y0_ + a_, 1. / b_, x0_ );
+  }
+
+  double slope() const { return b_; }
+  double intercept() const { return y( 0. ); }
+
+  double residual() const
+  {
+    if ( s_ <= 0. )
+      return 0.;
+    double rss = syy_ - a_ * sy_ - b_ * sxy_;
+    return rss > 0. ? std::sqrt( rss / s_ ) : 0.;
+  }
+
+private:
+  /** out = ( in - from ) * scale + to                                   */
+  static void transform( const double* in, double* out, Int32 n, double from, double scale, double to )
+  {
+    Int32 k = 0;
+#ifdef TB_SSE2
+    const __m128d f = _mm_set1_pd( from ), s = _mm_set1_pd( scale ), t = _mm_set1_pd( to );
+    for ( ; k + 2 <= n; k += 2 )
+      _mm_storeu_pd( out + k, _mm_add_pd( _mm_mul_pd( _mm_sub_pd( _mm_loadu_pd( in + k ), f ), s ), t ) );
+#endif
+    for ( ; k < n; ++k )
+      out[k] = ( in[k] - from ) * scale + to;
+  }
+
+  double memory_;
+  double n_, s_, sx_, sy_, sxx_, sxy_, syy_;
+  double x0_, y0_, last_, a_, b_;
+};
+
+
+/** UTC as a function of the host clock, fed from TB_now                 */
+struct Utc {
+  std::mutex m;
+  Fit        fit{ kUtcMemory };
+  double     next = -std::numeric_limits<double>::infinity();
+};
+
+Utc& utc()
+{
+  static Utc u;
+  return u;
+}
+
+/** Takes a system clock sample if due; call with the UTC mutex held     */
+void sampleUtc( Utc& u, double host )
+{
+  if ( host < u.next )
+    return;
+  double t0 = hostNow(), s = systemNow(), t1 = hostNow();
+  double x  = 0.5 * ( t0 + t1 );
+  double h  = std::max( 0.5 * ( t1 - t0 ), kMinSpread );
+  if ( u.fit.samples() > 0. && std::fabs( u.fit.y( x ) - s ) > kUtcStep )
+    u.fit.reset();
+  u.fit.add( x, s, 1. / ( h * h ) );
+  u.next = host + kUtcInterval;
+}
+
+
+struct Map {
+  explicit Map( double memory ) : fit( memory ) {}
+  std::mutex m;
+  Fit        fit;
+};
+
+struct Registry {
+  std::mutex                            m;
+  Int32                                 nextId = 1;
+  std::map<Int32, std::shared_ptr<Map>> maps;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Map> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.maps.find( handle );
+  return it == reg.maps.end() ? std::shared_ptr<Map>() : it->second;
+}
+
+#ifdef TB_SSE2
+/** out[c] = v0[c] + f ( v1[c] - v0[c] )                                 */
+inline void lerp( const double* v0, const double* v1, double f, double* out, Int32 columns )
+{
+  Int32 c = 0;
+  const __m128d fv = _mm_set1_pd( f );
+  for ( ; c + 2 <= columns; c += 2 ) {
+    __m128d p = _mm_loadu_pd( v0 + c );
+    _mm_storeu_pd( out + c, _mm_add_pd( p, _mm_mul_pd( fv, _mm_sub_pd( _mm_loadu_pd( v1 + c ), p ) ) ) );
+  }
+  for ( ; c < columns; ++c )
+    out[c] = v0[c] + f * ( v1[c] - v0[c] );
+}
+#else
+inline void lerp( const double* v0, const double* v1, double f, double* out, Int32 columns )
+{
+  for ( Int32 c = 0; c < columns; ++c )
+    out[c] = v0[c] + f * ( v1[c] - v0[c] );
+}
+#endif
+
+} // namespace
+
+
+Int32 TB_API TB_now( double* host, double* utcTime )
+{
+  if ( !host )
+    return TB_InvalidParam;
+  *host = hostNow();
+  if ( utcTime ) {
+    Utc& u = utc();
+    std::lock_guard<std::mutex> lk( u.m );
+    sampleUtc( u, *host );
+    *utcTime = u.fit.y( *host );
+  }
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_toUTC( const double* host, double* utcTime, Int32 n )
+{
+  if ( !host || !utcTime || n < 0 )
+    return TB_InvalidParam;
+  Utc& u = utc();
+  std::lock_guard<std::mutex> lk( u.m );
+  sampleUtc( u, hostNow() );
+  u.fit.y( host, utcTime, n );
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_drift( double* ppm )
+{
+  if ( !ppm )
+    return TB_InvalidParam;
+  Utc& u = utc();
+  std::lock_guard<std::mutex> lk( u.m );
+  sampleUtc( u, hostNow() );
+  *ppm = ( 1. / u.fit.slope() - 1. ) * 1e6;
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_createMap( double memory, Int32* map )
+{
+  if ( !( memory >= 0. ) || !map )
+    return TB_InvalidParam;
+  try {
+    std::shared_ptr<Map> m = std::make_shared<Map>( memory );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *map = reg.nextId++;
+    reg.maps[*map] = m;
+    return TB_Ok;
+  }
+  catch ( ... ) {
+    return TB_Error;
+  }
+}
+
+
+Int32 TB_API TB_closeMap( Int32 map )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.maps.erase( map ) ? TB_Ok : TB_NotConnected;
+}
+
+
+Int32 TB_API TB_resetMap( Int32 map )
+{
+  std::shared_ptr<Map> m = find( map );
+  if ( !m )
+    return TB_NotConnected;
+  std::lock_guard<std::mutex> lk( m->m );
+  m->fit.reset();
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_sample( Int32 map, double device, double before, double after )
+{
+  if ( !std::isfinite( device ) || !std::isfinite( before ) || !( after >= before ) )
+    return TB_InvalidParam;
+  std::shared_ptr<Map> m = find( map );
+  if ( !m )
+    return TB_NotConnected;
+  double h = std::max( 0.5 * ( after - before ), kMinSpread );
+  std::lock_guard<std::mutex> lk( m->m );
+  m->fit.add( device, 0.5 * ( before + after ), 1. / ( h * h ) );
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_toHost( Int32 map, const double* device, double* host, Int32 n )
+{
+  if ( !device || !host || n < 0 )
+    return TB_InvalidParam;
+  std::shared_ptr<Map> m = find( map );
+  if ( !m )
+    return TB_NotConnected;
+  std::lock_guard<std::mutex> lk( m->m );
+  if ( m->fit.samples() == 0. )
+    return TB_NoData;
+  m->fit.y( device, host, n );
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_toDevice( Int32 map, const double* host, double* device, Int32 n )
+{
+  if ( !host || !device || n < 0 )
+    return TB_InvalidParam;
+  std::shared_ptr<Map> m = find( map );
+  if ( !m )
+    return TB_NotConnected;
+  std::lock_guard<std::mutex> lk( m->m );
+  if ( m->fit.samples() == 0. )
+    return TB_NoData;
+  m->fit.x( host, device, n );
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_mapInfo( Int32 map,
+                         double* ppm,
+                         double* offset,
+                         double* residual,
+                         double* samples )
+{
+  std::shared_ptr<Map> m = find( map );
+  if ( !m )
+    return TB_NotConnected;
+  std::lock_guard<std::mutex> lk( m->m );
+  if ( samples )
+    *samples = m->fit.samples();
+  if ( m->fit.samples() == 0. )
+    return TB_NoData;
+  if ( ppm )
+    *ppm = ( 1. / m->fit.slope() - 1. ) * 1e6;
+  if ( offset )
+    *offset = m->fit.intercept();
+  if ( residual )
+    *residual = m->fit.residual();
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_join( const double* a,
+                      Int32 na,
+                      const double* b,
+                      Int32 nb,
+                      double tolerance,
+                      Int32* index,
+                      double* delta )
+{
+  if ( !a || !b || !index || na < 0 || nb < 0 || !( tolerance >= 0. ) )
+    return TB_InvalidParam;
+  Int32 j = 0;
+  for ( Int32 i = 0; i < na; ++i ) {
+    const double t = a[i];
+    while ( j + 1 < nb && b[j + 1] <= t )
+      ++j;
+    Int32  k = -1;
+    double d = 0.;
+    if ( nb > 0 ) {
+      k = j;
+      d = t - b[j];
+      if ( j + 1 < nb && std::fabs( t - b[j + 1] ) < std::fabs( d ) ) {
+        k = j + 1;
+        d = t - b[j + 1];
+      }
+      if ( !( std::fabs( d ) <= tolerance ) )
+        k = -1;
+    }
+    index[i] = k;
+    if ( delta )
+      delta[i] = k < 0 ? std::numeric_limits<double>::quiet_NaN() : d;
+  }
+  return TB_Ok;
+}
+
+
+Int32 TB_API TB_interpolate( const double* a,
+                             Int32 na,
+                             const double* b,
+                             const double* values,
+                             Int32 nb,
+                             Int32 columns,
+                             double* out )
+{
+  if ( !a || !b || !values || !out || na < 0 || nb < 0 || columns < 1 )
+    return TB_InvalidParam;
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  Int32 j = 0;
+  for ( Int32 i = 0; i < na; ++i ) {
+    const double t = a[i];
+    double*      o = out + size_t( i ) * columns;
+    while ( j + 2 < nb && b[j + 1] <= t )
+      ++j;
+    if ( nb == 0 || t < b[0] || t > b[nb - 1] ) {
+      for ( Int32 c = 0; c < columns; ++c )
+        o[c] = nan;
+      continue;
+    }
+    const double* v0 = values + size_t( j ) * columns;
+    if ( nb == 1 || b[j + 1] == b[j] ) {
+      for ( Int32 c = 0; c < columns; ++c )
+        o[c] = v0[c];
+      continue;
+    }
+    lerp( v0, v0 + columns, ( t - b[j] ) / ( b[j + 1] - b[j] ), o, columns );
+  }
+  return TB_Ok;
+}
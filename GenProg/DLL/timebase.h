@@ -0,0 +1,207 @@
+/******************************************************************/
+/** @file timebase.h
+ *  Host timebase DLL
+ *
+ *  One time axis for all acquisition libraries. The host clock is the
+ *  steady clock in seconds with which the SR830 stream and the frame
+ *  ring stamp their data; it never jumps. Its drift against UTC is
+ *  estimated continuously, so host times can be given as UTC without
+ *  following the steps of the system clock.
+ *
+ *  Device clocks (MultiHarp start time and time tags, AMC300
+ *  getPositionWithTime, DAQ6363 sample clock...) are mapped onto the
+ *  host clock by a linear fit, updated online from pairs of a device
+ *  time stamp and the host times just before and after it was read.
+ *  Acquisition loops convert their time stamps with @ref TB_toHost as
+ *  they read, and @ref TB_join / @ref TB_interpolate align the streams
+ *  without an offline nearest neighbour search.
+ */
+/******************************************************************/
+
+#ifndef __TIMEBASE_H__
+#define __TIMEBASE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define TB_API
+#else
+#ifdef  DLL_EXPORT
+#define TB_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define TB_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define TB_Ok                    0              /**< No error                              */
+#define TB_Error               (-1)             /**< Unspecified error                     */
+#define TB_NotConnected         -2              /**< Map handle does not exist             */
+#define TB_InvalidParam         -9              /**< Parameter out of range                */
+#define TB_NoData              -15              /**< Map has no sample yet                 */
+
+
+/** @brief Current host time
+ *
+ *  @param  host      Output: host clock [s]
+ *  @param  utc       Output: the same instant as UTC [s since 1970],
+ *                    drift corrected (may be NULL)
+ *  @return           Result of function
+ */
+Int32 TB_API TB_now( double* host, double* utc );
+
+
+/** @brief Convert host times to UTC
+ *
+ *  @param  host      Host times [s]
+ *  @param  utc       Output: UTC [s since 1970], may be the host array
+ *  @param  n         Number of times
+ *  @return           Result of function
+ */
+Int32 TB_API TB_toUTC( const double* host, double* utc, Int32 n );
+
+
+/** @brief Host clock drift against UTC
+ *
+ *  @param  ppm       Output: (host rate - UTC rate) / UTC rate * 1e6
+ *  @return           Result of function
+ */
+Int32 TB_API TB_drift( double* ppm );
+
+
+/** @brief Create a device clock map
+ *
+ *  @param  memory    Time constant [s of host time] after which old
+ *                    samples have lost 63 % of their weight; 0 never
+ *                    forgets (fixed oscillator, short runs)
+ *  @param  map       Output: map handle
+ *  @return           Result of function
+ */
+Int32 TB_API TB_createMap( double memory, Int32* map );
+
+
+/** @brief Release a device clock map
+ *
+ *  @param  map       Map handle
+ *  @return           Result of function
+ */
+Int32 TB_API TB_closeMap( Int32 map );
+
+
+/** @brief Forget all samples, e.g. after the device clock was reset
+ *
+ *  @param  map       Map handle
+ *  @return           Result of function
+ */
+Int32 TB_API TB_resetMap( Int32 map );
+
+
+/** @brief Add a device / host time pair
+ *
+ *  The device time stamp was read between before and after; the pair
+ *  is weighted with the inverse square of that interval.
+ *
+ *  @param  map       Map handle
+ *  @param  device    Device time [s]
+ *  @param  before    Host time before the device read [s]
+ *  @param  after     Host time after the device read [s]
+ *  @return           Result of function
+ */
+Int32 TB_API TB_sample( Int32 map, double device, double before, double after );
+
+
+/** @brief Convert device times to host times
+ *
+ *  @param  map       Map handle
+ *  @param  device    Device times [s]
+ *  @param  host      Output: host times [s], may be the device array
+ *  @param  n         Number of times
+ *  @return           Result of function
+ */
+Int32 TB_API TB_toHost( Int32 map, const double* device, double* host, Int32 n );
+
+
+/** @brief Convert host times to device times
+ *
+ *  @param  map       Map handle
+ *  @param  host      Host times [s]
+ *  @param  device    Output: device times [s], may be the host array
+ *  @param  n         Number of times
+ *  @return           Result of function
+ */
+Int32 TB_API TB_toDevice( Int32 map, const double* host, double* device, Int32 n );
+
+
+/** @brief State of the fit
+ *
+ *  @param  map       Map handle
+ *  @param  ppm       Output: device clock rate error against the host [ppm]
+ *  @param  offset    Output: host time of device time 0 [s]
+ *  @param  residual  Output: weighted rms residual of the samples [s]
+ *  @param  samples   Output: number of samples since create or reset
+ *  @return           Result of function
+ */
+Int32 TB_API TB_mapInfo( Int32 map,
+                         double* ppm,
+                         double* offset,
+                         double* residual,
+                         double* samples );
+
+
+/** @brief Nearest neighbour join of two time stamped streams
+ *
+ *  Both time arrays must be ascending and on the same clock.
+ *
+ *  @param  a         Times of stream A
+ *  @param  na        Number of A times
+ *  @param  b         Times of stream B
+ *  @param  nb        Number of B times
+ *  @param  tolerance Largest accepted |a - b|
+ *  @param  index     Output: na indices into b, -1 where none is in tolerance
+ *  @param  delta     Output: na differences a - b[index] (may be NULL)
+ *  @return           Result of function
+ */
+Int32 TB_API TB_join( const double* a,
+                      Int32 na,
+                      const double* b,
+                      Int32 nb,
+                      double tolerance,
+                      Int32* index,
+                      double* delta );
+
+
+/** @brief Values of stream B linearly interpolated at the times of A
+ *
+ *  Both time arrays must be ascending and on the same clock. Times of A
+ *  outside the range of B give NaN.
+ *
+ *  @param  a         Times of stream A
+ *  @param  na        Number of A times
+ *  @param  b         Times of stream B
+ *  @param  values    nb * columns values of B, row major
+ *  @param  nb        Number of B times
+ *  @param  columns   Values per B time (axes, channels)
+ *  @param  out       Output: na * columns values, row major
+ *  @return           Result of function
+ */
+Int32 TB_API TB_interpolate( const double* a,
+                             Int32 na,
+                             const double* b,
+                             const double* values,
+                             Int32 nb,
+                             Int32 columns,
+                             double* out );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,906 @@
+/******************************************************************/
+/** @file framering.cpp
+ *  Shared memory frame transport DLL
+ *
+ *  Implementation of @ref framering.h
+ *
+ *  Shared memory layout: a 128 byte ring header followed by the slots,
+ *  each a 64 byte slot header and the frame data. The slot sequence
+ *  word works as a seqlock: 2f-1 while frame f is written, 2f once it
+ *  is complete. Readers copy and check the word again, so a slot that
+ *  the writer reused during the copy is detected and skipped.
+ *
+ *  Wire format of served frames (little endian): "FRMS", uint32 frame,
+ *  double exposure, double timestamp, uint32 width, height, pixelType,
+ *  bytes, lost, uint32 0, then the frame data.
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "framering.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char     kMagic[8]     = { 'F', 'R', 'M', 'R', 'I', 'N', 'G', '1' };
+const size_t   kRingHeader   = 128;
+const size_t   kSlotHeader   = 64;
+const size_t   kWireHeader   = 48;
+const char     kWireMagic[4] = { 'F', 'R', 'M', 'S' };
+const Int32    kPollMs       = 200;      /**< stop flag check of server threads */
+
+struct RingHeader {
+  char                  magic[8];
+  uint32_t              slots;
+  uint32_t              pid;            /**< writer process, to detect stale rings */
+  uint64_t              slotBytes;
+  uint64_t              stride;         /**< slot header + data, 64 byte multiple  */
+  std::atomic<uint64_t> written;        /**< last published frame number           */
+  std::atomic<uint32_t> wake;           /**< futex word, incremented per frame      */
+  std::atomic<uint32_t> waiters;        /**< readers sleeping on wake               */
+};
+
+struct SlotHeader {
+  std::atomic<uint64_t> seq;
+  double                exposure;
+  double                timestamp;
+  uint32_t              width, height, pixelType, bytes;
+};
+
+static_assert( sizeof( RingHeader ) <= kRingHeader, "ring header too large" );
+static_assert( sizeof( SlotHeader ) <= kSlotHeader, "slot header too large" );
+
+/** Host clock of timebase.h: steady seconds, common to all processes    */
+double hostTime()
+{
+  return std::chrono::duration<double>( Clock::now().time_since_epoch() ).count();
+}
+
+bool validName( const char* name )
+{
+  size_t n = name ? std::strlen( name ) : 0;
+  if ( n == 0 || n > 64 )
+    return false;
+  for ( size_t k = 0; k < n; ++k ) {
+    char c = name[k];
+    if ( !( ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' ) || c == '_' ) )
+      return false;
+  }
+  return true;
+}
+
+
+/* ----- Notification --------------------------------------------------------- */
+
+void waitWord( std::atomic<uint32_t>* word, uint32_t seen, Int32 ms )
+{
+#ifdef __linux__
+  struct timespec ts;
+  ts.tv_sec  = ms / 1000;
+  ts.tv_nsec = long( ms % 1000 ) * 1000000L;
+  syscall( SYS_futex, reinterpret_cast<uint32_t*>( word ), FUTEX_WAIT, seen, &ts, nullptr, 0 );
+#else
+  /* No cross process wait on an address: poll */
+  ( void )word;
+  ( void )seen;
+  std::this_thread::sleep_for( std::chrono::microseconds( std::min( ms * 1000, 200 ) ) );
+#endif
+}
+
+void wakeAll( std::atomic<uint32_t>* word )
+{
+#ifdef __linux__
+  syscall( SYS_futex, reinterpret_cast<uint32_t*>( word ), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0 );
+#else
+  ( void )word;
+#endif
+}
+
+
+/* ----- Shared memory -------------------------------------------------------- */
+
+class Mapping
+{
+public:
+  Mapping() : base_( 0 ), size_( 0 ), owner_( false )
+#ifdef _WIN32
+            , handle_( 0 )
+#endif
+  {}
+
+  ~Mapping()
+  {
+#ifdef _WIN32
+    if ( base_ )
+      UnmapViewOfFile( base_ );
+    if ( handle_ )
+      CloseHandle( handle_ );
+#else
+    if ( base_ )
+      munmap( base_, size_ );
+    if ( owner_ )
+      shm_unlink( path_.c_str() );
+#endif
+  }
+
+  /** Creates the named segment; FRM_NotAvailable if a live writer has it */
+  Int32 create( const char* name, size_t size )
+  {
+#ifdef _WIN32
+    path_   = std::string( "Local\\FRM_" ) + name;
+    handle_ = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                  DWORD( uint64_t( size ) >> 32 ), DWORD( size ), path_.c_str() );
+    if ( !handle_ )
+      return FRM_Error;
+    if ( GetLastError() == ERROR_ALREADY_EXISTS )
+      return FRM_NotAvailable;
+    base_ = MapViewOfFile( handle_, FILE_MAP_ALL_ACCESS, 0, 0, size );
+#else
+    path_ = std::string( "/frm_" ) + name;
+    int fd = shm_open( path_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+    if ( fd < 0 && errno == EEXIST && stale() ) {
+      shm_unlink( path_.c_str() );
+      fd = shm_open( path_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600 );
+    }
+    if ( fd < 0 )
+      return errno == EEXIST ? FRM_NotAvailable : FRM_Error;
+    owner_ = true;
+    if ( ftruncate( fd, off_t( size ) ) != 0 ) {
+      ::close( fd );
+      return FRM_Error;
+    }
+    void* p = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    base_ = p == MAP_FAILED ? 0 : p;
+#endif
+    size_ = size;
+    return base_ ? FRM_Ok : FRM_Error;
+  }
+
+  /** Maps an existing segment; readers write only the waiter count     */
+  Int32 open( const char* name )
+  {
+#ifdef _WIN32
+    path_   = std::string( "Local\\FRM_" ) + name;
+    handle_ = OpenFileMappingA( FILE_MAP_READ | FILE_MAP_WRITE, FALSE, path_.c_str() );
+    if ( !handle_ )
+      return FRM_NotAvailable;
+    base_ = MapViewOfFile( handle_, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0 );
+    MEMORY_BASIC_INFORMATION mi;
+    if ( base_ && VirtualQuery( base_, &mi, sizeof( mi ) ) )
+      size_ = mi.RegionSize;
+#else
+    path_ = std::string( "/frm_" ) + name;
+    int fd = shm_open( path_.c_str(), O_RDWR, 0 );
+    if ( fd < 0 )
+      return FRM_NotAvailable;
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 ) {
+      ::close( fd );
+      return FRM_Error;
+    }
+    size_ = size_t( st.st_size );
+    void* p = size_ ? mmap( 0, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+    ::close( fd );
+    base_ = p == MAP_FAILED ? 0 : p;
+#endif
+    return base_ ? FRM_Ok : FRM_NotAvailable;
+  }
+
+  unsigned char* base() const { return static_cast<unsigned char*>( base_ ); }
+  size_t         size() const { return size_; }
+
+private:
+#ifndef _WIN32
+  /** True if the existing segment's writer process has gone             */
+  bool stale() const
+  {
+    int fd = shm_open( path_.c_str(), O_RDONLY, 0 );
+    if ( fd < 0 )
+      return false;
+    RingHeader h;
+    ssize_t n = pread( fd, &h, sizeof( h ), 0 );
+    ::close( fd );
+    if ( n != ssize_t( sizeof( h ) ) || std::memcmp( h.magic, kMagic, 8 ) != 0 )
+      return n == 0;   /* creator died before writing the header */
+    return kill( pid_t( h.pid ), 0 ) != 0 && errno == ESRCH;
+  }
+#endif
+
+  void*       base_;
+  size_t      size_;
+  bool        owner_;
+  std::string path_;
+#ifdef _WIN32
+  HANDLE      handle_;
+#endif
+};
+
+
+/* ----- Ring ----------------------------------------------------------------- */
+
+class Ring
+{
+public:
+  explicit Ring( std::unique_ptr<Mapping> map )
+    : map_( std::move( map ) ), head_( reinterpret_cast<RingHeader*>( map_->base() ) ) {}
+
+  /** Lays out a freshly created segment                                  */
+  void init( uint32_t slots, uint64_t slotBytes, uint64_t stride )
+  {
+    std::memcpy( head_->magic, kMagic, 8 );
+    head_->slots     = slots;
+    head_->slotBytes = slotBytes;
+    head_->stride    = stride;
+#ifdef _WIN32
+    head_->pid       = uint32_t( GetCurrentProcessId() );
+#else
+    head_->pid       = uint32_t( getpid() );
+#endif
+    head_->written.store( 0 );
+    head_->wake.store( 0 );
+    head_->waiters.store( 0 );
+  }
+
+  /** Checks the header of an attached segment                           */
+  bool valid() const
+  {
+    if ( map_->size() < kRingHeader || std::memcmp( head_->magic, kMagic, 8 ) != 0 )
+      return false;
+    return head_->slots >= 2 && head_->stride >= kSlotHeader + head_->slotBytes
+        && kRingHeader + head_->stride * head_->slots <= map_->size();
+  }
+
+  uint64_t written() const { return head_->written.load( std::memory_order_acquire ); }
+  Int32    capacity() const { return Int32( head_->slotBytes ); }
+
+  /* --- Writer --- */
+
+  unsigned char* begin( uint64_t f )
+  {
+    SlotHeader* s = slot( f );
+    s->seq.store( 2 * f - 1, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+    return data( s );
+  }
+
+  void end( uint64_t f, const FRM_FrameInfo& info )
+  {
+    SlotHeader* s = slot( f );
+    s->exposure  = info.exposure;
+    s->timestamp = info.timestamp != 0. ? info.timestamp : hostTime();
+    s->width     = uint32_t( info.width );
+    s->height    = uint32_t( info.height );
+    s->pixelType = uint32_t( info.pixelType );
+    s->bytes     = uint32_t( info.bytes );
+    s->seq.store( 2 * f, std::memory_order_release );
+    head_->written.store( f, std::memory_order_release );
+    head_->wake.fetch_add( 1, std::memory_order_release );
+    if ( head_->waiters.load( std::memory_order_seq_cst ) > 0 )
+      wakeAll( &head_->wake );
+  }
+
+  /* --- Reader --- */
+
+  /** Next (or newest) frame after cursor, advancing it                    */
+  Int32 read( uint64_t& cursor, Int32 timeout, bool latest, FRM_FrameInfo* info, void* buf, Int32 size )
+  {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds( timeout );
+    uint64_t          next     = cursor + 1;   /* first frame still wanted */
+    for ( ;; ) {
+      uint32_t seen = head_->wake.load( std::memory_order_acquire );
+      uint64_t w    = written();
+      if ( w >= next ) {
+        uint64_t oldest = w >= head_->slots ? w - head_->slots + 1 : 1;
+        uint64_t f      = latest ? w : std::max( next, oldest );
+        Int32    r      = copy( f, info, buf, size );
+        if ( r != FRM_Timeout ) {
+          info->lost = Int32( f - cursor - 1 );
+          cursor = f;
+          return r;
+        }
+        /* slot being written or reused: skip the frame, it counts as lost */
+        next = f + 1;
+        if ( Clock::now() >= deadline )
+          return FRM_Timeout;
+        continue;
+      }
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>( deadline - Clock::now() ).count();
+      if ( left <= 0 )
+        return FRM_Timeout;
+      head_->waiters.fetch_add( 1, std::memory_order_seq_cst );
+      if ( written() == w )
+        waitWord( &head_->wake, seen, Int32( std::max<long long>( left, 1 ) ) );
+      head_->waiters.fetch_sub( 1, std::memory_order_relaxed );
+    }
+  }
+
+private:
+  SlotHeader* slot( uint64_t f ) const
+  {
+    return reinterpret_cast<SlotHeader*>( map_->base() + kRingHeader + head_->stride * ( ( f - 1 ) % head_->slots ) );
+  }
+
+  static unsigned char* data( SlotHeader* s ) { return reinterpret_cast<unsigned char*>( s ) + kSlotHeader; }
+
+  /** Seqlock read of frame f; FRM_Timeout if the slot was reused         */
+  Int32 copy( uint64_t f, FRM_FrameInfo* info, void* buf, Int32 size )
+  {
+    SlotHeader* s   = slot( f );
+    uint64_t    seq = s->seq.load( std::memory_order_acquire );
+    if ( seq != 2 * f )
+      return FRM_Timeout;
+    FRM_FrameInfo i;
+    i.exposure  = s->exposure;
+    i.timestamp = s->timestamp;
+    i.frame     = Int32( f );
+    i.width     = Int32( s->width );
+    i.height    = Int32( s->height );
+    i.pixelType = Int32( s->pixelType );
+    i.bytes     = Int32( std::min<uint64_t>( s->bytes, head_->slotBytes ) );
+    i.lost      = 0;
+    bool fits = i.bytes <= size;
+    if ( fits )
+      std::memcpy( buf, data( s ), size_t( i.bytes ) );
+    std::atomic_thread_fence( std::memory_order_acquire );
+    if ( s->seq.load( std::memory_order_relaxed ) != seq )
+      return FRM_Timeout;
+    *info = i;
+    return fits ? FRM_Ok : FRM_BufferTooSmall;
+  }
+
+  std::unique_ptr<Mapping> map_;
+  RingHeader*              head_;
+};
+
+
+/* ----- Sockets -------------------------------------------------------------- */
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+const Socket kNoSocket = INVALID_SOCKET;
+void closeSocket( Socket s ) { closesocket( s ); }
+
+bool startSockets()
+{
+  static bool ok = [] { WSADATA d; return WSAStartup( MAKEWORD( 2, 2 ), &d ) == 0; }();
+  return ok;
+}
+
+bool waitSocket( Socket s, short events, Int32 ms )
+{
+  WSAPOLLFD p = { s, events, 0 };
+  return WSAPoll( &p, 1, ms ) > 0;
+}
+
+const int kSendFlags = 0;
+#else
+typedef int Socket;
+const Socket kNoSocket = -1;
+void closeSocket( Socket s ) { ::close( s ); }
+bool startSockets() { return true; }
+
+bool waitSocket( Socket s, short events, Int32 ms )
+{
+  struct pollfd p = { s, events, 0 };
+  return ::poll( &p, 1, ms ) > 0;
+}
+
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0;
+#endif
+#endif
+
+/** Viewers never send, so a readable socket means the peer closed it   */
+bool hungUp( Socket s )
+{
+  char c;
+  return waitSocket( s, POLLIN, 0 ) && ::recv( s, &c, 1, MSG_PEEK ) <= 0;
+}
+
+/** Sends everything unless stop is raised or the peer is gone           */
+bool sendAll( Socket s, const unsigned char* p, size_t n, const std::atomic<bool>& stop )
+{
+  while ( n > 0 ) {
+    if ( stop.load() )
+      return false;
+    if ( !waitSocket( s, POLLOUT, kPollMs ) )
+      continue;
+    int k = ::send( s, reinterpret_cast<const char*>( p ), int( std::min<size_t>( n, 1 << 20 ) ), kSendFlags );
+    if ( k <= 0 )
+      return false;
+    p += k;
+    n -= size_t( k );
+  }
+  return true;
+}
+
+/** Receives exactly n bytes; false on timeout or when the peer is gone  */
+bool recvAll( Socket s, unsigned char* p, size_t n, Clock::time_point deadline )
+{
+  while ( n > 0 ) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>( deadline - Clock::now() ).count();
+    if ( left <= 0 || !waitSocket( s, POLLIN, Int32( left ) ) )
+      return false;
+    int k = ::recv( s, reinterpret_cast<char*>( p ), int( std::min<size_t>( n, 1 << 20 ) ), 0 );
+    if ( k <= 0 )
+      return false;
+    p += k;
+    n -= size_t( k );
+  }
+  return true;
+}
+
+void put32( unsigned char* p, uint32_t v ) { std::memcpy( p, &v, 4 ); }
+void putF64( unsigned char* p, double v ) { std::memcpy( p, &v, 8 ); }
+uint32_t get32( const unsigned char* p ) { uint32_t v; std::memcpy( &v, p, 4 ); return v; }
+double getF64( const unsigned char* p ) { double v; std::memcpy( &v, p, 8 ); return v; }
+
+void encodeHeader( const FRM_FrameInfo& i, unsigned char* h )
+{
+  std::memset( h, 0, kWireHeader );
+  std::memcpy( h, kWireMagic, 4 );
+  put32( h + 4, uint32_t( i.frame ) );
+  putF64( h + 8, i.exposure );
+  putF64( h + 16, i.timestamp );
+  put32( h + 24, uint32_t( i.width ) );
+  put32( h + 28, uint32_t( i.height ) );
+  put32( h + 32, uint32_t( i.pixelType ) );
+  put32( h + 36, uint32_t( i.bytes ) );
+  put32( h + 40, uint32_t( i.lost ) );
+}
+
+bool decodeHeader( const unsigned char* h, FRM_FrameInfo& i )
+{
+  if ( std::memcmp( h, kWireMagic, 4 ) != 0 )
+    return false;
+  i.frame     = Int32( get32( h + 4 ) );
+  i.exposure  = getF64( h + 8 );
+  i.timestamp = getF64( h + 16 );
+  i.width     = Int32( get32( h + 24 ) );
+  i.height    = Int32( get32( h + 28 ) );
+  i.pixelType = Int32( get32( h + 32 ) );
+  i.bytes     = Int32( get32( h + 36 ) );
+  i.lost      = Int32( get32( h + 40 ) );
+  return i.bytes >= 0;
+}
+
+
+/** TCP server streaming a ring to remote readers                         */
+class Server
+{
+public:
+  Server( std::shared_ptr<Ring> ring, Socket listener )
+    : ring_( ring ), listener_( listener ), stop_( false ), thread_( &Server::accept, this ) {}
+
+  ~Server()
+  {
+    stop_ = true;
+    thread_.join();
+    for ( Client& c : clients_ )
+      c.thread.join();
+    closeSocket( listener_ );
+  }
+
+private:
+  struct Client {
+    std::atomic<bool> done{ false };
+    std::thread       thread;
+  };
+
+  /** Joins the threads of viewers that have disconnected                  */
+  void reap()
+  {
+    for ( auto it = clients_.begin(); it != clients_.end(); ) {
+      if ( it->done ) {
+        it->thread.join();
+        it = clients_.erase( it );
+      }
+      else
+        ++it;
+    }
+  }
+
+  void accept()
+  {
+    while ( !stop_ ) {
+      reap();
+      if ( !waitSocket( listener_, POLLIN, kPollMs ) )
+        continue;
+      Socket s = ::accept( listener_, 0, 0 );
+      if ( s == kNoSocket )
+        continue;
+      int one = 1;
+      setsockopt( s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>( &one ), sizeof( one ) );
+      clients_.emplace_back();
+      clients_.back().thread = std::thread( &Server::serve, this, s, &clients_.back() );
+    }
+  }
+
+  void serve( Socket s, Client* client )
+  {
+    std::vector<unsigned char> buf( kWireHeader + size_t( ring_->capacity() ) );
+    uint64_t      cursor = ring_->written();
+    FRM_FrameInfo info;
+    while ( !stop_ ) {
+      Int32 r = ring_->read( cursor, kPollMs, false, &info, &buf[kWireHeader], ring_->capacity() );
+      if ( r == FRM_Timeout ) {
+        if ( hungUp( s ) )
+          break;
+        continue;
+      }
+      if ( r != FRM_Ok )
+        break;
+      encodeHeader( info, &buf[0] );
+      if ( !sendAll( s, &buf[0], kWireHeader + size_t( info.bytes ), stop_ ) )
+        break;
+    }
+    closeSocket( s );
+    client->done = true;
+  }
+
+  std::shared_ptr<Ring>    ring_;
+  Socket                   listener_;
+  std::atomic<bool>        stop_;
+  std::list<Client>        clients_;   /**< only touched by the accept thread and ~Server */
+  std::thread              thread_;
+};
+
+
+/* ----- Handles -------------------------------------------------------------- */
+
+class Endpoint
+{
+public:
+  virtual ~Endpoint() {}
+  virtual Int32 read( Int32 timeout, bool latest, FRM_FrameInfo* info, void* data, Int32 size ) = 0;
+  std::mutex m;
+};
+
+class Local : public Endpoint
+{
+public:
+  Local( std::shared_ptr<Ring> ring, bool writer )
+    : ring( ring ), writer( writer ), cursor( ring->written() ), pending( 0 ) {}
+
+  Int32 read( Int32 timeout, bool latest, FRM_FrameInfo* info, void* data, Int32 size )
+  {
+    return ring->read( cursor, timeout, latest, info, data, size );
+  }
+
+  std::shared_ptr<Ring>   ring;
+  const bool              writer;
+  uint64_t                cursor;
+  uint64_t                pending;     /**< frame between beginWrite and endWrite */
+  std::unique_ptr<Server> server;
+};
+
+class Remote : public Endpoint
+{
+public:
+  explicit Remote( Socket s ) : s_( s ) {}
+  ~Remote() { closeSocket( s_ ); }
+
+  Int32 read( Int32 timeout, bool latest, FRM_FrameInfo* info, void* data, Int32 size )
+  {
+    FRM_FrameInfo i;
+    Int32 r = receive( Clock::now() + std::chrono::milliseconds( timeout ), i );
+    if ( r != FRM_Ok )
+      return r;
+    while ( latest && waitSocket( s_, POLLIN, 0 ) ) {
+      FRM_FrameInfo next;
+      if ( ( r = receive( Clock::now() + std::chrono::milliseconds( timeout ), next ) ) != FRM_Ok )
+        return r;
+      next.lost += i.lost + 1;
+      i = next;
+    }
+    *info = i;
+    if ( i.bytes > size )
+      return FRM_BufferTooSmall;
+    std::memcpy( data, buf_.data(), size_t( i.bytes ) );
+    return FRM_Ok;
+  }
+
+private:
+  /** One frame into buf_; the rest of a started frame may take 5 s       */
+  Int32 receive( Clock::time_point deadline, FRM_FrameInfo& i )
+  {
+    if ( !waitSocket( s_, POLLIN, Int32( std::max<long long>( 0,
+           std::chrono::duration_cast<std::chrono::milliseconds>( deadline - Clock::now() ).count() ) ) ) )
+      return FRM_Timeout;
+    unsigned char h[kWireHeader];
+    Clock::time_point rest = Clock::now() + std::chrono::seconds( 5 );
+    if ( !recvAll( s_, h, kWireHeader, rest ) || !decodeHeader( h, i ) )
+      return FRM_NotConnected;
+    buf_.resize( size_t( i.bytes ) );
+    if ( i.bytes > 0 && !recvAll( s_, buf_.data(), size_t( i.bytes ), rest ) )
+      return FRM_NotConnected;
+    return FRM_Ok;
+  }
+
+  Socket                     s_;
+  std::vector<unsigned char> buf_;
+};
+
+
+struct Registry {
+  std::mutex                                 m;
+  Int32                                      nextId = 1;
+  std::map<Int32, std::shared_ptr<Endpoint>> endpoints;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Endpoint> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.endpoints.find( handle );
+  return it == reg.endpoints.end() ? std::shared_ptr<Endpoint>() : it->second;
+}
+
+Int32 enroll( std::shared_ptr<Endpoint> e, Int32* handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  *handle = reg.nextId++;
+  reg.endpoints[*handle] = e;
+  return FRM_Ok;
+}
+
+/** Writer endpoint of a handle, or the error to return                  */
+Int32 writer( Int32 handle, std::shared_ptr<Local>& local )
+{
+  std::shared_ptr<Endpoint> e = find( handle );
+  if ( !e )
+    return FRM_NotConnected;
+  local = std::dynamic_pointer_cast<Local>( e );
+  return local && local->writer ? FRM_Ok : FRM_NotWriter;
+}
+
+} // namespace
+
+
+Int32 FRM_API FRM_create( const char* name, Int32 slots, Int32 slotBytes, Int32* ring )
+{
+  if ( !validName( name ) || slots < 2 || slotBytes < 1 || !ring )
+    return FRM_InvalidParam;
+  try {
+    uint64_t stride = ( kSlotHeader + uint64_t( slotBytes ) + 63 ) / 64 * 64;
+    std::unique_ptr<Mapping> map( new Mapping );
+    Int32 r = map->create( name, size_t( kRingHeader + stride * uint64_t( slots ) ) );
+    if ( r != FRM_Ok )
+      return r;
+    std::shared_ptr<Ring> rg = std::make_shared<Ring>( std::move( map ) );
+    rg->init( uint32_t( slots ), uint64_t( slotBytes ), stride );
+    return enroll( std::make_shared<Local>( rg, true ), ring );
+  }
+  catch ( ... ) {
+    return FRM_Error;
+  }
+}
+
+
+Int32 FRM_API FRM_attach( const char* name, Int32* ring )
+{
+  if ( !validName( name ) || !ring )
+    return FRM_InvalidParam;
+  try {
+    std::unique_ptr<Mapping> map( new Mapping );
+    Int32 r = map->open( name );
+    if ( r != FRM_Ok )
+      return r;
+    std::shared_ptr<Ring> rg = std::make_shared<Ring>( std::move( map ) );
+    if ( !rg->valid() )
+      return FRM_NotAvailable;
+    return enroll( std::make_shared<Local>( rg, false ), ring );
+  }
+  catch ( ... ) {
+    return FRM_Error;
+  }
+}
+
+
+Int32 FRM_API FRM_connect( const char* host, Int32 port, Int32* ring )
+{
+  if ( !host || port < 1 || port > 65535 || !ring )
+    return FRM_InvalidParam;
+  if ( !startSockets() )
+    return FRM_Error;
+  struct addrinfo hints, *res = 0;
+  std::memset( &hints, 0, sizeof( hints ) );
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if ( getaddrinfo( host, std::to_string( port ).c_str(), &hints, &res ) != 0 )
+    return FRM_NotAvailable;
+  Socket s = kNoSocket;
+  for ( struct addrinfo* a = res; a && s == kNoSocket; a = a->ai_next ) {
+    s = ::socket( a->ai_family, a->ai_socktype, a->ai_protocol );
+    if ( s != kNoSocket && ::connect( s, a->ai_addr, int( a->ai_addrlen ) ) != 0 ) {
+      closeSocket( s );
+      s = kNoSocket;
+    }
+  }
+  freeaddrinfo( res );
+  if ( s == kNoSocket )
+    return FRM_NotAvailable;
+  try {
+    return enroll( std::make_shared<Remote>( s ), ring );
+  }
+  catch ( ... ) {
+    closeSocket( s );
+    return FRM_Error;
+  }
+}
+
+
+Int32 FRM_API FRM_close( Int32 ring )
+{
+  std::shared_ptr<Endpoint> e;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.endpoints.find( ring );
+    if ( it == reg.endpoints.end() )
+      return FRM_NotConnected;
+    e = it->second;
+    reg.endpoints.erase( it );
+  }
+  std::lock_guard<std::mutex> lk( e->m );
+  if ( Local* l = dynamic_cast<Local*>( e.get() ) )
+    l->server.reset();
+  return FRM_Ok;
+}
+
+
+Int32 FRM_API FRM_write( Int32 ring, const FRM_FrameInfo* info, const void* data )
+{
+  if ( !info || info->bytes < 0 || ( info->bytes > 0 && !data ) )
+    return FRM_InvalidParam;
+  std::shared_ptr<Local> l;
+  Int32 r = writer( ring, l );
+  if ( r != FRM_Ok )
+    return r;
+  std::lock_guard<std::mutex> lk( l->m );
+  if ( info->bytes > l->ring->capacity() )
+    return FRM_InvalidParam;
+  uint64_t f = l->ring->written() + 1;
+  std::memcpy( l->ring->begin( f ), data, size_t( info->bytes ) );
+  l->ring->end( f, *info );
+  l->pending = 0;
+  return FRM_Ok;
+}
+
+
+Int32 FRM_API FRM_beginWrite( Int32 ring, void** data, Int32* capacity )
+{
+  if ( !data )
+    return FRM_InvalidParam;
+  std::shared_ptr<Local> l;
+  Int32 r = writer( ring, l );
+  if ( r != FRM_Ok )
+    return r;
+  std::lock_guard<std::mutex> lk( l->m );
+  l->pending = l->ring->written() + 1;
+  *data = l->ring->begin( l->pending );
+  if ( capacity )
+    *capacity = l->ring->capacity();
+  return FRM_Ok;
+}
+
+
+Int32 FRM_API FRM_endWrite( Int32 ring, const FRM_FrameInfo* info )
+{
+  if ( !info )
+    return FRM_InvalidParam;
+  std::shared_ptr<Local> l;
+  Int32 r = writer( ring, l );
+  if ( r != FRM_Ok )
+    return r;
+  std::lock_guard<std::mutex> lk( l->m );
+  if ( l->pending == 0 || info->bytes < 0 || info->bytes > l->ring->capacity() )
+    return FRM_InvalidParam;
+  l->ring->end( l->pending, *info );
+  l->pending = 0;
+  return FRM_Ok;
+}
+
+
+Int32 FRM_API FRM_read( Int32 ring,
+                        Int32 timeout,
+                        Bln32 latest,
+                        FRM_FrameInfo* info,
+                        void* data,
+                        Int32 size )
+{
+  if ( timeout < 0 || !info || size < 0 || ( size > 0 && !data ) )
+    return FRM_InvalidParam;
+  std::shared_ptr<Endpoint> e = find( ring );
+  if ( !e )
+    return FRM_NotConnected;
+  std::lock_guard<std::mutex> lk( e->m );
+  return e->read( timeout, latest != 0, info, data, size );
+}
+
+
+Int32 FRM_API FRM_serve( Int32 ring, Int32 port )
+{
+  if ( port < 1 || port > 65535 )
+    return FRM_InvalidParam;
+  std::shared_ptr<Endpoint> e = find( ring );
+  if ( !e )
+    return FRM_NotConnected;
+  std::shared_ptr<Local> l = std::dynamic_pointer_cast<Local>( e );
+  if ( !l )
+    return FRM_InvalidParam;
+  if ( !startSockets() )
+    return FRM_Error;
+
+  Socket s = ::socket( AF_INET, SOCK_STREAM, 0 );
+  if ( s == kNoSocket )
+    return FRM_Error;
+  int one = 1;
+  setsockopt( s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>( &one ), sizeof( one ) );
+  struct sockaddr_in addr;
+  std::memset( &addr, 0, sizeof( addr ) );
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl( INADDR_ANY );
+  addr.sin_port        = htons( uint16_t( port ) );
+  if ( ::bind( s, reinterpret_cast<struct sockaddr*>( &addr ), sizeof( addr ) ) != 0 || ::listen( s, 8 ) != 0 ) {
+    closeSocket( s );
+    return FRM_NotAvailable;
+  }
+  try {
+    std::lock_guard<std::mutex> lk( l->m );
+    l->server.reset( new Server( l->ring, s ) );
+    return FRM_Ok;
+  }
+  catch ( ... ) {
+    closeSocket( s );
+    return FRM_Error;
+  }
+}
@@ -0,0 +1,191 @@
+/******************************************************************/
+/** @file framering.h
+ *  Shared memory frame transport DLL
+ *
+ *  Replaces the DataSocket transfer of Symphony Client.vi / Symphony
+ *  Datasocket test.vi. The acquiring process creates a named ring of
+ *  frame slots in shared memory; readers in other processes attach to
+ *  it by name and receive each frame with its header (dimensions,
+ *  exposure, timestamp) without serialization. Readers are woken by a
+ *  futex on the ring (Linux) as soon as a frame is published.
+ *
+ *  There is one writer per ring. Readers never hold up the writer: a
+ *  reader that falls more than the ring size behind skips the frames
+ *  overwritten meanwhile and is told how many it lost.
+ *
+ *  Readers on other machines connect through TCP to a ring served with
+ *  @ref FRM_serve and use the same read function.
+ */
+/******************************************************************/
+
+#ifndef __FRAMERING_H__
+#define __FRAMERING_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define FRM_API
+#else
+#ifdef  DLL_EXPORT
+#define FRM_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define FRM_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define FRM_Ok                   0              /**< No error                              */
+#define FRM_Error              (-1)             /**< Unspecified error                     */
+#define FRM_NotConnected        -2              /**< Handle does not exist, peer closed    */
+#define FRM_Timeout             -6              /**< No new frame within the timeout       */
+#define FRM_NotAvailable        -7              /**< Ring does not exist or is in use      */
+#define FRM_InvalidParam        -9              /**< Parameter out of range                */
+#define FRM_BufferTooSmall     -10              /**< Frame does not fit, it is skipped     */
+#define FRM_NotWriter          -17              /**< Handle is not the writer of the ring  */
+
+
+/** @brief  Pixel types                                                              */
+typedef enum {
+  FRM_u16 = 0,                               /**< 16 bit unsigned (raw ADC)          */
+  FRM_i32 = 1,                               /**< 32 bit signed                      */
+  FRM_f32 = 2,                               /**< float                              */
+  FRM_f64 = 3                                /**< double                             */
+} FRM_PixelType;
+
+
+/** @brief  Frame header                                                             */
+typedef struct {
+  double exposure;                           /**< Exposure time [s]                  */
+  double timestamp;                          /**< Readout time [s], host clock of
+                                                  timebase.h (TB_now) of the writer's
+                                                  machine, set on publishing if 0;
+                                                  TB_toUTC gives the date        */
+  Int32  frame;                              /**< Frame number, from 1 (output)      */
+  Int32  width;                              /**< Pixels per row                     */
+  Int32  height;                             /**< Rows                               */
+  Int32  pixelType;                          /**< See @ref FRM_PixelType             */
+  Int32  bytes;                              /**< Size of the frame data             */
+  Int32  lost;                               /**< Frames skipped by this reader since
+                                                  its previous read (output)       */
+} FRM_FrameInfo;
+
+
+/** @brief Create a ring as its writer
+ *
+ *  @param  name       Ring name, letters, digits and '_' only
+ *  @param  slots      Number of frame slots, at least 2
+ *  @param  slotBytes  Capacity of each slot [bytes]
+ *  @param  ring       Output: ring handle
+ *  @return            Result of function, @ref FRM_NotAvailable if another
+ *                     writer holds the name
+ */
+Int32 FRM_API FRM_create( const char* name, Int32 slots, Int32 slotBytes, Int32* ring );
+
+
+/** @brief Attach to a ring as a reader
+ *
+ *  The first read returns the first frame published after attaching.
+ *
+ *  @param  name       Ring name
+ *  @param  ring       Output: ring handle
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_attach( const char* name, Int32* ring );
+
+
+/** @brief Connect to a ring served on another machine
+ *
+ *  @param  host       Host name or address
+ *  @param  port       TCP port given to @ref FRM_serve
+ *  @param  ring       Output: ring handle, for reading only
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_connect( const char* host, Int32 port, Int32* ring );
+
+
+/** @brief Close a ring handle
+ *
+ *  Closing the writer removes the name; attached readers can still read
+ *  the frames already in the ring.
+ *
+ *  @param  ring       Ring handle
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_close( Int32 ring );
+
+
+/** @brief Publish a frame
+ *
+ *  @param  ring       Ring handle of the writer
+ *  @param  info       Frame header, info->bytes bytes of data
+ *  @param  data       Frame data
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_write( Int32 ring, const FRM_FrameInfo* info, const void* data );
+
+
+/** @brief Get the slot of the next frame for filling in place
+ *
+ *  For native producers (camera callback, @ref ccdpipe.h) writing
+ *  directly into shared memory. Complete with @ref FRM_endWrite.
+ *
+ *  @param  ring       Ring handle of the writer
+ *  @param  data       Output: address of the slot data
+ *  @param  capacity   Output: slot capacity [bytes]
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_beginWrite( Int32 ring, void** data, Int32* capacity );
+
+
+/** @brief Publish the frame filled in after @ref FRM_beginWrite
+ *
+ *  @param  ring       Ring handle of the writer
+ *  @param  info       Frame header
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_endWrite( Int32 ring, const FRM_FrameInfo* info );
+
+
+/** @brief Read a frame
+ *
+ *  @param  ring       Ring handle
+ *  @param  timeout    Time to wait for a new frame [ms]
+ *  @param  latest     True: skip to the newest frame (display),
+ *                     false: next frame in order
+ *  @param  info       Output: frame header
+ *  @param  data       Output: frame data
+ *  @param  size       Size of the data buffer [bytes]
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_read( Int32 ring,
+                        Int32 timeout,
+                        Bln32 latest,
+                        FRM_FrameInfo* info,
+                        void* data,
+                        Int32 size );
+
+
+/** @brief Serve a ring to remote readers
+ *
+ *  Starts a TCP server; each client is sent every frame in order, or
+ *  skips frames while it is too slow. Stops when the handle is closed.
+ *
+ *  @param  ring       Ring handle (writer or shared memory reader)
+ *  @param  port       TCP port
+ *  @return            Result of function
+ */
+Int32 FRM_API FRM_serve( Int32 ring, Int32 port );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
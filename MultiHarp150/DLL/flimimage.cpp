@@ -0,0 +1,837 @@
+/******************************************************************/
+/** @file flimimage.cpp
+ *  MultiHarp FLIM image builder DLL
+ *
+ *  Implementation of @ref flimimage.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "flimimage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define FLM_SSE2
+#endif
+
+namespace {
+
+typedef unsigned long long UInt64;
+typedef long long          Int64;
+
+const size_t kMaxQueued = size_t( 1 ) << 26;  /**< records queued before FLM_push refuses */
+const size_t kBatch     = size_t( 1 ) << 15;  /**< events handed to a worker at once      */
+const Int32  kMaxPixels = 1 << 24;
+
+/** dst[k] += src[k]                                                       */
+void add( UInt32* dst, const UInt32* src, size_t n )
+{
+  size_t k = 0;
+#ifdef FLM_SSE2
+  for ( ; k + 4 <= n; k += 4 ) {
+    __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( dst + k ) );
+    __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + k ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dst + k ), _mm_add_epi32( a, b ) );
+  }
+#endif
+  for ( ; k < n; ++k )
+    dst[k] += src[k];
+}
+
+
+/** A photon placed in a pixel, dtime relative to dtimeOffset            */
+struct Event {
+  UInt32 pixel;
+  UInt32 dtime;
+};
+
+/** Pixel data of some lines                                              */
+struct Image {
+  std::vector<UInt32> counts;
+  std::vector<UInt64> sums;      /**< sum of the dtimes                  */
+  std::vector<UInt32> hist;      /**< dtime histogram of each pixel     */
+  std::vector<UInt32> touched;   /**< pixels with counts, frames only    */
+
+  void init( size_t pixels, size_t bins )
+  {
+    counts.assign( pixels, 0 );
+    sums.assign( pixels, 0 );
+    hist.assign( pixels * bins, 0 );
+  }
+
+  void zero()
+  {
+    std::fill( counts.begin(), counts.end(), 0 );
+    std::fill( sums.begin(), sums.end(), 0 );
+    std::fill( hist.begin(), hist.end(), 0 );
+    touched.clear();
+  }
+
+  /** Zeroes the touched pixels only; a frame rarely hits all of them     */
+  void zeroTouched( size_t bins )
+  {
+    for ( UInt32 p : touched ) {
+      counts[p] = 0;
+      sums[p]   = 0;
+      std::fill( hist.begin() + p * bins, hist.begin() + ( p + 1 ) * bins, 0 );
+    }
+    touched.clear();
+  }
+};
+
+enum TaskKind { kEvents, kFrame, kClear };
+
+struct Task {
+  TaskKind           kind = kEvents;
+  std::vector<Event> events;
+};
+
+/** Binning thread owning a band of lines                                */
+struct Worker {
+  size_t                  base   = 0;  /**< first pixel of the band      */
+  size_t                  pixels = 0;
+  std::mutex              m;           /**< guards img[FLM_Current]      */
+  Image                   img[3];
+  std::mutex              qm;
+  std::condition_variable qcv;
+  std::deque<Task>        queue;
+  bool                    stop = false;
+  std::thread             thread;
+};
+
+enum InputKind { kRecords, kMarker, kRestart, kOrder };
+
+struct Input {
+  InputKind           kind = kRecords;
+  std::vector<UInt32> data;
+  Int32               markers = 0;
+  double              origin  = 0.;
+};
+
+
+class Builder
+{
+public:
+  explicit Builder( const FLM_Config& c )
+    : cfg( c ), npix( Int64( c.nx ) * c.ny ), bins( c.dtimeBins ),
+      channels( UInt64( UInt32( c.channelMask ) ) | UInt64( UInt32( c.channelMaskHigh ) ) << 32 )
+  {
+    Int32 threads = c.threads;
+    if ( threads < 1 )
+      threads = std::max( 1, Int32( std::thread::hardware_concurrency() ) - 1 );
+    threads         = std::min( threads, c.ny );
+    Int32 rows      = ( c.ny + threads - 1 ) / threads;
+    bandPixels      = size_t( rows ) * c.nx;
+    for ( Int32 row = 0; row < c.ny; row += rows ) {
+      std::unique_ptr<Worker> w( new Worker );
+      w->base   = size_t( row ) * c.nx;
+      w->pixels = size_t( std::min( rows, c.ny - row ) ) * c.nx;
+      for ( Image& i : w->img )
+        i.init( w->pixels, bins );
+      workers.push_back( std::move( w ) );
+    }
+    out.resize( workers.size() );
+    restart( 0. );
+    for ( auto& w : workers ) {
+      Worker* p = w.get();
+      p->thread = std::thread( [this, p] { bin( *p ); } );
+    }
+    decoder = std::thread( [this] { decode(); } );
+  }
+
+  ~Builder()
+  {
+    {
+      std::lock_guard<std::mutex> lk( m );
+      stop = true;
+    }
+    cv.notify_all();
+    decoder.join();
+    for ( auto& w : workers ) {
+      {
+        std::lock_guard<std::mutex> lk( w->qm );
+        w->stop = true;
+      }
+      w->qcv.notify_all();
+      w->thread.join();
+    }
+  }
+
+  const FLM_Config                     cfg;
+  const Int64                          npix;
+  const Int32                          bins;
+  const UInt64                         channels;  /**< bit k = input k + 1, 0 all  */
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::mutex                           frameM;   /**< held while frames are published;
+                                                      guards Last and Total images */
+  std::mutex                           m;        /**< input queue and counters      */
+  std::condition_variable              cv;
+  size_t                               queued = 0;
+  std::atomic<Int32>                   frames{ 0 };
+  std::atomic<Int32>                   line{ -1 };
+  std::atomic<UInt64>                  photons{ 0 };
+  std::atomic<UInt64>                  dropped{ 0 };
+
+  Int32 push( Input&& in )
+  {
+    std::lock_guard<std::mutex> lk( m );
+    size_t n = in.kind == kRecords ? in.data.size() : 0;
+    if ( n && queued && queued + n > kMaxQueued )
+      return FLM_Busy;
+    queued += n;
+    ++outstanding;
+    input.push_back( std::move( in ) );
+    cv.notify_all();
+    return FLM_Ok;
+  }
+
+  bool flush( Int32 timeout )
+  {
+    std::unique_lock<std::mutex> lk( m );
+    auto idle = [this] { return outstanding == 0; };
+    if ( timeout < 0 ) {
+      cv.wait( lk, idle );
+      return true;
+    }
+    return cv.wait_for( lk, std::chrono::milliseconds( timeout ), idle );
+  }
+
+  /** Calls f(worker, image) for all bands with the image locked         */
+  template <class F> void visit( Int32 image, F f )
+  {
+    if ( image == FLM_Current ) {
+      for ( auto& w : workers ) {
+        std::lock_guard<std::mutex> lk( w->m );
+        f( *w, w->img[FLM_Current] );
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> lk( frameM );
+    for ( auto& w : workers )
+      f( *w, w->img[image] );
+  }
+
+private:
+  std::thread        decoder;
+  std::deque<Input>  input;
+  Int32              outstanding = 0;   /**< inputs and tasks not done   */
+  size_t             acks        = 0;   /**< frame and clear tasks done  */
+  bool               stop        = false;
+  size_t             bandPixels  = 0;
+
+  /* decoder state, used by the decoder thread only */
+  std::vector<std::vector<Event>> out;
+  std::vector<Int32>              order;
+  UInt64                          ofl = 0, now = 0;
+  bool                            waitFrame = false;
+  Int64                           point     = -1;   /**< pixel mode: scan point   */
+  Int32                           y         = -1;   /**< line mode: scan line     */
+  bool                            inLine    = false;
+  UInt64                          lineStart = 0;
+  double                          measured  = 0.;   /**< line mode: pixel time    */
+  double                          origin    = 0.;   /**< clock mode: frame start  */
+  Int64                           clockFrame = 0;
+  UInt64                          nPhotons = 0, nDropped = 0;
+
+  void restart( double at )
+  {
+    ofl = now  = 0;
+    waitFrame  = cfg.frameMarker != 0;
+    point      = -1;
+    y          = -1;
+    inLine     = false;
+    measured   = 0.;
+    origin     = at;
+    clockFrame = 0;
+  }
+
+  void send( size_t w, Task&& t )
+  {
+    {
+      std::lock_guard<std::mutex> lk( m );
+      ++outstanding;
+    }
+    Worker& wk = *workers[w];
+    {
+      std::lock_guard<std::mutex> lk( wk.qm );
+      wk.queue.push_back( std::move( t ) );
+    }
+    wk.qcv.notify_one();
+  }
+
+  void sendEvents()
+  {
+    for ( size_t w = 0; w < out.size(); ++w ) {
+      if ( out[w].empty() )
+        continue;
+      Task t;
+      t.events.swap( out[w] );
+      send( w, std::move( t ) );
+    }
+  }
+
+  /** Runs a frame or clear task on all bands and waits for it            */
+  void broadcast( TaskKind kind )
+  {
+    sendEvents();
+    for ( size_t w = 0; w < workers.size(); ++w ) {
+      Task t;
+      t.kind = kind;
+      send( w, std::move( t ) );
+    }
+    std::unique_lock<std::mutex> lk( m );
+    cv.wait( lk, [this] { return acks >= workers.size(); } );
+    acks = 0;
+  }
+
+  /** Publishes the frame in progress, then count - 1 empty frames; one
+   *  publish covers those as they only leave FLM_Last empty              */
+  void endFrame( Int64 count = 1 )
+  {
+    std::lock_guard<std::mutex> lk( frameM );
+    broadcast( kFrame );
+    if ( count > 1 )
+      broadcast( kFrame );
+    frames += Int32( std::min<Int64>( count, INT_MAX - frames ) );
+  }
+
+  void marker( Int32 bits )
+  {
+    const Int32 nx = cfg.nx, ny = cfg.ny;
+    if ( bits & cfg.frameMarker ) {
+      if ( !waitFrame )
+        endFrame();
+      waitFrame  = false;
+      point      = -1;
+      y          = -1;
+      inLine     = false;
+      origin     = double( now );
+      clockFrame = 0;
+    }
+    if ( waitFrame )
+      return;
+    if ( cfg.mode == FLM_modePixel && ( bits & cfg.pixelMarker ) ) {
+      if ( ++point >= npix ) {
+        if ( cfg.frameMarker )
+          point = npix;
+        else {
+          endFrame();
+          point = 0;
+        }
+      }
+    }
+    if ( cfg.mode == FLM_modeLine ) {
+      if ( ( bits & cfg.lineStopMarker ) && inLine ) {
+        if ( !( cfg.pixelTime > 0. ) )
+          measured = double( now - lineStart ) / nx;
+        inLine = false;
+      }
+      if ( bits & cfg.lineMarker ) {
+        inLine    = true;
+        lineStart = now;
+        if ( ++y >= ny ) {
+          if ( cfg.frameMarker ) {
+            y      = ny;
+            inLine = false;
+          }
+          else {
+            endFrame();
+            y = 0;
+          }
+        }
+      }
+    }
+  }
+
+  /** Clock mode scan point at the current time, ending frames it passed */
+  Int64 clockPoint()
+  {
+    double rel = double( now ) - origin;
+    if ( waitFrame || rel < 0. )
+      return -1;
+    Int64 p = Int64( rel / cfg.pixelTime );
+    Int64 f = p / npix;
+    if ( f > clockFrame ) {
+      endFrame( f - clockFrame );
+      clockFrame = f;
+    }
+    return p - f * npix;
+  }
+
+  /** Scan point of a photon at the current time, -1 if outside the scan  */
+  Int64 scanPoint()
+  {
+    switch ( cfg.mode ) {
+    case FLM_modePixel:
+      return !waitFrame && point >= 0 && point < npix ? point : -1;
+    case FLM_modeLine: {
+      double pt = cfg.pixelTime > 0. ? cfg.pixelTime : measured;
+      if ( !inLine || !( pt > 0. ) )
+        return -1;
+      Int64 x = Int64( double( now - lineStart ) / pt );
+      return x < cfg.nx ? Int64( y ) * cfg.nx + x : -1;
+    }
+    default:
+      return clockPoint();
+    }
+  }
+
+  Int64 pixelOf( Int64 s ) const
+  {
+    if ( !order.empty() )
+      return order[size_t( s )];
+    if ( !cfg.bidirectional )
+      return s;
+    Int64 row = s / cfg.nx, x = s - row * cfg.nx;
+    return row & 1 ? row * cfg.nx + cfg.nx - 1 - x : s;
+  }
+
+  void photon( UInt32 channel, UInt32 dtime )
+  {
+    Int64 d = Int64( dtime ) - cfg.dtimeOffset;
+    Int64 s = scanPoint();
+    if ( s < 0 || d < 0 || ( bins && ( d >> cfg.dtimeShift ) >= bins )
+         || ( channels && !( ( channels >> channel ) & 1 ) ) ) {
+      ++nDropped;
+      return;
+    }
+    Int64 p = pixelOf( s );
+    size_t w = size_t( p ) / bandPixels;
+    std::vector<Event>& v = out[w];
+    v.push_back( Event{ UInt32( p ), UInt32( d ) } );
+    ++nPhotons;
+    if ( v.size() >= kBatch ) {
+      Task t;
+      t.events.swap( v );
+      send( w, std::move( t ) );
+      v.reserve( kBatch );
+    }
+  }
+
+  /** MultiHarp T3 records: special bit, 6 bit channel, 15 bit dtime, 10 bit nsync */
+  void records( const std::vector<UInt32>& rec )
+  {
+    for ( UInt32 r : rec ) {
+      UInt32 nsync   = r & 1023;
+      UInt32 channel = ( r >> 25 ) & 63;
+      if ( r >> 31 ) {
+        if ( channel == 63 ) {
+          ofl += nsync ? UInt64( nsync ) * 1024 : 1024;
+          now  = ofl;
+          if ( cfg.mode == FLM_modeClock )
+            clockPoint();
+        }
+        else if ( channel >= 1 && channel <= 15 ) {
+          now = ofl + nsync;
+          marker( Int32( channel ) );
+        }
+        continue;
+      }
+      now = ofl + nsync;
+      photon( channel, ( r >> 10 ) & 0x7FFF );
+    }
+  }
+
+  Int32 currentLine() const
+  {
+    if ( waitFrame )
+      return -1;
+    switch ( cfg.mode ) {
+    case FLM_modePixel:
+      return point >= 0 && point < npix ? Int32( point / cfg.nx ) : -1;
+    case FLM_modeLine:
+      return y < cfg.ny ? y : -1;
+    default: {
+      double rel = double( now ) - origin;
+      return rel < 0. ? -1 : Int32( ( Int64( rel / cfg.pixelTime ) % npix ) / cfg.nx );
+    }
+    }
+  }
+
+  void decode()
+  {
+    for ( ;; ) {
+      Input in;
+      {
+        std::unique_lock<std::mutex> lk( m );
+        cv.wait( lk, [this] { return stop || !input.empty(); } );
+        if ( stop )
+          return;
+        in = std::move( input.front() );
+        input.pop_front();
+        if ( in.kind == kRecords )
+          queued -= in.data.size();
+      }
+      switch ( in.kind ) {
+      case kRecords:
+        records( in.data );
+        break;
+      case kMarker:
+        marker( in.markers );
+        break;
+      case kRestart: {
+        std::lock_guard<std::mutex> lk( frameM );
+        broadcast( kClear );
+        restart( in.origin );
+        frames   = 0;
+        photons  = 0;
+        dropped  = 0;
+        nPhotons = nDropped = 0;
+        break;
+      }
+      case kOrder:
+        order.assign( in.data.begin(), in.data.end() );
+        break;
+      }
+      sendEvents();
+      photons += nPhotons;
+      dropped += nDropped;
+      nPhotons = nDropped = 0;
+      line     = currentLine();
+      std::lock_guard<std::mutex> lk( m );
+      --outstanding;
+      cv.notify_all();
+    }
+  }
+
+  void bin( Worker& w )
+  {
+    const Int32 shift = cfg.dtimeShift;
+    for ( ;; ) {
+      Task t;
+      {
+        std::unique_lock<std::mutex> lk( w.qm );
+        w.qcv.wait( lk, [&w] { return w.stop || !w.queue.empty(); } );
+        if ( w.stop )
+          return;
+        t = std::move( w.queue.front() );
+        w.queue.pop_front();
+      }
+      {
+        std::lock_guard<std::mutex> lk( w.m );
+        Image& cur = w.img[FLM_Current];
+        if ( t.kind == kEvents ) {
+          UInt32* c = cur.counts.data();
+          UInt64* s = cur.sums.data();
+          UInt32* h = cur.hist.data();
+          for ( const Event& e : t.events ) {
+            size_t p = e.pixel - w.base;
+            if ( !c[p]++ )
+              cur.touched.push_back( UInt32( p ) );
+            s[p] += e.dtime;
+            if ( bins )
+              ++h[p * bins + ( e.dtime >> shift )];
+          }
+        }
+        else if ( t.kind == kFrame ) {
+          /* called with frameM held by the decoder */
+          Image& last  = w.img[FLM_Last];
+          Image& total = w.img[FLM_Total];
+          for ( UInt32 p : cur.touched ) {
+            total.counts[p] += cur.counts[p];
+            total.sums[p]   += cur.sums[p];
+            if ( bins )
+              add( total.hist.data() + p * size_t( bins ), cur.hist.data() + p * size_t( bins ), bins );
+          }
+          std::swap( last, cur );
+          cur.zeroTouched( bins );
+        }
+        else {
+          for ( Image& i : w.img )
+            i.zero();
+        }
+      }
+      std::lock_guard<std::mutex> lk( m );
+      --outstanding;
+      if ( t.kind != kEvents )
+        ++acks;
+      cv.notify_all();
+    }
+  }
+};
+
+
+struct Registry {
+  std::mutex                                m;
+  Int32                                     nextId = 1;
+  std::map<Int32, std::shared_ptr<Builder>> builders;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Builder> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.builders.find( handle );
+  return it == reg.builders.end() ? std::shared_ptr<Builder>() : it->second;
+}
+
+bool validMarker( Int32 bits ) { return bits >= 0 && bits <= 15; }
+
+bool valid( const FLM_Config& c )
+{
+  if ( c.nx < 1 || c.ny < 1 || Int64( c.nx ) * c.ny > kMaxPixels )
+    return false;
+  if ( !validMarker( c.pixelMarker ) || !validMarker( c.lineMarker )
+       || !validMarker( c.lineStopMarker ) || !validMarker( c.frameMarker ) )
+    return false;
+  if ( c.dtimeOffset < 0 || c.dtimeShift < 0 || c.dtimeShift > 15 || c.dtimeBins < 0
+       || c.dtimeBins > 32768 || c.threads < 0 || c.resolution < 0. )
+    return false;
+  switch ( c.mode ) {
+  case FLM_modePixel: return c.pixelMarker != 0;
+  case FLM_modeLine:  return c.lineMarker != 0 && ( c.pixelTime > 0. || c.lineStopMarker != 0 );
+  case FLM_modeClock: return c.pixelTime > 0.;
+  default:            return false;
+  }
+}
+
+} // namespace
+
+
+Int32 FLM_API FLM_create( const FLM_Config* config, Int32* img )
+{
+  if ( !config || !img || !valid( *config ) )
+    return FLM_InvalidParam;
+  try {
+    std::shared_ptr<Builder> b = std::make_shared<Builder>( *config );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *img = reg.nextId++;
+    reg.builders[*img] = b;
+    return FLM_Ok;
+  }
+  catch ( ... ) {
+    return FLM_Error;
+  }
+}
+
+
+Int32 FLM_API FLM_close( Int32 img )
+{
+  std::shared_ptr<Builder> b;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.builders.find( img );
+    if ( it == reg.builders.end() )
+      return FLM_NotConnected;
+    b = it->second;
+    reg.builders.erase( it );
+  }
+  return FLM_Ok;
+}
+
+
+Int32 FLM_API FLM_setOrder( Int32 img, const Int32* index, Int32 count )
+{
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  Input in;
+  in.kind = kOrder;
+  if ( index ) {
+    if ( count != b->npix )
+      return FLM_InvalidParam;
+    for ( Int32 k = 0; k < count; ++k )
+      if ( index[k] < 0 || index[k] >= b->npix )
+        return FLM_InvalidParam;
+    try {
+      in.data.assign( index, index + count );
+    }
+    catch ( ... ) {
+      return FLM_Error;
+    }
+  }
+  return b->push( std::move( in ) );
+}
+
+
+Int32 FLM_API FLM_push( Int32 img, const UInt32* records, Int32 count )
+{
+  if ( count < 0 || ( count && !records ) )
+    return FLM_InvalidParam;
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  if ( !count )
+    return FLM_Ok;
+  Input in;
+  try {
+    in.data.assign( records, records + count );
+  }
+  catch ( ... ) {
+    return FLM_Error;
+  }
+  return b->push( std::move( in ) );
+}
+
+
+Int32 FLM_API FLM_marker( Int32 img, Int32 markers )
+{
+  if ( markers < 1 || markers > 15 )
+    return FLM_InvalidParam;
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  Input in;
+  in.kind    = kMarker;
+  in.markers = markers;
+  return b->push( std::move( in ) );
+}
+
+
+Int32 FLM_API FLM_clear( Int32 img, double origin )
+{
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  Input in;
+  in.kind   = kRestart;
+  in.origin = origin;
+  return b->push( std::move( in ) );
+}
+
+
+Int32 FLM_API FLM_flush( Int32 img, Int32 timeout )
+{
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  return b->flush( timeout ) ? FLM_Ok : FLM_Timeout;
+}
+
+
+Int32 FLM_API FLM_status( Int32 img,
+                          Int32* frames,
+                          Int32* line,
+                          double* photons,
+                          double* dropped,
+                          double* queued )
+{
+  if ( !frames || !line )
+    return FLM_InvalidParam;
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  *frames = b->frames;
+  *line   = b->line;
+  if ( photons )
+    *photons = double( b->photons );
+  if ( dropped )
+    *dropped = double( b->dropped );
+  if ( queued ) {
+    std::lock_guard<std::mutex> lk( b->m );
+    *queued = double( b->queued );
+  }
+  return FLM_Ok;
+}
+
+
+Int32 FLM_API FLM_intensity( Int32 img, Int32 image, UInt32* counts, Int32 size )
+{
+  if ( !counts || image < FLM_Current || image > FLM_Total )
+    return FLM_InvalidParam;
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  if ( size < b->npix )
+    return FLM_BufferTooSmall;
+  b->visit( image, [&]( const Worker& w, const Image& i ) {
+    std::copy( i.counts.begin(), i.counts.end(), counts + w.base );
+  } );
+  return FLM_Ok;
+}
+
+
+Int32 FLM_API FLM_meanTime( Int32 img, Int32 image, double* tau, Int32 size )
+{
+  if ( !tau || image < FLM_Current || image > FLM_Total )
+    return FLM_InvalidParam;
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  if ( size < b->npix )
+    return FLM_BufferTooSmall;
+  const double unit   = b->cfg.resolution > 0. ? b->cfg.resolution * 1e-3 : 1.;
+  const double offset = b->cfg.dtimeOffset;
+  const double nan    = std::numeric_limits<double>::quiet_NaN();
+  b->visit( image, [&]( const Worker& w, const Image& i ) {
+    double* t = tau + w.base;
+    for ( size_t p = 0; p < w.pixels; ++p )
+      t[p] = i.counts[p] ? ( offset + double( i.sums[p] ) / i.counts[p] ) * unit : nan;
+  } );
+  return FLM_Ok;
+}
+
+
+Int32 FLM_API FLM_histogram( Int32 img,
+                             Int32 image,
+                             Int32 first,
+                             Int32 lines,
+                             UInt32* hist,
+                             Int32 size )
+{
+  if ( !hist || image < FLM_Current || image > FLM_Total || first < 0 || lines < 0 )
+    return FLM_InvalidParam;
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  const size_t nx = size_t( b->cfg.nx ), bins = size_t( b->bins );
+  if ( !bins || first + Int64( lines ) > b->cfg.ny )
+    return FLM_InvalidParam;
+  if ( Int64( size ) < Int64( lines ) * Int64( nx * bins ) )
+    return FLM_BufferTooSmall;
+  const size_t p0 = size_t( first ) * nx, p1 = p0 + size_t( lines ) * nx;
+  b->visit( image, [&]( const Worker& w, const Image& i ) {
+    size_t a = std::max( p0, w.base ), e = std::min( p1, w.base + w.pixels );
+    if ( a < e )
+      std::copy( i.hist.begin() + ( a - w.base ) * bins, i.hist.begin() + ( e - w.base ) * bins,
+                 hist + ( a - p0 ) * bins );
+  } );
+  return FLM_Ok;
+}
+
+
+Int32 FLM_API FLM_decay( Int32 img, Int32 image, const unsigned char* mask, double* decay )
+{
+  if ( !decay || image < FLM_Current || image > FLM_Total )
+    return FLM_InvalidParam;
+  std::shared_ptr<Builder> b = find( img );
+  if ( !b )
+    return FLM_NotConnected;
+  const size_t bins = size_t( b->bins );
+  if ( !bins )
+    return FLM_InvalidParam;
+  std::vector<UInt64> sum( bins, 0 );
+  b->visit( image, [&]( const Worker& w, const Image& i ) {
+    for ( size_t p = 0; p < w.pixels; ++p ) {
+      if ( ( mask && !mask[w.base + p] ) || !i.counts[p] )
+        continue;
+      const UInt32* h = i.hist.data() + p * bins;
+      for ( size_t k = 0; k < bins; ++k )
+        sum[k] += h[k];
+    }
+  } );
+  for ( size_t k = 0; k < bins; ++k )
+    decay[k] = double( sum[k] );
+  return FLM_Ok;
+}
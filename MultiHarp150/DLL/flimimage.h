@@ -0,0 +1,261 @@
+/******************************************************************/
+/** @file flimimage.h
+ *  MultiHarp FLIM image builder DLL
+ *
+ *  Builds fluorescence lifetime images while a scan runs, from the T3
+ *  records read with MH_ReadFiFo, instead of assembling them after the
+ *  measurement from ProcessTTRecMHT3.vi output. Every photon is placed
+ *  in a pixel from the marker records of the same stream:
+ *    - pixel mode: each pixel marker starts the next scan point, as
+ *      given by a step scan (AMC positioner moves triggering a marker)
+ *    - line mode: each line marker starts a line whose pixels follow in
+ *      time; the pixel time is fixed or measured from line stop markers
+ *    - clock mode: no markers, the pixels follow a fixed pixel time
+ *      (synthetic pattern); a frame marker restarts the clock
+ *  Markers may also be inserted by the caller with @ref FLM_marker, e.g.
+ *  after each AMC move when the positioner gives no hardware trigger.
+ *  Scan points are mapped to pixels in serpentine or raster order, or
+ *  through a table such as one of @ref scanpattern.h.
+ *
+ *  For each pixel the counts, the mean arrival time and, optionally, a
+ *  histogram of the arrival times are kept for the frame in progress,
+ *  the last complete frame and the sum of all frames. Records are queued
+ *  by @ref FLM_push and decoded by a background thread; the image lines
+ *  are split between worker threads that bin the photons in parallel.
+ */
+/******************************************************************/
+
+#ifndef __FLIMIMAGE_H__
+#define __FLIMIMAGE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define FLM_API
+#else
+#ifdef  DLL_EXPORT
+#define FLM_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define FLM_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int          Bln32;                     /**< Boolean compatible to older C      */
+typedef int          Int32;                     /**< Basic type                         */
+typedef unsigned int UInt32;                    /**< T3 records and counts              */
+
+/** Return values of functions */
+#define FLM_Ok                   0              /**< No error                              */
+#define FLM_Error              (-1)             /**< Unspecified error                     */
+#define FLM_NotConnected        -2              /**< Handle does not exist                 */
+#define FLM_Timeout             -6              /**< Queue not processed in time           */
+#define FLM_InvalidParam        -9              /**< Parameter out of range                */
+#define FLM_BufferTooSmall     -10              /**< Output array too small                */
+#define FLM_Busy               -16              /**< Queue full, push again later          */
+
+
+/** @brief  Assignment of photons to scan points                                     */
+typedef enum {
+  FLM_modePixel = 0,                         /**< Pixel markers start scan points    */
+  FLM_modeLine  = 1,                         /**< Line markers and pixel time        */
+  FLM_modeClock = 2                          /**< Pixel time only                    */
+} FLM_Mode;
+
+
+/** @brief  Images held by the builder                                               */
+typedef enum {
+  FLM_Current = 0,                           /**< Frame in progress                  */
+  FLM_Last    = 1,                           /**< Last complete frame                */
+  FLM_Total   = 2                            /**< Sum of all complete frames         */
+} FLM_Image;
+
+
+/** @brief  Image builder settings
+ *
+ *  Markers are given as bit masks of the marker inputs (marker 1 = 1,
+ *  marker 2 = 2, marker 3 = 4, marker 4 = 8), 0 if not used. Without a
+ *  frame marker a frame ends after nx * ny scan points. Times are in
+ *  sync periods. Memory: 3 * nx * ny * (12 + 4 * dtimeBins) bytes.
+ */
+typedef struct {
+  Int32  nx;                                 /**< Pixels per line                    */
+  Int32  ny;                                 /**< Lines per frame                    */
+  Int32  mode;                               /**< See @ref FLM_Mode                  */
+  Int32  pixelMarker;                        /**< Pixel mode: scan point start       */
+  Int32  lineMarker;                         /**< Line mode: line start              */
+  Int32  lineStopMarker;                     /**< Line mode: line end (optional)     */
+  Int32  frameMarker;                        /**< Frame start (optional)             */
+  double pixelTime;                          /**< Line and clock mode: pixel dwell;
+                                                  in line mode 0 measures it from the
+                                                  line stop marker of the previous line */
+  Bln32  bidirectional;                      /**< Odd lines run backwards            */
+  Int32  channelMask;                        /**< Inputs 1..32 used (bit 0 = input 1) */
+  Int32  channelMaskHigh;                    /**< Inputs 33..64 used (bit 0 = input 33);
+                                                  both masks 0 uses all inputs     */
+  Int32  dtimeOffset;                        /**< First dtime used                   */
+  Int32  dtimeShift;                         /**< Histogram bin = dtime >> shift     */
+  Int32  dtimeBins;                          /**< Histogram bins, 0 for none; photons
+                                                  beyond the histogram are dropped   */
+  double resolution;                         /**< dtime unit [ps] (MH_GetResolution),
+                                                  0 gives mean times in dtime units  */
+  Int32  threads;                            /**< Binning threads, 0 for automatic   */
+} FLM_Config;
+
+
+/** @brief Create an image builder
+ *
+ *  @param  config    Settings
+ *  @param  img       Output: builder handle
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_create( const FLM_Config* config, Int32* img );
+
+
+/** @brief Release a builder, dropping queued records
+ *
+ *  @param  img       Builder handle
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_close( Int32 img );
+
+
+/** @brief Map scan points to pixels
+ *
+ *  Scan point k (the k-th pixel marker of a frame in pixel mode, else
+ *  line * nx + pixel in the line) goes to pixel index[k] = y * nx + x,
+ *  e.g. x = round((x_k - x0) / dx) of a SCAN_generate table. The
+ *  bidirectional setting is then not used. Applies to records pushed
+ *  from now on.
+ *
+ *  @param  img       Builder handle
+ *  @param  index     Pixel of each scan point, NULL for the default order
+ *  @param  count     Number of elements of index, nx * ny
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_setOrder( Int32 img, const Int32* index, Int32 count );
+
+
+/** @brief Queue T3 records
+ *
+ *  The records are copied; the call returns without waiting for them.
+ *
+ *  @param  img       Builder handle
+ *  @param  records   Records as read by MH_ReadFiFo
+ *  @param  count     Number of records
+ *  @return           Result of function, @ref FLM_Busy if too many records
+ *                    are still queued (nothing was taken)
+ */
+Int32 FLM_API FLM_push( Int32 img, const UInt32* records, Int32 count );
+
+
+/** @brief Insert a marker after the records pushed so far
+ *
+ *  The marker takes the time of the last record before it.
+ *
+ *  @param  img       Builder handle
+ *  @param  markers   Marker bit mask
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_marker( Int32 img, Int32 markers );
+
+
+/** @brief Restart: clear all images and begin at the first scan point
+ *
+ *  Call with MH_StartMeas; applies to records pushed from now on.
+ *
+ *  @param  img       Builder handle
+ *  @param  origin    Sync count at which clock mode starts, usually 0
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_clear( Int32 img, double origin );
+
+
+/** @brief Wait until all queued records are binned
+ *
+ *  @param  img       Builder handle
+ *  @param  timeout   Maximum waiting time [ms], < 0 waits forever
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_flush( Int32 img, Int32 timeout );
+
+
+/** @brief Progress of the scan
+ *
+ *  @param  img       Builder handle
+ *  @param  frames    Output: complete frames since @ref FLM_clear
+ *  @param  line      Output: scan line in progress, -1 between frames
+ *  @param  photons   Output: photons binned (may be NULL)
+ *  @param  dropped   Output: photons outside the scan, gate or channels (may be NULL)
+ *  @param  queued    Output: records waiting to be decoded (may be NULL)
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_status( Int32 img,
+                          Int32* frames,
+                          Int32* line,
+                          double* photons,
+                          double* dropped,
+                          double* queued );
+
+
+/** @brief Counts per pixel
+ *
+ *  @param  img       Builder handle
+ *  @param  image     See @ref FLM_Image
+ *  @param  counts    Output: nx * ny counts, line by line
+ *  @param  size      Number of elements of counts
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_intensity( Int32 img, Int32 image, UInt32* counts, Int32 size );
+
+
+/** @brief Mean arrival time per pixel
+ *
+ *  @param  img       Builder handle
+ *  @param  image     See @ref FLM_Image
+ *  @param  tau       Output: nx * ny times [ns], NaN for pixels without counts
+ *  @param  size      Number of elements of tau
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_meanTime( Int32 img, Int32 image, double* tau, Int32 size );
+
+
+/** @brief Arrival time histograms of some lines
+ *
+ *  @param  img       Builder handle
+ *  @param  image     See @ref FLM_Image
+ *  @param  first     First line
+ *  @param  lines     Number of lines
+ *  @param  hist      Output: lines * nx * dtimeBins counts, the histogram
+ *                    of each pixel in turn
+ *  @param  size      Number of elements of hist
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_histogram( Int32 img,
+                             Int32 image,
+                             Int32 first,
+                             Int32 lines,
+                             UInt32* hist,
+                             Int32 size );
+
+
+/** @brief Arrival time histogram summed over a region
+ *
+ *  @param  img       Builder handle
+ *  @param  image     See @ref FLM_Image
+ *  @param  mask      nx * ny bytes, non-zero for pixels of the region,
+ *                    NULL for the whole image
+ *  @param  decay     Output: dtimeBins counts
+ *  @return           Result of function
+ */
+Int32 FLM_API FLM_decay( Int32 img, Int32 image, const unsigned char* mask, double* decay );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,362 @@
+/******************************************************************/
+/** @file mhhist.cpp
+ *  MultiHarp histogram accumulator DLL
+ *
+ *  Implementation of @ref mhhist.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "mhhist.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const Int32 kLevels = 3;                 /**< pyramid levels above the bins  */
+const Int32 kFan    = 16;                /**< bins per block, per level      */
+
+/** Bin values with a min/max pyramid and summary                        */
+class Trace
+{
+public:
+  explicit Trace( Int32 bins ) : v( bins, 0. ), counts_( 0. ), peakBin_( 0 )
+  {
+    Int32 n = bins;
+    for ( Int32 l = 0; l < kLevels; ++l ) {
+      n = ( n + kFan - 1 ) / kFan;
+      min_[l].assign( n, 0. );
+      max_[l].assign( n, 0. );
+    }
+  }
+
+  std::vector<double> v;
+
+  /** Rebuilds pyramid, sum and peak after v has changed                  */
+  void build()
+  {
+    const Int32 bins = Int32( v.size() );
+    double sum = 0., top = v[0];
+    Int32  at  = 0;
+    for ( Int32 b0 = 0, k = 0; b0 < bins; b0 += kFan, ++k ) {
+      Int32  b1 = std::min( b0 + kFan, bins );
+      double lo = v[b0], hi = v[b0];
+      for ( Int32 b = b0; b < b1; ++b ) {
+        lo   = std::min( lo, v[b] );
+        hi   = std::max( hi, v[b] );
+        sum += v[b];
+      }
+      min_[0][k] = lo;
+      max_[0][k] = hi;
+      if ( hi > top ) {
+        top = hi;
+        at  = b0;
+      }
+    }
+    for ( Int32 l = 1; l < kLevels; ++l )
+      for ( size_t k = 0; k < min_[l].size(); ++k ) {
+        size_t c0 = k * kFan, c1 = std::min( c0 + kFan, min_[l - 1].size() );
+        min_[l][k] = *std::min_element( &min_[l - 1][c0], &min_[l - 1][0] + c1 );
+        max_[l][k] = *std::max_element( &max_[l - 1][c0], &max_[l - 1][0] + c1 );
+      }
+    while ( v[at] != top )
+      ++at;
+    counts_  = sum;
+    peakBin_ = at;
+  }
+
+  /** Min and max of bins [a, b), using the largest aligned blocks        */
+  void range( Int32 a, Int32 b, double& lo, double& hi ) const
+  {
+    lo = hi = v[a];
+    while ( a < b ) {
+      Int32 l = -1, span = 1;
+      while ( l + 1 < kLevels && a % ( span * kFan ) == 0 && a + span * kFan <= b ) {
+        ++l;
+        span *= kFan;
+      }
+      if ( l < 0 ) {
+        lo = std::min( lo, v[a] );
+        hi = std::max( hi, v[a] );
+      }
+      else {
+        lo = std::min( lo, min_[l][a / span] );
+        hi = std::max( hi, max_[l][a / span] );
+      }
+      a += span;
+    }
+  }
+
+  double counts() const { return counts_; }
+  Int32  peakBin() const { return peakBin_; }
+
+  /** Width at half the peak, linear between the bins crossing it         */
+  double fwhm() const
+  {
+    const Int32 bins = Int32( v.size() );
+    double      half = v[peakBin_] / 2.;
+    if ( !( half > 0. ) )
+      return 0.;
+    Int32 l = peakBin_, r = peakBin_;
+    while ( l > 0 && v[l - 1] >= half )
+      --l;
+    while ( r + 1 < bins && v[r + 1] >= half )
+      ++r;
+    double left  = l > 0 ? l - ( v[l] - half ) / ( v[l] - v[l - 1] ) : l;
+    double right = r + 1 < bins ? r + ( v[r] - half ) / ( v[r] - v[r + 1] ) : r;
+    return right - left;
+  }
+
+private:
+  std::vector<double> min_[kLevels], max_[kLevels];
+  double              counts_;
+  Int32               peakBin_;
+};
+
+
+class Channel
+{
+public:
+  explicit Channel( Int32 bins )
+    : trace{ Trace( bins ), Trace( bins ), Trace( bins ) }, base_( bins, 0. ), last_( bins, 0 ) {}
+
+  Trace trace[3];   /**< indexed by MHH_Trace */
+
+  void update( const UInt32* h )
+  {
+    const size_t bins = last_.size();
+    bool restarted = false;
+    for ( size_t b = 0; b < bins; ++b )
+      restarted |= h[b] < last_[b];
+    if ( restarted )
+      fold();
+
+    double* total = trace[MHH_Total].v.data();
+    double* cur   = trace[MHH_Current].v.data();
+    double* delta = trace[MHH_Delta].v.data();
+    for ( size_t b = 0; b < bins; ++b ) {
+      delta[b] = double( h[b] - last_[b] );
+      cur[b]   = double( h[b] );
+      total[b] = base_[b] + cur[b];
+      last_[b] = h[b];
+    }
+    for ( Trace& t : trace )
+      t.build();
+  }
+
+  /** Adds the running measurement to the base and restarts it           */
+  void fold()
+  {
+    for ( size_t b = 0; b < last_.size(); ++b ) {
+      base_[b] += last_[b];
+      last_[b]  = 0;
+    }
+    std::fill( trace[MHH_Current].v.begin(), trace[MHH_Current].v.end(), 0. );
+    trace[MHH_Current].build();
+  }
+
+  void clear()
+  {
+    std::fill( base_.begin(), base_.end(), 0. );
+    std::fill( last_.begin(), last_.end(), 0 );
+    for ( Trace& t : trace ) {
+      std::fill( t.v.begin(), t.v.end(), 0. );
+      t.build();
+    }
+  }
+
+private:
+  std::vector<double> base_;     /**< total of the finished measurements */
+  std::vector<UInt32> last_;     /**< previous histogram of the running one */
+};
+
+
+class Accumulator
+{
+public:
+  Accumulator( Int32 channels, Int32 binCount ) : bins( binCount )
+  {
+    for ( Int32 c = 0; c < channels; ++c )
+      ch.push_back( std::unique_ptr<Channel>( new Channel( binCount ) ) );
+  }
+
+  std::mutex                            m;
+  const Int32                           bins;
+  std::vector<std::unique_ptr<Channel>> ch;
+};
+
+
+struct Registry {
+  std::mutex                                    m;
+  Int32                                         nextId = 1;
+  std::map<Int32, std::shared_ptr<Accumulator>> accs;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Accumulator> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.accs.find( handle );
+  return it == reg.accs.end() ? std::shared_ptr<Accumulator>() : it->second;
+}
+
+/** Accumulator if channel, trace and bin range are valid                */
+Int32 lookup( Int32 handle, Int32 channel, Int32 trace, Int32 first, Int32 count,
+              std::shared_ptr<Accumulator>& a )
+{
+  a = find( handle );
+  if ( !a )
+    return MHH_NotConnected;
+  if ( channel < 0 || channel >= Int32( a->ch.size() ) || trace < MHH_Total || trace > MHH_Delta
+       || first < 0 || count < 1 || count > a->bins - first )
+    return MHH_InvalidParam;
+  return MHH_Ok;
+}
+
+} // namespace
+
+
+Int32 MHH_API MHH_create( Int32 channels, Int32 bins, Int32* acc )
+{
+  if ( channels < 1 || bins < 1 || !acc )
+    return MHH_InvalidParam;
+  try {
+    std::shared_ptr<Accumulator> a = std::make_shared<Accumulator>( channels, bins );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *acc = reg.nextId++;
+    reg.accs[*acc] = a;
+    return MHH_Ok;
+  }
+  catch ( ... ) {
+    return MHH_Error;
+  }
+}
+
+
+Int32 MHH_API MHH_close( Int32 acc )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.accs.erase( acc ) ? MHH_Ok : MHH_NotConnected;
+}
+
+
+Int32 MHH_API MHH_clear( Int32 acc )
+{
+  std::shared_ptr<Accumulator> a = find( acc );
+  if ( !a )
+    return MHH_NotConnected;
+  std::lock_guard<std::mutex> lk( a->m );
+  for ( auto& c : a->ch )
+    c->clear();
+  return MHH_Ok;
+}
+
+
+Int32 MHH_API MHH_update( Int32 acc, Int32 channel, const UInt32* histogram )
+{
+  if ( !histogram )
+    return MHH_InvalidParam;
+  std::shared_ptr<Accumulator> a;
+  Int32 r = lookup( acc, channel, MHH_Total, 0, 1, a );
+  if ( r != MHH_Ok )
+    return r;
+  std::lock_guard<std::mutex> lk( a->m );
+  a->ch[channel]->update( histogram );
+  return MHH_Ok;
+}
+
+
+Int32 MHH_API MHH_newMeasurement( Int32 acc )
+{
+  std::shared_ptr<Accumulator> a = find( acc );
+  if ( !a )
+    return MHH_NotConnected;
+  std::lock_guard<std::mutex> lk( a->m );
+  for ( auto& c : a->ch )
+    c->fold();
+  return MHH_Ok;
+}
+
+
+Int32 MHH_API MHH_decimate( Int32 acc,
+                            Int32 channel,
+                            Int32 trace,
+                            Int32 first,
+                            Int32 count,
+                            Int32 pixels,
+                            double* min,
+                            double* max )
+{
+  if ( pixels < 1 || !min || !max )
+    return MHH_InvalidParam;
+  std::shared_ptr<Accumulator> a;
+  Int32 r = lookup( acc, channel, trace, first, count, a );
+  if ( r != MHH_Ok )
+    return r;
+  std::lock_guard<std::mutex> lk( a->m );
+  const Trace& t = a->ch[channel]->trace[trace];
+  for ( Int32 p = 0; p < pixels; ++p ) {
+    Int32 b0 = first + Int32( ( long long )count * p / pixels );
+    Int32 b1 = first + Int32( ( long long )count * ( p + 1 ) / pixels );
+    t.range( b0, std::max( b1, b0 + 1 ), min[p], max[p] );
+  }
+  return MHH_Ok;
+}
+
+
+Int32 MHH_API MHH_read( Int32 acc,
+                        Int32 channel,
+                        Int32 trace,
+                        Int32 first,
+                        Int32 count,
+                        double* values )
+{
+  if ( !values )
+    return MHH_InvalidParam;
+  std::shared_ptr<Accumulator> a;
+  Int32 r = lookup( acc, channel, trace, first, count, a );
+  if ( r != MHH_Ok )
+    return r;
+  std::lock_guard<std::mutex> lk( a->m );
+  const std::vector<double>& v = a->ch[channel]->trace[trace].v;
+  std::copy( v.begin() + first, v.begin() + first + count, values );
+  return MHH_Ok;
+}
+
+
+Int32 MHH_API MHH_stats( Int32 acc,
+                         Int32 channel,
+                         Int32 trace,
+                         double* counts,
+                         Int32* peakBin,
+                         double* peak,
+                         double* fwhm )
+{
+  std::shared_ptr<Accumulator> a;
+  Int32 r = lookup( acc, channel, trace, 0, 1, a );
+  if ( r != MHH_Ok )
+    return r;
+  std::lock_guard<std::mutex> lk( a->m );
+  const Trace& t = a->ch[channel]->trace[trace];
+  if ( counts )
+    *counts = t.counts();
+  if ( peakBin )
+    *peakBin = t.peakBin();
+  if ( peak )
+    *peak = t.v[t.peakBin()];
+  if ( fwhm )
+    *fwhm = t.fwhm();
+  return MHH_Ok;
+}
@@ -0,0 +1,173 @@
+/******************************************************************/
+/** @file mhhist.h
+ *  MultiHarp histogram accumulator DLL
+ *
+ *  Keeps the histograms read with MH_GetHistogram for all channels and
+ *  prepares them for display, so that MH_HistGraph.vi / MH_LoadHistGraph.vi
+ *  redraw only as many points as the graph is wide. For every channel
+ *  three traces are held:
+ *    - total: sum over all measurements since @ref MHH_clear
+ *    - current: the running measurement
+ *    - delta: counts added since the previous update
+ *  Each update also refreshes a min/max pyramid over blocks of 16, 256
+ *  and 4096 bins, from which decimated min/max traces are cut in time
+ *  proportional to the pixel width.
+ */
+/******************************************************************/
+
+#ifndef __MHHIST_H__
+#define __MHHIST_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define MHH_API
+#else
+#ifdef  DLL_EXPORT
+#define MHH_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define MHH_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int          Bln32;                     /**< Boolean compatible to older C      */
+typedef int          Int32;                     /**< Basic type                         */
+typedef unsigned int UInt32;                    /**< Histogram counts of MH_GetHistogram */
+
+/** Return values of functions */
+#define MHH_Ok                   0              /**< No error                              */
+#define MHH_Error              (-1)             /**< Unspecified error                     */
+#define MHH_NotConnected        -2              /**< Handle does not exist                 */
+#define MHH_InvalidParam        -9              /**< Parameter out of range                */
+
+
+/** @brief  Traces of a channel                                                      */
+typedef enum {
+  MHH_Total   = 0,                           /**< All measurements                   */
+  MHH_Current = 1,                           /**< Running measurement                */
+  MHH_Delta   = 2                            /**< Since the previous update          */
+} MHH_Trace;
+
+
+/** @brief Create an accumulator
+ *
+ *  @param  channels  Number of input channels
+ *  @param  bins      Histogram length (MH_SetHistoLen)
+ *  @param  acc       Output: accumulator handle
+ *  @return           Result of function
+ */
+Int32 MHH_API MHH_create( Int32 channels, Int32 bins, Int32* acc );
+
+
+/** @brief Release an accumulator
+ *
+ *  @param  acc       Accumulator handle
+ *  @return           Result of function
+ */
+Int32 MHH_API MHH_close( Int32 acc );
+
+
+/** @brief Forget all counts
+ *
+ *  @param  acc       Accumulator handle
+ *  @return           Result of function
+ */
+Int32 MHH_API MHH_clear( Int32 acc );
+
+
+/** @brief Take a new histogram of the running measurement
+ *
+ *  A histogram with fewer counts in any bin than the previous one is
+ *  taken as the start of a new measurement.
+ *
+ *  @param  acc        Accumulator handle
+ *  @param  channel    Channel index
+ *  @param  histogram  bins counts as returned by MH_GetHistogram
+ *  @return            Result of function
+ */
+Int32 MHH_API MHH_update( Int32 acc, Int32 channel, const UInt32* histogram );
+
+
+/** @brief Start a new measurement
+ *
+ *  Call together with MH_ClearHistMem: the running measurement of all
+ *  channels is added to the total and restarts from zero.
+ *
+ *  @param  acc       Accumulator handle
+ *  @return           Result of function
+ */
+Int32 MHH_API MHH_newMeasurement( Int32 acc );
+
+
+/** @brief Min/max decimated trace
+ *
+ *  Bins first .. first + count - 1 are split into pixels columns; each
+ *  column gets the smallest and largest bin value it covers.
+ *
+ *  @param  acc       Accumulator handle
+ *  @param  channel   Channel index
+ *  @param  trace     Trace, see @ref MHH_Trace
+ *  @param  first     First bin
+ *  @param  count     Number of bins
+ *  @param  pixels    Number of columns (graph width)
+ *  @param  min       Output: pixels minima
+ *  @param  max       Output: pixels maxima
+ *  @return           Result of function
+ */
+Int32 MHH_API MHH_decimate( Int32 acc,
+                            Int32 channel,
+                            Int32 trace,
+                            Int32 first,
+                            Int32 count,
+                            Int32 pixels,
+                            double* min,
+                            double* max );
+
+
+/** @brief Bin values of a trace
+ *
+ *  @param  acc       Accumulator handle
+ *  @param  channel   Channel index
+ *  @param  trace     Trace, see @ref MHH_Trace
+ *  @param  first     First bin
+ *  @param  count     Number of bins
+ *  @param  values    Output: count values
+ *  @return           Result of function
+ */
+Int32 MHH_API MHH_read( Int32 acc,
+                        Int32 channel,
+                        Int32 trace,
+                        Int32 first,
+                        Int32 count,
+                        double* values );
+
+
+/** @brief Summary of a trace, as MH_ChSumm.vi
+ *
+ *  @param  acc       Accumulator handle
+ *  @param  channel   Channel index
+ *  @param  trace     Trace, see @ref MHH_Trace
+ *  @param  counts    Output: sum of all bins
+ *  @param  peakBin   Output: bin of the maximum
+ *  @param  peak      Output: maximum
+ *  @param  fwhm      Output: full width at half maximum [bins], interpolated
+ *  @return           Result of function
+ */
+Int32 MHH_API MHH_stats( Int32 acc,
+                         Int32 channel,
+                         Int32 trace,
+                         double* counts,
+                         Int32* peakBin,
+                         double* peak,
+                         double* fwhm );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
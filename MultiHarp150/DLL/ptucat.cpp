@@ -0,0 +1,818 @@
+/******************************************************************/
+/** @file ptucat.cpp
+ *  PTU / PHU header catalog DLL
+ *
+ *  Implementation of @ref ptucat.h
+ *
+ *  Index file, little endian:
+ *    char[8] "PTCIDX01"
+ *    uint32 names, then per name: uint16 length, bytes
+ *    uint32 entries, then per entry: uint32 path length, bytes,
+ *      uint64 size, int64 mtime, uint8 valid, uint32 tags, then per tag:
+ *      uint32 name, uint8 kind, double (kind 0) or uint32 length, bytes
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "ptucat.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+typedef unsigned long long UInt64;
+typedef long long          Int64;
+
+const char   kIndexMagic[8] = { 'P', 'T', 'C', 'I', 'D', 'X', '0', '1' };
+const UInt64 kMaxTagData    = 1 << 20;    /**< longer strings: not a header   */
+const Int32  kMaxTags       = 100000;
+
+/* Tag types of the PicoQuant tagged header */
+const unsigned tyEmpty8      = 0xFFFF0008;
+const unsigned tyBool8       = 0x00000008;
+const unsigned tyInt8        = 0x10000008;
+const unsigned tyBitSet64    = 0x11000008;
+const unsigned tyColor8      = 0x12000008;
+const unsigned tyFloat8      = 0x20000008;
+const unsigned tyTDateTime   = 0x21000008;
+const unsigned tyFloat8Array = 0x2001FFFF;
+const unsigned tyAnsiString  = 0x4001FFFF;
+const unsigned tyWideString  = 0x4002FFFF;
+const unsigned tyBinaryBlob  = 0xFFFFFFFF;
+
+enum Pseudo { kPath = -1, kSize = -2, kMtime = -3 };
+
+
+struct Tag {
+  Int32       name = 0;
+  bool        text = false;
+  double      num  = 0.;
+  std::string str;
+};
+
+struct Entry {
+  std::string      path;
+  UInt64           size  = 0;
+  Int64            mtime = 0;
+  bool             valid = false;
+  std::vector<Tag> tags;       /**< sorted by name id                   */
+};
+
+/** Header read by a worker, names not yet interned                      */
+struct Parsed {
+  bool                                     valid = false;
+  std::vector<std::pair<std::string, Tag>> tags;
+};
+
+
+bool fileStat( const std::string& path, UInt64& size, Int64& mtime )
+{
+#ifdef _WIN32
+  struct _stat64 st;
+  if ( _stat64( path.c_str(), &st ) != 0 )
+    return false;
+#else
+  struct stat st;
+  if ( stat( path.c_str(), &st ) != 0 )
+    return false;
+#endif
+  size  = UInt64( st.st_size );
+  mtime = Int64( st.st_mtime );
+  return true;
+}
+
+/** Reads the tagged header; stops at Header_End                         */
+Parsed readHeader( const std::string& path )
+{
+  Parsed     p;
+  std::FILE* f = std::fopen( path.c_str(), "rb" );
+  if ( !f )
+    return p;
+  char magic[16];
+  if ( std::fread( magic, 1, 16, f ) != 16
+       || ( std::memcmp( magic, "PQTTTR\0\0", 8 ) != 0 && std::memcmp( magic, "PQHISTO\0", 8 ) != 0 ) ) {
+    std::fclose( f );
+    return p;
+  }
+  for ( Int32 n = 0; n < kMaxTags; ++n ) {
+    unsigned char rec[48];
+    if ( std::fread( rec, 1, 48, f ) != 48 )
+      break;
+    Int32    idx;
+    unsigned typ;
+    UInt64   raw;
+    std::memcpy( &idx, rec + 32, 4 );
+    std::memcpy( &typ, rec + 36, 4 );
+    std::memcpy( &raw, rec + 40, 8 );
+    std::string name( reinterpret_cast<const char*>( rec ), strnlen( reinterpret_cast<const char*>( rec ), 32 ) );
+    if ( name == "Header_End" ) {
+      p.valid = true;
+      break;
+    }
+    if ( idx > -1 )
+      name += "(" + std::to_string( idx ) + ")";
+
+    Tag  t;
+    bool keep = true;
+    switch ( typ ) {
+    case tyEmpty8:
+      keep = false;
+      break;
+    case tyBool8:
+      t.num = raw != 0 ? 1. : 0.;
+      break;
+    case tyInt8:
+    case tyBitSet64:
+    case tyColor8:
+      t.num = double( Int64( raw ) );
+      break;
+    case tyFloat8:
+    case tyTDateTime:
+      std::memcpy( &t.num, &raw, 8 );
+      break;
+    case tyFloat8Array:
+    case tyBinaryBlob:
+      keep = false;
+      if ( raw > ( UInt64( 1 ) << 30 ) || std::fseek( f, long( raw ), SEEK_CUR ) != 0 ) {
+        std::fclose( f );
+        p.valid = false;
+        return p;
+      }
+      break;
+    case tyAnsiString:
+    case tyWideString: {
+      if ( raw > kMaxTagData ) {
+        std::fclose( f );
+        return p;
+      }
+      std::string data( size_t( raw ), '\0' );
+      if ( std::fread( &data[0], 1, data.size(), f ) != data.size() ) {
+        std::fclose( f );
+        return p;
+      }
+      t.text = true;
+      if ( typ == tyAnsiString )
+        t.str.assign( data.c_str() );
+      else
+        for ( size_t k = 0; k + 1 < data.size(); k += 2 ) {
+          unsigned c = unsigned( ( unsigned char )data[k] ) | unsigned( ( unsigned char )data[k + 1] ) << 8;
+          if ( !c )
+            break;
+          t.str += c < 0x80 ? char( c ) : '?';
+        }
+      break;
+    }
+    default:
+      std::fclose( f );
+      return p;
+    }
+    if ( keep )
+      p.tags.push_back( std::make_pair( name, t ) );
+  }
+  std::fclose( f );
+  return p;
+}
+
+std::string lower( std::string s )
+{
+  for ( char& c : s )
+    c = char( std::tolower( ( unsigned char )c ) );
+  return s;
+}
+
+std::string trim( const std::string& s )
+{
+  size_t a = s.find_first_not_of( " \t\r\n" ), b = s.find_last_not_of( " \t\r\n" );
+  return a == std::string::npos ? std::string() : s.substr( a, b - a + 1 );
+}
+
+bool parseNumber( const std::string& s, double& v )
+{
+  if ( s.empty() )
+    return false;
+  char* end = 0;
+  v = std::strtod( s.c_str(), &end );
+  return *end == '\0';
+}
+
+bool copyText( const std::string& s, char* out, Int32 size )
+{
+  if ( !out || size < 1 )
+    return false;
+  size_t n = std::min( s.size(), size_t( size - 1 ) );
+  std::memcpy( out, s.data(), n );
+  out[n] = '\0';
+  return n == s.size();
+}
+
+
+/* ----- Index file ----------------------------------------------------------- */
+
+class Writer
+{
+public:
+  explicit Writer( std::FILE* f ) : f_( f ), ok_( true ) {}
+  template <class T> void put( T v ) { ok_ = ok_ && std::fwrite( &v, sizeof v, 1, f_ ) == 1; }
+  void bytes( const std::string& s ) { ok_ = ok_ && ( s.empty() || std::fwrite( s.data(), 1, s.size(), f_ ) == s.size() ); }
+  bool ok() const { return ok_; }
+
+private:
+  std::FILE* f_;
+  bool       ok_;
+};
+
+class Reader
+{
+public:
+  explicit Reader( std::FILE* f ) : f_( f ), ok_( true ) {}
+  template <class T> T get()
+  {
+    T v = T();
+    ok_ = ok_ && std::fread( &v, sizeof v, 1, f_ ) == 1;
+    return v;
+  }
+  std::string bytes( UInt64 n )
+  {
+    if ( !ok_ || n > kMaxTagData * 16 ) {
+      ok_ = false;
+      return std::string();
+    }
+    std::string s( size_t( n ), '\0' );
+    ok_ = n == 0 || std::fread( &s[0], 1, s.size(), f_ ) == s.size();
+    return s;
+  }
+  bool ok() const { return ok_; }
+
+private:
+  std::FILE* f_;
+  bool       ok_;
+};
+
+
+/* ----- Catalog -------------------------------------------------------------- */
+
+struct Condition {
+  Int32       name = 0;
+  char        op   = '=';     /**< = ! < l > g ~ (l: <=, g: >=)          */
+  bool        isNum = false;
+  double      num   = 0.;
+  std::string str;
+};
+
+class Catalog
+{
+public:
+  explicit Catalog( const std::string& indexPath ) : index( indexPath ) {}
+
+  std::mutex                   m;
+  const std::string            index;
+  std::vector<std::string>     names;
+  std::map<std::string, Int32> ids;
+  std::vector<Entry>           entries;   /**< sorted by path              */
+
+  Int32 intern( const std::string& name )
+  {
+    auto it = ids.find( name );
+    if ( it != ids.end() )
+      return it->second;
+    Int32 id = Int32( names.size() );
+    names.push_back( name );
+    ids[name] = id;
+    return id;
+  }
+
+  Entry make( const std::string& path, UInt64 size, Int64 mtime, Parsed& p )
+  {
+    Entry e;
+    e.path  = path;
+    e.size  = size;
+    e.mtime = mtime;
+    e.valid = p.valid;
+    for ( auto& t : p.tags ) {
+      t.second.name = intern( t.first );
+      e.tags.push_back( std::move( t.second ) );
+    }
+    std::stable_sort( e.tags.begin(), e.tags.end(),
+                      []( const Tag& a, const Tag& b ) { return a.name < b.name; } );
+    return e;
+  }
+
+  bool load()
+  {
+    std::FILE* f = std::fopen( index.c_str(), "rb" );
+    if ( !f )
+      return errno == ENOENT;
+    Reader r( f );
+    bool   ok = r.bytes( 8 ) == std::string( kIndexMagic, 8 );
+    UInt64 nn = ok ? r.get<uint32_t>() : 0;
+    for ( UInt64 k = 0; ok && k < nn; ++k ) {
+      intern( r.bytes( r.get<uint16_t>() ) );
+      ok = r.ok();
+    }
+    UInt64 ne = ok ? r.get<uint32_t>() : 0;
+    for ( UInt64 k = 0; ok && k < ne; ++k ) {
+      Entry e;
+      e.path       = r.bytes( r.get<uint32_t>() );
+      e.size       = r.get<UInt64>();
+      e.mtime      = r.get<Int64>();
+      e.valid      = r.get<uint8_t>() != 0;
+      uint32_t nt  = r.get<uint32_t>();
+      for ( uint32_t j = 0; r.ok() && j < nt; ++j ) {
+        Tag t;
+        t.name = Int32( r.get<uint32_t>() );
+        t.text = r.get<uint8_t>() != 0;
+        if ( t.text )
+          t.str = r.bytes( r.get<uint32_t>() );
+        else
+          t.num = r.get<double>();
+        if ( t.name < 0 || size_t( t.name ) >= names.size() )
+          ok = false;
+        e.tags.push_back( std::move( t ) );
+      }
+      ok = ok && r.ok();
+      entries.push_back( std::move( e ) );
+    }
+    std::fclose( f );
+    if ( !ok ) {
+      names.clear();
+      ids.clear();
+      entries.clear();
+    }
+    return ok;
+  }
+
+  bool save() const
+  {
+    std::string tmp = index + ".tmp";
+    std::FILE*  f   = std::fopen( tmp.c_str(), "wb" );
+    if ( !f )
+      return false;
+    Writer w( f );
+    w.bytes( std::string( kIndexMagic, 8 ) );
+    w.put<uint32_t>( uint32_t( names.size() ) );
+    for ( const std::string& n : names ) {
+      w.put<uint16_t>( uint16_t( n.size() ) );
+      w.bytes( n );
+    }
+    w.put<uint32_t>( uint32_t( entries.size() ) );
+    for ( const Entry& e : entries ) {
+      w.put<uint32_t>( uint32_t( e.path.size() ) );
+      w.bytes( e.path );
+      w.put<UInt64>( e.size );
+      w.put<Int64>( e.mtime );
+      w.put<uint8_t>( e.valid );
+      w.put<uint32_t>( uint32_t( e.tags.size() ) );
+      for ( const Tag& t : e.tags ) {
+        w.put<uint32_t>( uint32_t( t.name ) );
+        w.put<uint8_t>( t.text );
+        if ( t.text ) {
+          w.put<uint32_t>( uint32_t( t.str.size() ) );
+          w.bytes( t.str );
+        }
+        else
+          w.put<double>( t.num );
+      }
+    }
+    bool ok = w.ok() && std::fclose( f ) == 0;
+    if ( !ok ) {
+      std::remove( tmp.c_str() );
+      return false;
+    }
+    std::error_code ec;
+    fs::rename( tmp, index, ec );
+    return !ec;
+  }
+
+  const Tag* tag( const Entry& e, Int32 name ) const
+  {
+    auto it = std::lower_bound( e.tags.begin(), e.tags.end(), name,
+                                []( const Tag& t, Int32 n ) { return t.name < n; } );
+    return it != e.tags.end() && it->name == name ? &*it : 0;
+  }
+
+  /** Value of a tag or pseudo tag; false if the entry has none           */
+  bool value( const Entry& e, Int32 name, Tag& out ) const
+  {
+    out = Tag();
+    switch ( name ) {
+    case kPath:
+      out.text = true;
+      out.str  = e.path;
+      return true;
+    case kSize:
+      out.num = double( e.size );
+      return true;
+    case kMtime:
+      out.num = double( e.mtime );
+      return true;
+    default:
+      if ( const Tag* t = tag( e, name ) ) {
+        out = *t;
+        return true;
+      }
+      return false;
+    }
+  }
+
+  bool matches( const Entry& e, const Condition& c ) const
+  {
+    Tag v;
+    if ( !value( e, c.name, v ) )
+      return false;
+    if ( v.text ) {
+      switch ( c.op ) {
+      case '=': return v.str == c.str;
+      case '!': return v.str != c.str;
+      case '~': return lower( v.str ).find( c.str ) != std::string::npos;
+      default:  return false;
+      }
+    }
+    if ( !c.isNum )
+      return false;
+    switch ( c.op ) {
+    case '=': return v.num == c.num;
+    case '!': return v.num != c.num;
+    case '<': return v.num < c.num;
+    case 'l': return v.num <= c.num;
+    case '>': return v.num > c.num;
+    case 'g': return v.num >= c.num;
+    default:  return false;
+    }
+  }
+
+  /** Id of a tag or pseudo tag name; false if no file has it           */
+  bool resolve( const std::string& name, Int32& id ) const
+  {
+    if ( name == "$path" )
+      id = kPath;
+    else if ( name == "$size" )
+      id = kSize;
+    else if ( name == "$mtime" )
+      id = kMtime;
+    else {
+      auto it = ids.find( name );
+      if ( it == ids.end() )
+        return false;
+      id = it->second;
+    }
+    return true;
+  }
+
+  /** Parses the query; unknown tag names make known false                */
+  bool parse( const std::string& query, std::vector<Condition>& out, bool& known ) const
+  {
+    known = true;
+    size_t pos = 0;
+    while ( pos <= query.size() ) {
+      size_t      end  = std::min( query.find( ';', pos ), query.size() );
+      std::string part = trim( query.substr( pos, end - pos ) );
+      pos              = end + 1;
+      if ( part.empty() )
+        continue;
+      size_t at = part.find_first_of( "=!<>~" );
+      if ( at == std::string::npos || at == 0 )
+        return false;
+      Condition   c;
+      std::string name = trim( part.substr( 0, at ) );
+      size_t      len  = 1;
+      char        a = part[at], b = at + 1 < part.size() ? part[at + 1] : '\0';
+      if ( a == '!' && b == '=' ) {
+        c.op = '!';
+        len  = 2;
+      }
+      else if ( ( a == '<' || a == '>' ) && b == '=' ) {
+        c.op = a == '<' ? 'l' : 'g';
+        len  = 2;
+      }
+      else if ( a == '!' )
+        return false;
+      else
+        c.op = a;
+      c.str   = trim( part.substr( at + len ) );
+      c.isNum = parseNumber( c.str, c.num );
+      if ( c.op == '~' )
+        c.str = lower( c.str );
+      else if ( !c.isNum && c.op != '=' && c.op != '!' )
+        return false;
+
+      if ( name.empty() )
+        return false;
+      known = resolve( name, c.name ) && known;
+      out.push_back( c );
+    }
+    return true;
+  }
+};
+
+
+struct Registry {
+  std::mutex                                m;
+  Int32                                     nextId = 1;
+  std::map<Int32, std::shared_ptr<Catalog>> cats;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Catalog> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.cats.find( handle );
+  return it == reg.cats.end() ? std::shared_ptr<Catalog>() : it->second;
+}
+
+bool isHeaderFile( const fs::path& p )
+{
+  std::string ext = lower( p.extension().string() );
+  return ext == ".ptu" || ext == ".phu";
+}
+
+/** Whether path lies in the directory (directly unless recursive)       */
+bool inScope( const std::string& path, const fs::path& dir, bool recursive )
+{
+  fs::path p( path );
+  if ( !recursive )
+    return p.parent_path() == dir;
+  std::string d = dir.string();
+  return path.size() > d.size() && path.compare( 0, d.size(), d ) == 0
+         && ( path[d.size()] == '/' || path[d.size()] == '\\' || d.back() == '/' || d.back() == '\\' );
+}
+
+} // namespace
+
+
+Int32 PTC_API PTC_open( const char* index, Int32* cat )
+{
+  if ( !index || !*index || !cat )
+    return PTC_InvalidParam;
+  try {
+    std::shared_ptr<Catalog> c = std::make_shared<Catalog>( index );
+    if ( !c->load() )
+      return PTC_FileError;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *cat = reg.nextId++;
+    reg.cats[*cat] = c;
+    return PTC_Ok;
+  }
+  catch ( ... ) {
+    return PTC_Error;
+  }
+}
+
+
+Int32 PTC_API PTC_close( Int32 cat )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.cats.erase( cat ) ? PTC_Ok : PTC_NotConnected;
+}
+
+
+Int32 PTC_API PTC_update( Int32 cat,
+                          const char* directory,
+                          Bln32 recursive,
+                          Int32 threads,
+                          Int32* added,
+                          Int32* removed )
+{
+  if ( !directory || threads < 0 )
+    return PTC_InvalidParam;
+  std::shared_ptr<Catalog> c = find( cat );
+  if ( !c )
+    return PTC_NotConnected;
+
+  try {
+    std::error_code ec;
+    fs::path dir = fs::absolute( fs::path( directory ), ec ).lexically_normal();
+    if ( ec || !fs::is_directory( dir, ec ) )
+      return PTC_FileError;
+    if ( !dir.has_filename() && dir != dir.root_path() )
+      dir = dir.parent_path();            /* trailing separator */
+
+    /* Files of the directory, without holding the catalog */
+    struct Found {
+      std::string path;
+      UInt64      size;
+      Int64       mtime;
+    };
+    std::vector<Found> found;
+    auto visit = [&]( const fs::directory_entry& de ) {
+      std::error_code e;
+      if ( !de.is_regular_file( e ) || !isHeaderFile( de.path() ) )
+        return;
+      Found f;
+      f.path = de.path().string();
+      if ( fileStat( f.path, f.size, f.mtime ) )
+        found.push_back( f );
+    };
+    const auto opts = fs::directory_options::skip_permission_denied;
+    if ( recursive ) {
+      for ( fs::recursive_directory_iterator it( dir, opts, ec ), end; !ec && it != end; it.increment( ec ) )
+        visit( *it );
+    }
+    else {
+      for ( fs::directory_iterator it( dir, opts, ec ), end; !ec && it != end; it.increment( ec ) )
+        visit( *it );
+    }
+    if ( ec )
+      return PTC_FileError;
+
+    /* Files that are new or changed */
+    std::map<std::string, std::pair<UInt64, Int64>> known;
+    {
+      std::lock_guard<std::mutex> lk( c->m );
+      for ( const Entry& e : c->entries )
+        if ( inScope( e.path, dir, recursive != 0 ) )
+          known[e.path] = std::make_pair( e.size, e.mtime );
+    }
+    std::vector<size_t> todo;
+    for ( size_t k = 0; k < found.size(); ++k ) {
+      auto it = known.find( found[k].path );
+      if ( it == known.end() || it->second != std::make_pair( found[k].size, found[k].mtime ) )
+        todo.push_back( k );
+    }
+
+    /* Read their headers in parallel */
+    std::vector<Parsed> parsed( todo.size() );
+    size_t workers = threads ? size_t( threads ) : std::max( 1u, std::thread::hardware_concurrency() );
+    workers = std::min( workers, todo.size() );
+    std::atomic<size_t> next( 0 );
+    auto work = [&]() {
+      for ( size_t k; ( k = next.fetch_add( 1 ) ) < todo.size(); )
+        parsed[k] = readHeader( found[todo[k]].path );
+    };
+    std::vector<std::thread> pool;
+    for ( size_t k = 1; k < workers; ++k )
+      pool.emplace_back( work );
+    work();
+    for ( std::thread& t : pool )
+      t.join();
+
+    /* Merge */
+    std::lock_guard<std::mutex> lk( c->m );
+    std::map<std::string, size_t> present;
+    for ( size_t k = 0; k < found.size(); ++k )
+      present[found[k].path] = k;
+    std::vector<Entry> merged;
+    Int32 dropped = 0;
+    for ( Entry& e : c->entries ) {
+      if ( !inScope( e.path, dir, recursive != 0 ) ) {
+        merged.push_back( std::move( e ) );
+        continue;
+      }
+      auto it = present.find( e.path );
+      if ( it == present.end() )
+        ++dropped;
+      else if ( e.size == found[it->second].size && e.mtime == found[it->second].mtime ) {
+        merged.push_back( std::move( e ) );
+        present.erase( it );
+      }
+    }
+    /* An overlapping update may have added the file meanwhile */
+    Int32 fresh = 0;
+    for ( size_t k = 0; k < todo.size(); ++k ) {
+      const Found& f = found[todo[k]];
+      if ( !present.count( f.path ) )
+        continue;
+      merged.push_back( c->make( f.path, f.size, f.mtime, parsed[k] ) );
+      ++fresh;
+    }
+    std::sort( merged.begin(), merged.end(),
+               []( const Entry& a, const Entry& b ) { return a.path < b.path; } );
+    c->entries.swap( merged );
+
+    if ( added )
+      *added = fresh;
+    if ( removed )
+      *removed = dropped;
+    return c->save() ? PTC_Ok : PTC_FileError;
+  }
+  catch ( ... ) {
+    return PTC_Error;
+  }
+}
+
+
+Int32 PTC_API PTC_count( Int32 cat, Int32* count )
+{
+  if ( !count )
+    return PTC_InvalidParam;
+  std::shared_ptr<Catalog> c = find( cat );
+  if ( !c )
+    return PTC_NotConnected;
+  std::lock_guard<std::mutex> lk( c->m );
+  *count = Int32( c->entries.size() );
+  return PTC_Ok;
+}
+
+
+Int32 PTC_API PTC_query( Int32 cat,
+                         const char* query,
+                         Int32* entries,
+                         Int32 size,
+                         Int32* count )
+{
+  if ( !query || size < 0 || ( size > 0 && !entries ) || !count )
+    return PTC_InvalidParam;
+  std::shared_ptr<Catalog> c = find( cat );
+  if ( !c )
+    return PTC_NotConnected;
+  std::lock_guard<std::mutex> lk( c->m );
+  std::vector<Condition> conds;
+  bool known;
+  if ( !c->parse( query, conds, known ) )
+    return PTC_SyntaxError;
+  Int32 n = 0;
+  if ( known )
+    for ( size_t k = 0; k < c->entries.size(); ++k ) {
+      const Entry& e = c->entries[k];
+      if ( !e.valid )
+        continue;
+      bool ok = true;
+      for ( const Condition& cd : conds )
+        if ( !c->matches( e, cd ) ) {
+          ok = false;
+          break;
+        }
+      if ( !ok )
+        continue;
+      if ( n < size )
+        entries[n] = Int32( k );
+      ++n;
+    }
+  *count = n;
+  return n > size ? PTC_BufferTooSmall : PTC_Ok;
+}
+
+
+Int32 PTC_API PTC_path( Int32 cat, Int32 entry, char* path, Int32 size )
+{
+  if ( !path || size < 1 )
+    return PTC_InvalidParam;
+  std::shared_ptr<Catalog> c = find( cat );
+  if ( !c )
+    return PTC_NotConnected;
+  std::lock_guard<std::mutex> lk( c->m );
+  if ( entry < 0 || size_t( entry ) >= c->entries.size() )
+    return PTC_InvalidParam;
+  return copyText( c->entries[entry].path, path, size ) ? PTC_Ok : PTC_BufferTooSmall;
+}
+
+
+Int32 PTC_API PTC_value( Int32 cat,
+                         Int32 entry,
+                         const char* tag,
+                         double* value,
+                         char* text,
+                         Int32 size )
+{
+  if ( !tag || ( text && size < 1 ) )
+    return PTC_InvalidParam;
+  std::shared_ptr<Catalog> c = find( cat );
+  if ( !c )
+    return PTC_NotConnected;
+  std::lock_guard<std::mutex> lk( c->m );
+  if ( entry < 0 || size_t( entry ) >= c->entries.size() )
+    return PTC_InvalidParam;
+
+  Int32 name;
+  Tag   v;
+  if ( !c->resolve( tag, name ) || !c->value( c->entries[entry], name, v ) )
+    return PTC_NoData;
+  if ( value )
+    *value = v.text ? std::numeric_limits<double>::quiet_NaN() : v.num;
+  if ( text ) {
+    if ( !v.text ) {
+      char buf[32];
+      std::snprintf( buf, sizeof buf, "%.17g", v.num );
+      v.str = buf;
+    }
+    if ( !copyText( v.str, text, size ) )
+      return PTC_BufferTooSmall;
+  }
+  return PTC_Ok;
+}
@@ -0,0 +1,164 @@
+/******************************************************************/
+/** @file ptucat.h
+ *  PTU / PHU header catalog DLL
+ *
+ *  Keeps the tagged headers of all PicoQuant PTU and PHU files of one
+ *  or more directories in an index file, so that runs can be found by
+ *  tag value without opening every file in MainTagBrowser.vi or
+ *  MH_ReadPTUHeader.vi. @ref PTC_update scans a directory, reads only
+ *  the header bytes of files that are new or changed since the last
+ *  update (several files in parallel) and saves the index; queries are
+ *  answered from memory.
+ *
+ *  Tag names are as in the header, with "(i)" appended to indexed
+ *  tags, e.g. "MeasDesc_Resolution", "TTResult_SyncRate",
+ *  "File_Comment", "HWInpChan_CFDLevel(2)". Numeric tag types (bool,
+ *  int, bit set, colour, float, TDateTime in days since 1899-12-30)
+ *  give numbers; ANSI and wide strings give text. Arrays and binary
+ *  blobs are not indexed. The pseudo tags "$path", "$size" [bytes] and
+ *  "$mtime" [s since 1970] describe the file itself.
+ */
+/******************************************************************/
+
+#ifndef __PTUCAT_H__
+#define __PTUCAT_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define PTC_API
+#else
+#ifdef  DLL_EXPORT
+#define PTC_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define PTC_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define PTC_Ok                   0              /**< No error                              */
+#define PTC_Error              (-1)             /**< Unspecified error                     */
+#define PTC_NotConnected        -2              /**< Catalog handle does not exist         */
+#define PTC_FileError           -8              /**< Index or directory not accessible     */
+#define PTC_InvalidParam        -9              /**< Parameter out of range                */
+#define PTC_BufferTooSmall     -10              /**< Output array too small                */
+#define PTC_NoData             -15              /**< Tag not in the file                   */
+#define PTC_SyntaxError        -19              /**< Query cannot be parsed                */
+
+
+/** @brief Open a catalog
+ *
+ *  @param  index     Index file; created by the first @ref PTC_update if
+ *                    it does not exist
+ *  @param  cat       Output: catalog handle
+ *  @return           Result of function, @ref PTC_FileError if the file
+ *                    exists but is not a valid index
+ */
+Int32 PTC_API PTC_open( const char* index, Int32* cat );
+
+
+/** @brief Close a catalog
+ *
+ *  @param  cat       Catalog handle
+ *  @return           Result of function
+ */
+Int32 PTC_API PTC_close( Int32 cat );
+
+
+/** @brief Bring the catalog up to date with a directory and save it
+ *
+ *  Files whose size or modification time changed are read again, files
+ *  that disappeared are dropped. Entries of other directories are kept.
+ *
+ *  @param  cat        Catalog handle
+ *  @param  directory  Directory with *.ptu / *.phu files
+ *  @param  recursive  Include sub directories
+ *  @param  threads    Parallel header readers, 0 for one per core
+ *  @param  added      Output: entries added (new or changed files); an
+ *                     overlapping update may have taken some. May be NULL
+ *  @param  removed    Output: entries dropped, may be NULL
+ *  @return            Result of function
+ */
+Int32 PTC_API PTC_update( Int32 cat,
+                          const char* directory,
+                          Bln32 recursive,
+                          Int32 threads,
+                          Int32* added,
+                          Int32* removed );
+
+
+/** @brief Number of files in the catalog
+ *
+ *  @param  cat       Catalog handle
+ *  @param  count     Output: number of entries
+ *  @return           Result of function
+ */
+Int32 PTC_API PTC_count( Int32 cat, Int32* count );
+
+
+/** @brief Find files
+ *
+ *  The query is a list of conditions separated by ';', all of which
+ *  must hold, e.g. "MeasDesc_Resolution<=5e-12; File_Comment~dye".
+ *  Operators: = != < <= > >= on numbers, = != on text and ~ for a case
+ *  insensitive substring. An empty query matches every readable file.
+ *  Entries are numbered in path order.
+ *
+ *  @param  cat       Catalog handle
+ *  @param  query     Conditions
+ *  @param  entries   Output: matching entry numbers
+ *  @param  size      Size of entries
+ *  @param  count     Output: number of matches, also when larger than size
+ *  @return           Result of function, @ref PTC_BufferTooSmall if
+ *                    count > size (the first size entries are written)
+ */
+Int32 PTC_API PTC_query( Int32 cat,
+                         const char* query,
+                         Int32* entries,
+                         Int32 size,
+                         Int32* count );
+
+
+/** @brief Path of an entry
+ *
+ *  @param  cat       Catalog handle
+ *  @param  entry     Entry number
+ *  @param  path      Output: zero terminated path
+ *  @param  size      Size of path
+ *  @return           Result of function
+ */
+Int32 PTC_API PTC_path( Int32 cat, Int32 entry, char* path, Int32 size );
+
+
+/** @brief Value of a tag of an entry
+ *
+ *  @param  cat       Catalog handle
+ *  @param  entry     Entry number
+ *  @param  tag       Tag name
+ *  @param  value     Output: number, NaN for text tags (may be NULL)
+ *  @param  text      Output: zero terminated text, number as text for
+ *                    numeric tags (may be NULL)
+ *  @param  size      Size of text
+ *  @return           Result of function, @ref PTC_NoData if the file has
+ *                    no such tag
+ */
+Int32 PTC_API PTC_value( Int32 cat,
+                         Int32 entry,
+                         const char* tag,
+                         double* value,
+                         char* text,
+                         Int32 size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,275 @@
+/******************************************************************/
+/** @file sr830stream.cpp
+ *  SR830 streaming DLL
+ *
+ *  Implementation of @ref sr830stream.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "sr830stream.h"
+#include "ioschedule.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+struct Stream {
+  std::mutex   m;
+  Int32        instrument;
+  Int32        rateIndex;
+  SR830_Format format;
+  Int32        fetched = 0;                  /**< Points already read            */
+  double       t0      = 0.;                 /**< Host time of point 0 in s      */
+};
+
+struct Registry {
+  std::mutex                              m;
+  Int32                                   nextId = 1;
+  std::map<Int32, std::shared_ptr<Stream>> streams;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Stream> find( Int32 stream )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.streams.find( stream );
+  return it == reg.streams.end() ? std::shared_ptr<Stream>() : it->second;
+}
+
+double hostTime()
+{
+  return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/** Writes a command and waits until it has left the port                 */
+Int32 command( Int32 instrument, const char* cmd )
+{
+  Int32 ticket = 0, len = 0;
+  Int32 r = IOS_write( instrument, cmd, &ticket );
+  return r != IOS_Ok ? r : IOS_wait( ticket, -1, 0, 0, &len );
+}
+
+Int32 queryInt( Int32 instrument, const char* cmd, Int32& value )
+{
+  char  reply[32];
+  Int32 len = 0;
+  Int32 r   = IOS_queryWait( instrument, cmd, reply, sizeof reply - 1, &len );
+  if ( r != IOS_Ok )
+    return r;
+  reply[len] = 0;
+  value = Int32( std::strtol( reply, 0, 10 ) );
+  return IOS_Ok;
+}
+
+inline uint16_t le16( const unsigned char* p )
+{
+  return uint16_t( p[0] | ( p[1] << 8 ) );
+}
+
+} // namespace
+
+
+double SR830_API SR830_sampleRate( Int32 rateIndex )
+{
+  if ( rateIndex < 0 || rateIndex >= SR830_RATE_TRIGGER )
+    return 0.;
+  return std::ldexp( 0.0625, rateIndex );
+}
+
+
+Int32 SR830_API SR830_openStream( Int32 instrument,
+                                  Int32 rateIndex,
+                                  SR830_Format format,
+                                  Int32* stream )
+{
+  if ( !stream || rateIndex < 0 || rateIndex > SR830_RATE_TRIGGER ||
+       ( format != SR830_fmtIeee && format != SR830_fmtNative ) )
+    return SR830_InvalidParam;
+
+  char cmd[64];
+  std::snprintf( cmd, sizeof cmd, "REST;SRAT %d;SEND 0\n", rateIndex );
+  Int32 r = command( instrument, cmd );
+  if ( r != IOS_Ok )
+    return r;
+
+  try {
+    std::shared_ptr<Stream> s = std::make_shared<Stream>();
+    s->instrument = instrument;
+    s->rateIndex  = rateIndex;
+    s->format     = format;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *stream = reg.nextId++;
+    reg.streams[*stream] = s;
+    return SR830_Ok;
+  }
+  catch ( ... ) {
+    return SR830_Error;
+  }
+}
+
+
+Int32 SR830_API SR830_start( Int32 stream )
+{
+  std::shared_ptr<Stream> s = find( stream );
+  if ( !s )
+    return SR830_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+  double before = hostTime();
+  Int32  r      = command( s->instrument, "STRT\n" );
+  s->t0      = 0.5 * ( before + hostTime() );
+  s->fetched = 0;
+  return r;
+}
+
+
+Int32 SR830_API SR830_read( Int32 stream,
+                            float* ch1,
+                            float* ch2,
+                            double* t,
+                            Int32 size,
+                            Int32* count )
+{
+  if ( !count || size < 0 || ( size > 0 && ( !ch1 || !ch2 ) ) )
+    return SR830_InvalidParam;
+  *count = 0;
+  std::shared_ptr<Stream> s = find( stream );
+  if ( !s )
+    return SR830_NotConnected;
+  std::lock_guard<std::mutex> lk( s->m );
+
+  Int32 stored = 0;
+  Int32 r      = queryInt( s->instrument, "SPTS?\n", stored );
+  if ( r != IOS_Ok )
+    return r;
+  Int32 n = std::min( stored - s->fetched, size );
+  if ( n > 0 ) {
+    const char* trace = s->format == SR830_fmtIeee ? "TRCB" : "TRCL";
+    char  cmd[64];
+    Int32 ticket[2];
+    for ( int c = 0; c < 2; ++c ) {
+      std::snprintf( cmd, sizeof cmd, "%s? %d,%d,%d\n", trace, c + 1, s->fetched, n );
+      r = IOS_queryBinary( s->instrument, cmd, 4 * n, &ticket[c] );
+      if ( r != IOS_Ok ) {
+        if ( c == 1 )
+          IOS_release( ticket[0] );
+        return r;
+      }
+    }
+
+    /* Raw points are received in place and decoded over themselves */
+    float* dst[2] = { ch1, ch2 };
+    for ( int c = 0; c < 2; ++c ) {
+      Int32 len = 0;
+      Int32 w   = IOS_wait( ticket[c], -1, reinterpret_cast<char*>( dst[c] ), 4 * n, &len );
+      if ( w == IOS_Ok && len != 4 * n )
+        w = SR830_Error;
+      if ( w != IOS_Ok && r == IOS_Ok )
+        r = w;
+    }
+    if ( r != IOS_Ok )
+      return r;
+    for ( int c = 0; c < 2; ++c ) {
+      const unsigned char* raw = reinterpret_cast<const unsigned char*>( dst[c] );
+      if ( s->format == SR830_fmtIeee )
+        SR830_decodeIeee( raw, n, dst[c] );
+      else
+        SR830_decodeNative( raw, n, dst[c] );
+    }
+
+    double rate = SR830_sampleRate( s->rateIndex );
+    if ( t && rate > 0. )
+      for ( Int32 k = 0; k < n; ++k )
+        t[k] = s->t0 + ( s->fetched + k ) / rate;
+    s->fetched += n;
+    *count = n;
+  }
+  return ( stored >= SR830_BUFFER_POINTS && s->fetched >= stored ) ? SR830_BufferFull : SR830_Ok;
+}
+
+
+Int32 SR830_API SR830_closeStream( Int32 stream )
+{
+  std::shared_ptr<Stream> s;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.streams.find( stream );
+    if ( it == reg.streams.end() )
+      return SR830_NotConnected;
+    s = it->second;
+    reg.streams.erase( it );
+  }
+  std::lock_guard<std::mutex> lk( s->m );
+  return command( s->instrument, "PAUS\n" );
+}
+
+
+Int32 SR830_API SR830_startFast( Int32 instrument, Int32 rateIndex )
+{
+  if ( rateIndex < 0 || rateIndex >= SR830_RATE_TRIGGER )
+    return SR830_InvalidParam;
+  char cmd[64];
+  std::snprintf( cmd, sizeof cmd, "REST;SRAT %d;SEND 0;FAST 2\n", rateIndex );
+  Int32 r = command( instrument, cmd );
+  if ( r != IOS_Ok )
+    return r;
+  /* STRD waits 0.5 s before starting so the host can get ready to read */
+  return command( instrument, "STRD\n" );
+}
+
+
+Int32 SR830_API SR830_stopFast( Int32 instrument )
+{
+  return command( instrument, "PAUS;FAST 0\n" );
+}
+
+
+void SR830_API SR830_decodeIeee( const unsigned char* raw, Int32 n, float* out )
+{
+  for ( Int32 k = 0; k < n; ++k, raw += 4 ) {
+    uint32_t u = uint32_t( raw[0] ) | uint32_t( raw[1] ) << 8 |
+                 uint32_t( raw[2] ) << 16 | uint32_t( raw[3] ) << 24;
+    std::memcpy( out + k, &u, 4 );
+  }
+}
+
+
+void SR830_API SR830_decodeNative( const unsigned char* raw, Int32 n, float* out )
+{
+  for ( Int32 k = 0; k < n; ++k, raw += 4 ) {
+    int16_t m = int16_t( le16( raw ) );
+    int16_t e = int16_t( le16( raw + 2 ) );
+    out[k] = float( std::ldexp( double( m ), e - 124 ) );
+  }
+}
+
+
+void SR830_API SR830_decodeFast( const unsigned char* raw,
+                                 Int32 n,
+                                 double sensitivity,
+                                 float* x,
+                                 float* y )
+{
+  const float scale = float( sensitivity / 30000. );
+  for ( Int32 k = 0; k < n; ++k, raw += 4 ) {
+    x[k] = int16_t( le16( raw ) ) * scale;
+    y[k] = int16_t( le16( raw + 2 ) ) * scale;
+  }
+}
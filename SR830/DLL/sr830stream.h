@@ -0,0 +1,189 @@
+/******************************************************************/
+/** @file sr830stream.h
+ *  SR830 streaming DLL
+ *
+ *  Buffered acquisition for the SR830 lock-in amplifier. The internal
+ *  data buffer is filled at a fixed sample rate (SRAT) and read back in
+ *  large binary transfers (TRCB / TRCL), or the FAST data transfer mode
+ *  is streamed over GPIB. Replies are decoded in bulk straight into the
+ *  caller's arrays and host timestamps are rebuilt from the sample rate.
+ *
+ *  Communication goes through an instrument opened with the I/O
+ *  scheduler (see ioschedule.h); its error codes are passed through
+ *  unchanged.
+ */
+/******************************************************************/
+
+#ifndef __SR830STREAM_H__
+#define __SR830STREAM_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define SR830_API
+#else
+#ifdef  DLL_EXPORT
+#define SR830_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define SR830_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define SR830_Ok                 0              /**< No error                              */
+#define SR830_Error            (-1)             /**< Unspecified error                     */
+#define SR830_NotConnected      -2              /**< Stream handle does not exist          */
+#define SR830_InvalidParam      -9              /**< Parameter out of range                */
+#define SR830_BufferFull       -13              /**< Buffer full, acquisition has stopped  */
+
+#define SR830_BUFFER_POINTS  16383              /**< Capacity of each data buffer          */
+#define SR830_RATE_TRIGGER      14              /**< SRAT index of triggered sampling      */
+
+
+/** @brief  Binary transfer format of the buffer                                     */
+typedef enum {
+  SR830_fmtIeee   = 0,                       /**< TRCB: IEEE float, little endian    */
+  SR830_fmtNative = 1                        /**< TRCL: 16 bit mantissa + exponent   */
+} SR830_Format;
+
+
+/** @brief Sample rate
+ *
+ *  @param  rateIndex  SRAT index, 0 (62.5 mHz) to 13 (512 Hz)
+ *  @return            Sample rate in Hz, 0 for triggered sampling or invalid index
+ */
+double SR830_API SR830_sampleRate( Int32 rateIndex );
+
+
+/** @brief Open a buffered stream
+ *
+ *  Resets the data buffers and programs the sample rate in one shot
+ *  mode (SEND 0), so the buffer stops when full instead of wrapping.
+ *
+ *  @param  instrument  Instrument handle from IOS_openInstrument
+ *  @param  rateIndex   SRAT index [0..14]
+ *  @param  format      Binary transfer format, see @ref SR830_Format
+ *  @param  stream      Output: stream handle
+ *  @return             Result of function
+ */
+Int32 SR830_API SR830_openStream( Int32 instrument,
+                                  Int32 rateIndex,
+                                  SR830_Format format,
+                                  Int32* stream );
+
+
+/** @brief Start acquisition
+ *
+ *  Sends STRT and records the host time of the first sample.
+ *
+ *  @param  stream      Stream handle
+ *  @return             Result of function
+ */
+Int32 SR830_API SR830_start( Int32 stream );
+
+
+/** @brief Read the points acquired since the last call
+ *
+ *  Fetches both buffers (CH1 and CH2 displays) in two pipelined binary
+ *  transfers and decodes them into ch1 / ch2. Timestamps are in seconds
+ *  on the host steady clock; they are not available with triggered
+ *  sampling and t may then be NULL.
+ *
+ *  @param  stream      Stream handle
+ *  @param  ch1         Output: CH1 buffer values
+ *  @param  ch2         Output: CH2 buffer values
+ *  @param  t           Output: host timestamps
+ *  @param  size        Number of elements of ch1, ch2 and t
+ *  @param  count       Output: number of points written
+ *  @return             Result of function, @ref SR830_BufferFull once the
+ *                      last point of a full buffer has been read
+ */
+Int32 SR830_API SR830_read( Int32 stream,
+                            float* ch1,
+                            float* ch2,
+                            double* t,
+                            Int32 size,
+                            Int32* count );
+
+
+/** @brief Pause acquisition and release the stream
+ *
+ *  @param  stream      Stream handle
+ *  @return             Result of function
+ */
+Int32 SR830_API SR830_closeStream( Int32 stream );
+
+
+/** @brief Start FAST data transfer
+ *
+ *  Enables FAST mode 2 and starts the scan with STRD. The instrument then
+ *  sends X/Y (or CH1/CH2) as pairs of 16 bit integers at the sample rate
+ *  without being queried; fetch the bytes with IOS_queryBinary using an
+ *  empty command and decode them with @ref SR830_decodeFast.
+ *  Only available over GPIB.
+ *
+ *  @param  instrument  Instrument handle
+ *  @param  rateIndex   SRAT index [0..13]
+ *  @return             Result of function
+ */
+Int32 SR830_API SR830_startFast( Int32 instrument, Int32 rateIndex );
+
+
+/** @brief Stop FAST data transfer (PAUS, FAST 0)
+ *
+ *  @param  instrument  Instrument handle
+ *  @return             Result of function
+ */
+Int32 SR830_API SR830_stopFast( Int32 instrument );
+
+
+/** @brief Decode TRCB data
+ *
+ *  @param  raw     4 bytes per point, little endian IEEE float
+ *  @param  n       Number of points
+ *  @param  out     Output: values (may alias raw)
+ */
+void SR830_API SR830_decodeIeee( const unsigned char* raw, Int32 n, float* out );
+
+
+/** @brief Decode TRCL data
+ *
+ *  Each point is a 16 bit mantissa m followed by a 16 bit exponent e,
+ *  both little endian; the value is m * 2^(e - 124).
+ *
+ *  @param  raw     4 bytes per point
+ *  @param  n       Number of points
+ *  @param  out     Output: values (may alias raw)
+ */
+void SR830_API SR830_decodeNative( const unsigned char* raw, Int32 n, float* out );
+
+
+/** @brief Decode FAST mode data
+ *
+ *  Each point is a pair of 16 bit integers where +/-30000 is full scale.
+ *
+ *  @param  raw          4 bytes per point
+ *  @param  n            Number of points
+ *  @param  sensitivity  Full scale of the current sensitivity in V (or A)
+ *  @param  x            Output: first value of each pair
+ *  @param  y            Output: second value of each pair
+ */
+void SR830_API SR830_decodeFast( const unsigned char* raw,
+                                 Int32 n,
+                                 double sensitivity,
+                                 float* x,
+                                 float* y );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,677 @@
+/******************************************************************/
+/** @file tioparse.cpp
+ *  TIO packet parser DLL
+ *
+ *  Implementation of @ref tioparse.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "tioparse.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const unsigned char kEnd        = 0xC0;   /**< SLIP frame end           */
+const unsigned char kEsc        = 0xDB;   /**< SLIP escape              */
+const unsigned char kEscEnd     = 0xDC;
+const unsigned char kEscEsc     = 0xDD;
+const size_t        kHeader     = 4;
+const size_t        kMaxRouting = 8;
+const size_t        kMaxQueue   = 256;    /**< packets kept for TIO_readPacket */
+const uint16_t      kByName     = 0x8000; /**< method id flag: name follows    */
+
+uint16_t get16( const unsigned char* p ) { return uint16_t( p[0] | ( p[1] << 8 ) ); }
+uint32_t get32( const unsigned char* p ) { return uint32_t( p[0] ) | uint32_t( p[1] ) << 8 | uint32_t( p[2] ) << 16 | uint32_t( p[3] ) << 24; }
+
+void put16( std::vector<unsigned char>& v, uint16_t x )
+{
+  v.push_back( (unsigned char)x );
+  v.push_back( (unsigned char)( x >> 8 ) );
+}
+
+
+/** CRC-32 (IEEE 802.3), as TIO Serial Checksum CRC32.vi                  */
+uint32_t crc32( const unsigned char* p, size_t n )
+{
+  static const std::vector<uint32_t> table = [] {
+    std::vector<uint32_t> t( 256 );
+    for ( uint32_t i = 0; i < 256; ++i ) {
+      uint32_t c = i;
+      for ( int k = 0; k < 8; ++k )
+        c = c & 1 ? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t c = 0xFFFFFFFFu;
+  for ( size_t i = 0; i < n; ++i )
+    c = table[( c ^ p[i] ) & 0xFF] ^ ( c >> 8 );
+  return c ^ 0xFFFFFFFFu;
+}
+
+
+/* ----- Streams -------------------------------------------------------------- */
+
+size_t typeSize( Int32 t )
+{
+  static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+  return sizes[t];
+}
+
+/** One column of n samples, src stride and dst stride apart             */
+template <class T>
+void column( const unsigned char* src, size_t stride, size_t n, double* dst, size_t step )
+{
+  for ( size_t i = 0; i < n; ++i, src += stride, dst += step ) {
+    T v;
+    std::memcpy( &v, src, sizeof( T ) );
+    *dst = double( v );
+  }
+}
+
+typedef void ( *ColumnFn )( const unsigned char*, size_t, size_t, double*, size_t );
+
+ColumnFn columnFn( Int32 t )
+{
+  static const ColumnFn fns[] = { column<uint8_t>,  column<int8_t>,  column<uint16_t>, column<int16_t>,
+                                  column<uint32_t>, column<int32_t>, column<float>,    column<double> };
+  return fns[t];
+}
+
+class Stream
+{
+public:
+  Stream( const Int32* types, Int32 columns, Int32 capacity )
+    : columns_( columns ), rowBytes_( 0 ), capacity_( capacity ),
+      values_( size_t( capacity ) * columns ), samples_( capacity ),
+      head_( 0 ), count_( 0 ), started_( false ), next_( 0 )
+  {
+    for ( Int32 c = 0; c < columns; ++c ) {
+      fns_.push_back( columnFn( types[c] ) );
+      offsets_.push_back( rowBytes_ );
+      rowBytes_ += typeSize( types[c] );
+    }
+  }
+
+  /** Decodes whole samples of a payload; returns false if bytes are left */
+  bool decode( const unsigned char* p, size_t n, double& lost, double& overflow )
+  {
+    uint32_t first = get32( p );
+    size_t   rows  = ( n - 4 ) / rowBytes_;
+    if ( started_ ) {
+      uint32_t gap = first - next_;
+      if ( gap < 0x80000000u )
+        lost += gap;              /* else the device restarted its counter */
+    }
+    started_ = true;
+    next_    = first + uint32_t( rows );
+
+    stage_.resize( rows * columns_ );
+    for ( Int32 c = 0; c < columns_; ++c )
+      fns_[c]( p + 4 + offsets_[c], rowBytes_, rows, &stage_[c], size_t( columns_ ) );
+
+    for ( size_t r = 0; r < rows; ++r ) {
+      Int32 slot;
+      if ( count_ == capacity_ ) {
+        slot  = head_;
+        head_ = ( head_ + 1 ) % capacity_;
+        overflow += 1.;
+      }
+      else
+        slot = ( head_ + count_++ ) % capacity_;
+      std::memcpy( &values_[size_t( slot ) * columns_], &stage_[r * columns_], columns_ * sizeof( double ) );
+      samples_[slot] = double( uint32_t( first + r ) );
+    }
+    return ( n - 4 ) % rowBytes_ == 0;
+  }
+
+  Int32 take( double* values, double* samples, Int32 size )
+  {
+    Int32 n = std::min( size, count_ );
+    for ( Int32 k = 0; k < n; ++k ) {
+      Int32 slot = ( head_ + k ) % capacity_;
+      std::memcpy( values + size_t( k ) * columns_, &values_[size_t( slot ) * columns_], columns_ * sizeof( double ) );
+      if ( samples )
+        samples[k] = samples_[slot];
+    }
+    head_   = ( head_ + n ) % capacity_;
+    count_ -= n;
+    return n;
+  }
+
+private:
+  const Int32           columns_;
+  std::vector<ColumnFn> fns_;
+  std::vector<size_t>   offsets_;
+  size_t                rowBytes_;
+  const Int32           capacity_;
+  std::vector<double>   values_, samples_, stage_;
+  Int32                 head_, count_;
+  bool                  started_;
+  uint32_t              next_;
+};
+
+
+/* ----- Parser --------------------------------------------------------------- */
+
+struct Packet {
+  Int32                      type;
+  Int32                      routing;
+  std::vector<unsigned char> data;      /**< payload and routing bytes */
+};
+
+struct Reply {
+  bool                       done;
+  bool                       error;
+  Int32                      code;
+  std::vector<unsigned char> data;
+};
+
+class Parser
+{
+public:
+  explicit Parser( Int32 framing )
+    : slip_( framing == TIO_Slip ), esc_( false ), bad_( false ), resync_( false ), nextRequest_( 1 ),
+      packets_( 0. ), errors_( 0. ), lost_( 0. ), overflow_( 0. ) {}
+
+  std::mutex              m;
+  std::condition_variable replyCv;
+
+  void setStream( Int32 id, const Int32* types, Int32 columns, Int32 capacity )
+  {
+    streams_[id].reset( new Stream( types, columns, capacity ) );
+  }
+
+  Stream* stream( Int32 id ) { return streams_[id].get(); }
+
+  void feed( const unsigned char* p, size_t n )
+  {
+    if ( slip_ )
+      feedSlip( p, n );
+    else
+      feedRaw( p, n );
+  }
+
+  const Packet* front() const { return queue_.empty() ? 0 : &queue_.front(); }
+  void          pop() { queue_.pop_front(); }
+
+  std::vector<unsigned char> frame( Int32 type, const unsigned char* payload, size_t n ) const
+  {
+    std::vector<unsigned char> pkt;
+    pkt.reserve( kHeader + n + 4 );
+    pkt.push_back( (unsigned char)type );
+    pkt.push_back( 0 );
+    put16( pkt, uint16_t( n ) );
+    pkt.insert( pkt.end(), payload, payload + n );
+    if ( !slip_ )
+      return pkt;
+
+    uint32_t crc = crc32( pkt.data(), pkt.size() );
+    for ( int k = 0; k < 4; ++k )
+      pkt.push_back( (unsigned char)( crc >> ( 8 * k ) ) );
+    std::vector<unsigned char> out;
+    out.reserve( 2 * pkt.size() + 2 );
+    out.push_back( kEnd );
+    for ( unsigned char b : pkt ) {
+      if ( b == kEnd ) {
+        out.push_back( kEsc );
+        out.push_back( kEscEnd );
+      }
+      else if ( b == kEsc ) {
+        out.push_back( kEsc );
+        out.push_back( kEscEsc );
+      }
+      else
+        out.push_back( b );
+    }
+    out.push_back( kEnd );
+    return out;
+  }
+
+  uint16_t newRequest()
+  {
+    while ( nextRequest_ == 0 || pending_.count( nextRequest_ ) )
+      ++nextRequest_;
+    Reply& r = pending_[nextRequest_];
+    r.done = false;
+    return nextRequest_++;
+  }
+
+  std::map<uint16_t, Reply>& pending() { return pending_; }
+
+  void counters( double* packets, double* errors, double* lost, double* overflow ) const
+  {
+    if ( packets )
+      *packets = packets_;
+    if ( errors )
+      *errors = errors_;
+    if ( lost )
+      *lost = lost_;
+    if ( overflow )
+      *overflow = overflow_;
+  }
+
+private:
+  void feedSlip( const unsigned char* p, size_t n )
+  {
+    for ( size_t i = 0; i < n; ++i ) {
+      unsigned char b = p[i];
+      if ( b == kEnd ) {
+        if ( bad_ )
+          errors_ += 1.;
+        else if ( !frame_.empty() )
+          slipFrame();
+        frame_.clear();
+        bad_ = esc_ = false;
+        continue;
+      }
+      if ( bad_ )
+        continue;
+      if ( esc_ ) {
+        esc_ = false;
+        if ( b == kEscEnd )
+          b = kEnd;
+        else if ( b == kEscEsc )
+          b = kEsc;
+        else {
+          bad_ = true;
+          continue;
+        }
+      }
+      else if ( b == kEsc ) {
+        esc_ = true;
+        continue;
+      }
+      frame_.push_back( b );
+      if ( frame_.size() > TIO_MAX_PACKET + 4 )
+        bad_ = true;
+    }
+  }
+
+  void slipFrame()
+  {
+    size_t n = frame_.size();
+    if ( n < kHeader + 4 || crc32( frame_.data(), n - 4 ) != get32( &frame_[n - 4] )
+         || !packet( frame_.data(), n - 4 ) )
+      errors_ += 1.;
+  }
+
+  /** Header sizes within limits and a type this link can carry; stream
+   *  packets are plausible whether their stream is declared or not      */
+  bool plausible( const unsigned char* h ) const
+  {
+    size_t routing = h[1] & 0x0F, total = kHeader + get16( h + 2 ) + routing;
+    Int32  type    = h[0];
+    bool   known   = ( type >= TIO_PTYPE_LOG && type <= TIO_PTYPE_STREAM0 / 2 ) || type >= TIO_PTYPE_STREAM0;
+    return known && routing <= kMaxRouting && total <= TIO_MAX_PACKET;
+  }
+
+  /** Back to back packets. After an invalid header bytes are skipped one
+   *  at a time, and a packet is only accepted again when the header
+   *  following it is plausible too.                                      */
+  void feedRaw( const unsigned char* p, size_t n )
+  {
+    raw_.insert( raw_.end(), p, p + n );
+    size_t at = 0;
+    while ( raw_.size() - at >= kHeader ) {
+      const unsigned char* h = &raw_[at];
+      size_t total = kHeader + get16( h + 2 ) + ( h[1] & 0x0F );
+      bool   ok    = plausible( h );
+      if ( ok && resync_ ) {
+        if ( raw_.size() - at < total + kHeader )
+          break;
+        ok = plausible( h + total );
+      }
+      if ( !ok ) {
+        if ( !resync_ )
+          errors_ += 1.;
+        resync_ = true;
+        ++at;
+        continue;
+      }
+      if ( raw_.size() - at < total )
+        break;
+      resync_ = false;
+      packet( h, total );
+      at += total;
+    }
+    raw_.erase( raw_.begin(), raw_.begin() + at );
+  }
+
+  /** Dispatches one complete packet; false if its sizes do not match    */
+  bool packet( const unsigned char* p, size_t n )
+  {
+    Int32  type    = p[0];
+    size_t routing = p[1] & 0x0F, payload = get16( p + 2 );
+    if ( type == 0 || routing > kMaxRouting || kHeader + payload + routing != n )
+      return false;
+    packets_ += 1.;
+    const unsigned char* data = p + kHeader;
+
+    if ( routing == 0 && type >= TIO_PTYPE_STREAM0 && streams_[type - TIO_PTYPE_STREAM0] ) {
+      if ( payload < 4 || !streams_[type - TIO_PTYPE_STREAM0]->decode( data, payload, lost_, overflow_ ) )
+        errors_ += 1.;
+      return true;
+    }
+
+    if ( routing == 0 && ( type == TIO_PTYPE_RPC_REP || type == TIO_PTYPE_RPC_ERROR ) && payload >= 2 ) {
+      auto it = pending_.find( get16( data ) );
+      if ( it != pending_.end() && !it->second.done ) {
+        Reply& r = it->second;
+        size_t skip = type == TIO_PTYPE_RPC_ERROR && payload >= 4 ? 4 : 2;
+        r.done  = true;
+        r.error = type == TIO_PTYPE_RPC_ERROR;
+        r.code  = r.error && payload >= 4 ? get16( data + 2 ) : 0;
+        r.data.assign( data + skip, data + payload );
+        replyCv.notify_all();
+        return true;
+      }
+    }
+
+    if ( queue_.size() == kMaxQueue ) {
+      queue_.pop_front();
+      overflow_ += 1.;
+    }
+    Packet pk;
+    pk.type    = type;
+    pk.routing = Int32( routing );
+    pk.data.assign( data, data + payload + routing );
+    queue_.push_back( pk );
+    return true;
+  }
+
+  const bool                 slip_;
+  std::vector<unsigned char> frame_, raw_;
+  bool                       esc_, bad_, resync_;
+  std::unique_ptr<Stream>    streams_[TIO_MAX_STREAMS];
+  std::deque<Packet>         queue_;
+  std::map<uint16_t, Reply>  pending_;
+  uint16_t                   nextRequest_;
+  double                     packets_, errors_, lost_, overflow_;
+};
+
+
+struct Registry {
+  std::mutex                               m;
+  Int32                                    nextId = 1;
+  std::map<Int32, std::shared_ptr<Parser>> parsers;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Parser> find( Int32 handle )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.parsers.find( handle );
+  return it == reg.parsers.end() ? std::shared_ptr<Parser>() : it->second;
+}
+
+Int32 copyOut( const std::vector<unsigned char>& v, unsigned char* out, Int32 size, Int32* length )
+{
+  if ( length )
+    *length = Int32( v.size() );
+  if ( v.size() > size_t( size ) )
+    return TIO_BufferTooSmall;
+  if ( !v.empty() )
+    std::memcpy( out, v.data(), v.size() );
+  return TIO_Ok;
+}
+
+} // namespace
+
+
+Int32 TIO_API TIO_create( Int32 framing, Int32* parser )
+{
+  if ( ( framing != TIO_Slip && framing != TIO_Raw ) || !parser )
+    return TIO_InvalidParam;
+  try {
+    std::shared_ptr<Parser> p = std::make_shared<Parser>( framing );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *parser = reg.nextId++;
+    reg.parsers[*parser] = p;
+    return TIO_Ok;
+  }
+  catch ( ... ) {
+    return TIO_Error;
+  }
+}
+
+
+Int32 TIO_API TIO_close( Int32 parser )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  return reg.parsers.erase( parser ) ? TIO_Ok : TIO_NotConnected;
+}
+
+
+Int32 TIO_API TIO_setStream( Int32 parser,
+                             Int32 stream,
+                             Int32 columns,
+                             const Int32* types,
+                             Int32 capacity )
+{
+  if ( stream < 0 || stream >= TIO_MAX_STREAMS || columns < 1 || !types || capacity < 1 )
+    return TIO_InvalidParam;
+  for ( Int32 c = 0; c < columns; ++c )
+    if ( types[c] < TIO_u8 || types[c] > TIO_f64 )
+      return TIO_InvalidParam;
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+  try {
+    std::lock_guard<std::mutex> lk( p->m );
+    p->setStream( stream, types, columns, capacity );
+    return TIO_Ok;
+  }
+  catch ( ... ) {
+    return TIO_Error;
+  }
+}
+
+
+Int32 TIO_API TIO_feed( Int32 parser, const unsigned char* data, Int32 n )
+{
+  if ( n < 0 || ( n > 0 && !data ) )
+    return TIO_InvalidParam;
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+  try {
+    std::lock_guard<std::mutex> lk( p->m );
+    p->feed( data, size_t( n ) );
+    return TIO_Ok;
+  }
+  catch ( ... ) {
+    return TIO_Error;
+  }
+}
+
+
+Int32 TIO_API TIO_readStream( Int32 parser,
+                              Int32 stream,
+                              double* values,
+                              double* samples,
+                              Int32 size,
+                              Int32* rows )
+{
+  if ( stream < 0 || stream >= TIO_MAX_STREAMS || size < 0 || ( size > 0 && !values ) || !rows )
+    return TIO_InvalidParam;
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  Stream* s = p->stream( stream );
+  if ( !s )
+    return TIO_InvalidParam;
+  *rows = s->take( values, samples, size );
+  return TIO_Ok;
+}
+
+
+Int32 TIO_API TIO_readPacket( Int32 parser,
+                              Int32* type,
+                              unsigned char* payload,
+                              Int32 size,
+                              Int32* length,
+                              Int32* routing )
+{
+  if ( !type || size < 0 || ( size > 0 && !payload ) || !length )
+    return TIO_InvalidParam;
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  const Packet* pk = p->front();
+  if ( !pk )
+    return TIO_NoData;
+  *type = pk->type;
+  if ( routing )
+    *routing = pk->routing;
+  Int32 r = copyOut( pk->data, payload, size, length );
+  *length -= pk->routing;
+  if ( r == TIO_Ok )
+    p->pop();
+  return r;
+}
+
+
+Int32 TIO_API TIO_formPacket( Int32 parser,
+                              Int32 type,
+                              const unsigned char* payload,
+                              Int32 n,
+                              unsigned char* out,
+                              Int32 size,
+                              Int32* length )
+{
+  if ( type < 1 || type > 255 || n < 0 || size_t( n ) > TIO_MAX_PACKET - kHeader
+       || ( n > 0 && !payload ) || !out || !length )
+    return TIO_InvalidParam;
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+  return copyOut( p->frame( type, payload, size_t( n ) ), out, size, length );
+}
+
+
+Int32 TIO_API TIO_formRequest( Int32 parser,
+                               const char* method,
+                               const unsigned char* args,
+                               Int32 n,
+                               unsigned char* out,
+                               Int32 size,
+                               Int32* length,
+                               Int32* request )
+{
+  size_t name = method ? std::strlen( method ) : 0;
+  if ( name == 0 || n < 0 || ( n > 0 && !args ) || kHeader + 4 + name + size_t( n ) > TIO_MAX_PACKET
+       || !out || !length || !request )
+    return TIO_InvalidParam;
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+
+  std::lock_guard<std::mutex> lk( p->m );
+  uint16_t id = p->newRequest();
+  std::vector<unsigned char> payload;
+  put16( payload, id );
+  put16( payload, uint16_t( kByName | name ) );
+  payload.insert( payload.end(), method, method + name );
+  payload.insert( payload.end(), args, args + n );
+  Int32 r = copyOut( p->frame( TIO_PTYPE_RPC_REQ, payload.data(), payload.size() ), out, size, length );
+  if ( r != TIO_Ok ) {
+    p->pending().erase( id );
+    return r;
+  }
+  *request = id;
+  return TIO_Ok;
+}
+
+
+Int32 TIO_API TIO_reply( Int32 parser,
+                         Int32 request,
+                         Int32 timeout,
+                         unsigned char* reply,
+                         Int32 size,
+                         Int32* length,
+                         Int32* error )
+{
+  if ( timeout < 0 || size < 0 || ( size > 0 && !reply ) || !length )
+    return TIO_InvalidParam;
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+
+  if ( request < 1 || request > 0xFFFF )
+    return TIO_InvalidParam;
+  const uint16_t id = uint16_t( request );
+
+  std::unique_lock<std::mutex> lk( p->m );
+  auto& pending = p->pending();
+  if ( !pending.count( id ) )
+    return TIO_InvalidParam;
+  /* the lock is released while waiting: the entry may be cancelled or
+     taken by another caller, so it is looked up again on every wakeup */
+  if ( !p->replyCv.wait_for( lk, std::chrono::milliseconds( timeout ), [&] {
+         auto i = pending.find( id );
+         return i == pending.end() || i->second.done;
+       } ) )
+    return TIO_Timeout;
+  auto it = pending.find( id );
+  if ( it == pending.end() )
+    return TIO_InvalidParam;   /* cancelled while waiting */
+  Reply& r = it->second;
+  if ( error )
+    *error = r.code;
+  Int32 res = copyOut( r.data, reply, size, length );
+  if ( res != TIO_Ok )
+    return res;
+  bool failed = r.error;
+  pending.erase( it );
+  return failed ? TIO_RpcError : TIO_Ok;
+}
+
+
+Int32 TIO_API TIO_cancel( Int32 parser, Int32 request )
+{
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  if ( !p->pending().erase( uint16_t( request ) ) )
+    return TIO_InvalidParam;
+  p->replyCv.notify_all();
+  return TIO_Ok;
+}
+
+
+Int32 TIO_API TIO_counters( Int32 parser,
+                            double* packets,
+                            double* errors,
+                            double* lost,
+                            double* overflow )
+{
+  std::shared_ptr<Parser> p = find( parser );
+  if ( !p )
+    return TIO_NotConnected;
+  std::lock_guard<std::mutex> lk( p->m );
+  p->counters( packets, errors, lost, overflow );
+  return TIO_Ok;
+}
@@ -0,0 +1,269 @@
+/******************************************************************/
+/** @file tioparse.h
+ *  TIO packet parser DLL
+ *
+ *  Native replacement for the byte by byte parsing of TIO Parse
+ *  Packet.vi, TIO SLIP Decode.vi and TIO Data Stream.vi. Raw chunks read
+ *  from the serial port or the TCP socket are fed to a parser which
+ *    - splits them into packets (SLIP frames with CRC32 on serial,
+ *      back to back packets on TCP), skipping damaged data until the
+ *      next valid packet
+ *    - decodes stream packets in bulk into per stream sample buffers,
+ *      using the column layout from the dstream info
+ *    - keeps RPC replies for the requests formed by @ref TIO_formRequest
+ *    - queues all other packets (log, heartbeat, timebase, source,
+ *      packets routed from downstream devices) for @ref TIO_readPacket
+ *
+ *  Packet: { uint8 type; uint8 routingSize (low 4 bits); uint16 payload
+ *  size } followed by payload and routing bytes, little endian. Stream
+ *  packets have type 128 + stream id and a payload of uint32 first
+ *  sample number and whole samples.
+ */
+/******************************************************************/
+
+#ifndef __TIOPARSE_H__
+#define __TIOPARSE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define TIO_API
+#else
+#ifdef  DLL_EXPORT
+#define TIO_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define TIO_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define TIO_Ok                   0              /**< No error                              */
+#define TIO_Error              (-1)             /**< Unspecified error                     */
+#define TIO_NotConnected        -2              /**< Parser handle does not exist          */
+#define TIO_Timeout             -6              /**< Reply did not arrive in time          */
+#define TIO_InvalidParam        -9              /**< Parameter out of range                */
+#define TIO_BufferTooSmall     -10              /**< Output array too small                */
+#define TIO_NoData             -15              /**< Nothing to read                       */
+#define TIO_RpcError           -18              /**< Device answered with an RPC error     */
+
+#define TIO_MAX_PACKET         512              /**< Header, payload and routing           */
+#define TIO_MAX_STREAMS        128              /**< Stream ids 0..127                     */
+
+/** Packet types */
+#define TIO_PTYPE_LOG            1
+#define TIO_PTYPE_RPC_REQ        2
+#define TIO_PTYPE_RPC_REP        3
+#define TIO_PTYPE_RPC_ERROR      4
+#define TIO_PTYPE_HEARTBEAT      5
+#define TIO_PTYPE_TIMEBASE       6
+#define TIO_PTYPE_SOURCE         7
+#define TIO_PTYPE_STREAM0      128
+
+
+/** @brief  Link framing                                                             */
+typedef enum {
+  TIO_Slip = 0,                              /**< Serial: SLIP frames with CRC32     */
+  TIO_Raw  = 1                               /**< TCP: packets back to back          */
+} TIO_Framing;
+
+
+/** @brief  Column types of stream samples                                          */
+typedef enum {
+  TIO_u8  = 0,
+  TIO_i8  = 1,
+  TIO_u16 = 2,
+  TIO_i16 = 3,
+  TIO_u32 = 4,
+  TIO_i32 = 5,
+  TIO_f32 = 6,
+  TIO_f64 = 7
+} TIO_Type;
+
+
+/** @brief Create a parser for one link
+ *
+ *  @param  framing   Link framing, see @ref TIO_Framing
+ *  @param  parser    Output: parser handle
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_create( Int32 framing, Int32* parser );
+
+
+/** @brief Release a parser
+ *
+ *  @param  parser    Parser handle
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_close( Int32 parser );
+
+
+/** @brief Declare the sample layout of a stream
+ *
+ *  Stream packets of undeclared streams are queued for @ref TIO_readPacket.
+ *  Declaring a stream again clears its buffer.
+ *
+ *  @param  parser    Parser handle
+ *  @param  stream    Stream id
+ *  @param  columns   Number of columns
+ *  @param  types     Column types, see @ref TIO_Type
+ *  @param  capacity  Samples buffered until read; older ones are dropped
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_setStream( Int32 parser,
+                             Int32 stream,
+                             Int32 columns,
+                             const Int32* types,
+                             Int32 capacity );
+
+
+/** @brief Consume raw link data
+ *
+ *  @param  parser    Parser handle
+ *  @param  data      Bytes as read from the port
+ *  @param  n         Number of bytes
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_feed( Int32 parser, const unsigned char* data, Int32 n );
+
+
+/** @brief Take buffered samples of a stream
+ *
+ *  @param  parser    Parser handle
+ *  @param  stream    Stream id
+ *  @param  values    Output: rows * columns values, row major
+ *  @param  samples   Output: sample number of each row (may be NULL)
+ *  @param  size      Maximum number of rows
+ *  @param  rows      Output: number of rows written
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_readStream( Int32 parser,
+                              Int32 stream,
+                              double* values,
+                              double* samples,
+                              Int32 size,
+                              Int32* rows );
+
+
+/** @brief Take the oldest queued packet
+ *
+ *  @param  parser    Parser handle
+ *  @param  type      Output: packet type
+ *  @param  payload   Output: payload followed by the routing bytes
+ *  @param  size      Size of the payload array
+ *  @param  length    Output: payload length
+ *  @param  routing   Output: number of routing bytes after the payload
+ *  @return           Result of function, @ref TIO_NoData if none queued
+ */
+Int32 TIO_API TIO_readPacket( Int32 parser,
+                              Int32* type,
+                              unsigned char* payload,
+                              Int32 size,
+                              Int32* length,
+                              Int32* routing );
+
+
+/** @brief Frame a packet for sending
+ *
+ *  @param  parser    Parser handle
+ *  @param  type      Packet type
+ *  @param  payload   Payload
+ *  @param  n         Payload length
+ *  @param  out       Output: bytes to write to the port
+ *  @param  size      Size of out (2 * TIO_MAX_PACKET + 10 always fits)
+ *  @param  length    Output: number of bytes
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_formPacket( Int32 parser,
+                              Int32 type,
+                              const unsigned char* payload,
+                              Int32 n,
+                              unsigned char* out,
+                              Int32 size,
+                              Int32* length );
+
+
+/** @brief Frame an RPC request by method name
+ *
+ *  @param  parser    Parser handle
+ *  @param  method    Method name, e.g. "data.rate"
+ *  @param  args      Argument bytes
+ *  @param  n         Argument length
+ *  @param  out       Output: bytes to write to the port
+ *  @param  size      Size of out
+ *  @param  length    Output: number of bytes
+ *  @param  request   Output: request id for @ref TIO_reply
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_formRequest( Int32 parser,
+                               const char* method,
+                               const unsigned char* args,
+                               Int32 n,
+                               unsigned char* out,
+                               Int32 size,
+                               Int32* length,
+                               Int32* request );
+
+
+/** @brief Wait for the reply to a request
+ *
+ *  The reply is taken when returned; on @ref TIO_Timeout the request
+ *  stays pending, call again or @ref TIO_cancel it.
+ *
+ *  @param  parser    Parser handle
+ *  @param  request   Request id
+ *  @param  timeout   Time to wait for another loop to feed the reply [ms]
+ *  @param  reply     Output: reply data
+ *  @param  size      Size of the reply array
+ *  @param  length    Output: reply length
+ *  @param  error     Output: error code if @ref TIO_RpcError is returned
+ *  @return           Result of function, @ref TIO_InvalidParam if the
+ *                    request is unknown or was cancelled while waiting
+ */
+Int32 TIO_API TIO_reply( Int32 parser,
+                         Int32 request,
+                         Int32 timeout,
+                         unsigned char* reply,
+                         Int32 size,
+                         Int32* length,
+                         Int32* error );
+
+
+/** @brief Forget a pending request
+ *
+ *  A @ref TIO_reply waiting for it returns at once.
+ *
+ *  @param  parser    Parser handle
+ *  @param  request   Request id
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_cancel( Int32 parser, Int32 request );
+
+
+/** @brief Parser counters since creation
+ *
+ *  @param  parser    Parser handle
+ *  @param  packets   Output: valid packets
+ *  @param  errors    Output: frames dropped (checksum, size, framing)
+ *  @param  lost      Output: samples missing from stream sequences
+ *  @param  overflow  Output: samples and packets dropped for full buffers
+ *  @return           Result of function
+ */
+Int32 TIO_API TIO_counters( Int32 parser,
+                            double* packets,
+                            double* errors,
+                            double* lost,
+                            double* overflow );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,154 @@
+/******************************************************************/
+/** @file tlogengine_check.cpp
+ *  Regression check of @ref tlogengine.h with a controller on a pty
+ *
+ *  Build and run from TLogger/DLL:
+ *    g++ -std=c++17 -O2 -I. -I../../GenProg/DLL -pthread checks/tlogengine_check.cpp
+ *        tlogengine.cpp ../../GenProg/DLL/ioschedule.cpp -lutil
+ *  Exits with 0 if all checks pass.
+ */
+/******************************************************************/
+
+#include "tlogengine.h"
+#include "ioschedule.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <pty.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+void check( bool ok, const char* what )
+{
+  std::printf( "%s %s\n", ok ? "ok  " : "FAIL", what );
+  failures += !ok;
+}
+
+/** Controller on the pty master: answers every query with a constant
+ *  temperature                                                            */
+class Controller
+{
+public:
+  explicit Controller( int fd ) : fd_( fd ), stop_( false ), thread_( &Controller::run, this ) {}
+  ~Controller() { stop_ = true; thread_.join(); }
+
+private:
+  void run()
+  {
+    while ( !stop_ ) {
+      pollfd p = { fd_, POLLIN, 0 };
+      if ( ::poll( &p, 1, 20 ) <= 0 )
+        continue;
+      char buf[256];
+      ssize_t n = ::read( fd_, buf, sizeof buf );
+      for ( ssize_t k = 0; k < n; ++k )
+        if ( buf[k] == '\n' && ::write( fd_, "4.200\n", 6 ) < 0 )
+          return;
+    }
+  }
+
+  int               fd_;
+  std::atomic<bool> stop_;
+  std::thread       thread_;
+};
+
+/** Logs one session of a single channel for about 0.2 s                 */
+bool session( Int32 engine, Int32 instrument, const char* query )
+{
+  Int32 ctl = 0, ch = 0;
+  if ( TLOG_addController( engine, instrument, &ctl ) != TLOG_Ok ||
+       TLOG_addChannel( engine, ctl, query, -1, 0.1, 0., &ch ) != TLOG_Ok ||
+       TLOG_start( engine ) != TLOG_Ok )
+    return false;
+  std::this_thread::sleep_for( std::chrono::milliseconds( 200 ) );
+  return TLOG_stop( engine ) == TLOG_Ok;
+}
+
+Int32 records( const char* path, Int32 s, Int32 channel )
+{
+  double time[64];
+  float  value[64];
+  Int32  n = -1;
+  return TLOG_readLog( path, s, channel, time, value, 64, &n ) == TLOG_Ok ? n : -1;
+}
+
+} // namespace
+
+
+int main()
+{
+  int master = -1, slave = -1;
+  char name[256];
+  if ( openpty( &master, &slave, name, 0, 0 ) != 0 ) {
+    std::printf( "FAIL openpty\n" );
+    return 1;
+  }
+  Controller dev( master );
+
+  const char* path = "tlogengine_check.tlog";
+  std::remove( path );
+  IOS_Settings s = { 0, '\n', 500, 1, 0 };
+  Int32 bus = 0, inst = 0, e = 0;
+  IOS_createBus( &bus );
+  IOS_openInstrument( bus, name, &s, &inst );
+
+  /* Two sessions in a row on a steady reading: the deadband must not
+     carry the last value of the first session into the second */
+  check( TLOG_create( path, 0.02, &e ) == TLOG_Ok, "create log" );
+  check( session( e, inst, "KRDG? A\n" ), "first session" );
+  check( session( e, inst, "KRDG? B\n" ), "second session, one more channel" );
+  check( TLOG_close( e ) == TLOG_Ok, "close log" );
+
+  Int32 n = 0, channels = 0;
+  double start = 0.;
+  check( TLOG_readSession( path, -1, &start, &channels, &n ) == TLOG_Ok && n == 2 && channels == 2,
+         "two sessions, the last with two channels" );
+  check( records( path, 0, 0 ) == 1, "steady channel logged once in session 0" );
+  check( records( path, 1, 0 ) == 1, "steady channel logged again in session 1" );
+  check( records( path, 1, 1 ) == 1, "new channel logged in session 1" );
+
+  /* Appending keeps the sessions apart */
+  check( TLOG_create( path, 0.02, &e ) == TLOG_Ok, "append to log" );
+  check( session( e, inst, "SRDG? A\n" ), "session of another engine" );
+  TLOG_close( e );
+  char query[32];
+  check( TLOG_readQuery( path, 2, 0, query, sizeof query ) == TLOG_Ok && std::string( query ) == "SRDG? A\n",
+         "query of the appended session" );
+  check( records( path, 2, 0 ) == 1, "appended session logged" );
+
+  IOS_closeBus( bus );
+  ::close( slave );
+
+  /* A log longer than the read buffer, written as laid out in the header */
+  const Int32 big = 100000;
+  if ( std::FILE* f = std::fopen( path, "wb" ) ) {
+    unsigned char r[40] = { 0 };
+    std::fwrite( "TLOGBIN2", 1, 8, f );
+    r[8] = 1;                                  /* one channel, 20 bytes of queries */
+    r[12] = 20;
+    r[16] = r[17] = 0xff;
+    r[18] = TLOG_FLAG_SESSION;
+    r[20] = 'Q';
+    std::fwrite( r, 1, 40, f );
+    std::memset( r, 0, sizeof r );
+    for ( Int32 k = 0; k < big; ++k )
+      std::fwrite( r, 1, 20, f );
+    std::fclose( f );
+  }
+  std::vector<double> time( big );
+  std::vector<float>  value( big );
+  Int32 got = 0;
+  check( TLOG_readLog( path, 0, 0, time.data(), value.data(), big, &got ) == TLOG_Ok && got == big,
+         "long log read to the end" );
+  std::remove( path );
+  return failures ? 1 : 0;
+}
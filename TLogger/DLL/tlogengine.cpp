@@ -0,0 +1,807 @@
+/******************************************************************/
+/** @file tlogengine.cpp
+ *  Temperature logging DLL
+ *
+ *  Implementation of @ref tlogengine.h
+ */
+/******************************************************************/
+
+#define DLL_EXPORT
+#include "tlogengine.h"
+#include "ioschedule.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const char     kMagic[8]      = { 'T', 'L', 'O', 'G', 'B', 'I', 'N', '2' };
+const size_t   kRecordSize    = 20;
+const uint16_t kSessionMarker = 0xffff;     /**< Channel field of a session record */
+const auto     kFlushInterval = std::chrono::seconds( 1 );
+
+double wallTime()
+{
+  return std::chrono::duration<double>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+
+/* ----- Calibration ---------------------------------------------------------- */
+
+/** Natural cubic spline, y = a + b dx + c dx^2 + d dx^3 on each segment  */
+class Spline
+{
+public:
+  bool build( const double* sx, const double* sy, Int32 n )
+  {
+    std::vector<std::pair<double, double> > p( n );
+    for ( Int32 k = 0; k < n; ++k )
+      p[k] = std::make_pair( sx[k], sy[k] );
+    std::sort( p.begin(), p.end() );
+    for ( Int32 k = 1; k < n; ++k )
+      if ( !( p[k].first > p[k - 1].first ) )
+        return false;
+
+    x_.resize( n ); a_.resize( n ); b_.resize( n ); c_.assign( n, 0. ); d_.resize( n );
+    for ( Int32 k = 0; k < n; ++k ) {
+      x_[k] = p[k].first;
+      a_[k] = p[k].second;
+    }
+    std::vector<double> h( n - 1 ), mu( n, 0. ), z( n, 0. );
+    for ( Int32 k = 0; k + 1 < n; ++k )
+      h[k] = x_[k + 1] - x_[k];
+    for ( Int32 k = 1; k + 1 < n; ++k ) {
+      double alpha = 3. / h[k] * ( a_[k + 1] - a_[k] ) - 3. / h[k - 1] * ( a_[k] - a_[k - 1] );
+      double l     = 2. * ( x_[k + 1] - x_[k - 1] ) - h[k - 1] * mu[k - 1];
+      mu[k] = h[k] / l;
+      z[k]  = ( alpha - h[k - 1] * z[k - 1] ) / l;
+    }
+    for ( Int32 k = n - 2; k >= 0; --k ) {
+      c_[k] = z[k] - mu[k] * c_[k + 1];
+      b_[k] = ( a_[k + 1] - a_[k] ) / h[k] - h[k] * ( c_[k + 1] + 2. * c_[k] ) / 3.;
+      d_[k] = ( c_[k + 1] - c_[k] ) / ( 3. * h[k] );
+    }
+    double hl = h[n - 2];
+    b_[n - 1] = b_[n - 2] + 2. * c_[n - 2] * hl + 3. * d_[n - 2] * hl * hl;
+    return true;
+  }
+
+  double operator()( double v ) const
+  {
+    size_t n = x_.size();
+    if ( v <= x_[0] )
+      return a_[0] + b_[0] * ( v - x_[0] );
+    if ( v >= x_[n - 1] )
+      return a_[n - 1] + b_[n - 1] * ( v - x_[n - 1] );
+    size_t k  = size_t( std::upper_bound( x_.begin(), x_.end(), v ) - x_.begin() ) - 1;
+    double dx = v - x_[k];
+    return a_[k] + dx * ( b_[k] + dx * ( c_[k] + dx * d_[k] ) );
+  }
+
+private:
+  std::vector<double> x_, a_, b_, c_, d_;
+};
+
+
+/* ----- Log writer ----------------------------------------------------------- */
+
+struct Record {
+  double   time;
+  float    raw;
+  float    value;
+  uint16_t channel;
+  uint16_t flags;
+};
+
+void putLe( unsigned char* p, uint64_t v, int n )
+{
+  for ( int k = 0; k < n; ++k, v >>= 8 )
+    p[k] = (unsigned char)( v & 0xff );
+}
+
+uint64_t getLe( const unsigned char* p, int n )
+{
+  uint64_t v = 0;
+  for ( int k = n - 1; k >= 0; --k )
+    v = ( v << 8 ) | p[k];
+  return v;
+}
+
+void encode( const Record& r, unsigned char* p )
+{
+  uint64_t t;
+  uint32_t raw, value;
+  std::memcpy( &t, &r.time, 8 );
+  std::memcpy( &raw, &r.raw, 4 );
+  std::memcpy( &value, &r.value, 4 );
+  putLe( p, t, 8 );
+  putLe( p + 8, raw, 4 );
+  putLe( p + 12, value, 4 );
+  putLe( p + 16, r.channel, 2 );
+  putLe( p + 18, r.flags, 2 );
+}
+
+/** Appends records from a background thread, flushing once per second   */
+class Writer
+{
+public:
+  explicit Writer( std::FILE* f ) : f_( f ), stop_( false ), failed_( false ), thread_( &Writer::run, this ) {}
+
+  ~Writer()
+  {
+    {
+      std::lock_guard<std::mutex> lk( m_ );
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    std::fclose( f_ );
+  }
+
+  void push( const Record& r )
+  {
+    std::lock_guard<std::mutex> lk( m_ );
+    queue_.resize( queue_.size() + kRecordSize );
+    encode( r, &queue_[queue_.size() - kRecordSize] );
+  }
+
+  /** Session record: start time, channel count and the NUL terminated
+   *  query of each channel, padded to whole records                      */
+  void pushSession( double time, const std::vector<std::string>& queries )
+  {
+    size_t bytes = 0;
+    for ( auto& q : queries )
+      bytes += q.size() + 1;
+    bytes = ( bytes + kRecordSize - 1 ) / kRecordSize * kRecordSize;
+
+    std::lock_guard<std::mutex> lk( m_ );
+    size_t at = queue_.size();
+    queue_.resize( at + kRecordSize + bytes, 0 );
+    unsigned char* p = &queue_[at];
+    uint64_t t;
+    std::memcpy( &t, &time, 8 );
+    putLe( p, t, 8 );
+    putLe( p + 8, queries.size(), 4 );
+    putLe( p + 12, bytes, 4 );
+    putLe( p + 16, kSessionMarker, 2 );
+    putLe( p + 18, TLOG_FLAG_SESSION, 2 );
+    p += kRecordSize;
+    for ( auto& q : queries ) {
+      std::memcpy( p, q.c_str(), q.size() + 1 );
+      p += q.size() + 1;
+    }
+  }
+
+  bool failed() const { return failed_; }
+
+private:
+  void run()
+  {
+    std::vector<unsigned char> bytes;
+    std::unique_lock<std::mutex> lk( m_ );
+    for ( ;; ) {
+      cv_.wait_for( lk, kFlushInterval, [this] { return stop_; } );
+      bool last = stop_;
+      bytes.swap( queue_ );
+      lk.unlock();
+
+      if ( !bytes.empty() ) {
+        if ( std::fwrite( bytes.data(), 1, bytes.size(), f_ ) != bytes.size() || std::fflush( f_ ) != 0 )
+          failed_ = true;
+        bytes.clear();
+      }
+
+      lk.lock();
+      if ( last )
+        return;
+    }
+  }
+
+  std::FILE*                 f_;
+  std::mutex                 m_;
+  std::condition_variable    cv_;
+  std::vector<unsigned char> queue_;          /**< Encoded records, not yet written */
+  bool                       stop_;
+  std::atomic<bool>          failed_;
+  std::thread                thread_;
+};
+
+
+/* ----- Log reader ----------------------------------------------------------- */
+
+/** Reads a log file record by record                                     */
+class LogFile
+{
+public:
+  explicit LogFile( const char* path ) : f_( std::fopen( path, "rb" ) ), buf_( kRecordSize * 4096 ), pos_( 0 ), end_( 0 ) {}
+  ~LogFile() { if ( f_ ) std::fclose( f_ ); }
+
+  /** True if the file exists and starts with the magic                   */
+  bool valid()
+  {
+    const unsigned char* p = f_ ? take( sizeof kMagic ) : 0;
+    return p && std::memcmp( p, kMagic, sizeof kMagic ) == 0;
+  }
+
+  /** Next n bytes, NULL at the end of the file; valid until the next call */
+  const unsigned char* take( size_t n )
+  {
+    if ( end_ - pos_ < n ) {
+      std::copy( buf_.begin() + pos_, buf_.begin() + end_, buf_.begin() );
+      end_ -= pos_;
+      pos_  = 0;
+      if ( buf_.size() < n )
+        buf_.resize( n );
+      end_ += std::fread( &buf_[end_], 1, buf_.size() - end_, f_ );
+      if ( end_ < n )
+        return 0;
+    }
+    pos_ += n;
+    return &buf_[pos_ - n];
+  }
+
+private:
+  std::FILE*                 f_;
+  std::vector<unsigned char> buf_;
+  size_t                     pos_, end_;
+};
+
+struct Session {
+  double                   start = 0.;
+  std::vector<std::string> queries;          /**< Indexed by channel number      */
+};
+
+/** Walks a log file: onSession( index, session ) at every session record,
+ *  onRecord( record ) for the records that follow it. A truncated last
+ *  record is ignored.                                                     */
+template <class OnSession, class OnRecord>
+Int32 scanLog( const char* path, OnSession onSession, OnRecord onRecord )
+{
+  LogFile f( path );
+  if ( !f.valid() )
+    return TLOG_FileError;
+  Int32 index = -1;
+  while ( const unsigned char* p = f.take( kRecordSize ) ) {
+    if ( getLe( p + 16, 2 ) != kSessionMarker ) {
+      if ( index >= 0 )
+        onRecord( p );
+      continue;
+    }
+    uint64_t t        = getLe( p, 8 );
+    size_t   channels = size_t( getLe( p + 8, 4 ) );
+    size_t   bytes    = size_t( getLe( p + 12, 4 ) );
+    const unsigned char* q = f.take( bytes );
+    if ( !q )
+      break;
+    Session s;
+    std::memcpy( &s.start, &t, 8 );
+    for ( size_t k = 0, at = 0; k < channels && at < bytes; ++k ) {
+      const unsigned char* e = std::find( q + at, q + bytes, 0 );
+      s.queries.push_back( std::string( q + at, e ) );
+      at = size_t( e - q ) + 1;
+    }
+    onSession( ++index, s );
+  }
+  return TLOG_Ok;
+}
+
+/** Session of a log file, the last one if session < 0                    */
+Int32 findSession( const char* path, Int32 session, Session& found, Int32& sessions )
+{
+  sessions = 0;
+  Int32 r = scanLog( path,
+                     [&]( Int32 k, Session& s ) {
+                       sessions = k + 1;
+                       if ( session < 0 || k == session )
+                         found = std::move( s );
+                     },
+                     []( const unsigned char* ) {} );
+  if ( r != TLOG_Ok )
+    return r;
+  return session >= sessions || sessions == 0 ? TLOG_InvalidParam : TLOG_Ok;
+}
+
+
+/* ----- Engine --------------------------------------------------------------- */
+
+struct Channel {
+  Int32       number;
+  std::string query;
+  Int32       table;
+  double      deadband;
+  double      heartbeat;
+  bool        logged    = false;             /**< A value has been logged        */
+  double      lastValue = 0.;
+  double      lastTime  = 0.;
+};
+
+struct Controller {
+  Int32                instrument;
+  std::vector<Channel> channels;
+  std::thread          worker;
+};
+
+struct Latest {
+  double time  = 0.;
+  double value = 0.;
+  bool   valid = false;
+};
+
+class Engine
+{
+public:
+  Engine( std::FILE* f, double period ) : period_( period ), running_( false ), writer_( f ) {}
+  ~Engine() { stop(); }
+
+  std::mutex                               control;  /**< Serializes start, stop and setup;
+                                                          held by stop until the workers
+                                                          are joined                       */
+  std::mutex                               m;        /**< Guards configuration and latest */
+  std::vector<Spline>                      tables;
+  std::vector<std::unique_ptr<Controller>> controllers;
+  std::vector<Latest>                      latest;   /**< Indexed by channel number       */
+
+  bool running() const { return running_; }
+
+  void start()
+  {
+    /* A session stands on its own: every channel logs its first reading */
+    std::vector<std::string> queries( latest.size() );
+    for ( auto& c : controllers )
+      for ( auto& ch : c->channels ) {
+        queries[ch.number] = ch.query;
+        ch.logged   = false;
+        ch.lastTime = 0.;
+      }
+    writer_.pushSession( wallTime(), queries );
+    {
+      std::lock_guard<std::mutex> lk( stopM_ );
+      running_ = true;
+    }
+    for ( auto& c : controllers )
+      c->worker = std::thread( &Engine::poll, this, c.get() );
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lk( stopM_ );
+      running_ = false;
+    }
+    stopCv_.notify_all();
+    for ( auto& c : controllers )
+      if ( c->worker.joinable() )
+        c->worker.join();
+  }
+
+  bool writeFailed() const { return writer_.failed(); }
+
+private:
+  /** Controller worker: queues every channel query, then converts and
+   *  logs the replies, once per period on an absolute schedule.          */
+  void poll( Controller* c )
+  {
+    std::vector<Int32> tickets( c->channels.size() );
+    auto next = std::chrono::steady_clock::now();
+    const auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>( period_ ) );
+    for ( ;; ) {
+      double t = wallTime();
+      for ( size_t k = 0; k < c->channels.size(); ++k )
+        if ( IOS_query( c->instrument, c->channels[k].query.c_str(), &tickets[k] ) != IOS_Ok )
+          tickets[k] = -1;
+
+      for ( size_t k = 0; k < c->channels.size(); ++k ) {
+        Channel& ch = c->channels[k];
+        char   reply[64];
+        Int32  len = 0;
+        Record r   = { t, 0.f, 0.f, uint16_t( ch.number ), 0 };
+        double raw = std::numeric_limits<double>::quiet_NaN();
+        if ( tickets[k] >= 0 ) {
+          Int32 w = IOS_wait( tickets[k], -1, reply, sizeof reply - 1, &len );
+          if ( w == IOS_BufferTooSmall )
+            IOS_release( tickets[k] );
+          if ( w == IOS_Ok ) {
+            reply[len] = 0;
+            char* end  = 0;
+            raw = std::strtod( reply, &end );
+            if ( end == reply )
+              raw = std::numeric_limits<double>::quiet_NaN();
+          }
+        }
+        double value = ( ch.table >= 0 && raw == raw ) ? tables[ch.table]( raw ) : raw;
+        r.raw   = float( raw );
+        r.value = float( value );
+        if ( raw != raw )
+          r.flags |= TLOG_FLAG_READ_ERROR;
+
+        if ( value == value ) {
+          std::lock_guard<std::mutex> lk( m );
+          latest[ch.number].time  = t;
+          latest[ch.number].value = value;
+          latest[ch.number].valid = true;
+        }
+
+        bool changed = !ch.logged || ch.deadband == 0. ||
+                       !( std::fabs( value - ch.lastValue ) <= ch.deadband );
+        bool beat    = ch.heartbeat > 0. && t - ch.lastTime >= ch.heartbeat;
+        if ( changed || beat ) {
+          if ( !changed )
+            r.flags |= TLOG_FLAG_HEARTBEAT;
+          writer_.push( r );
+          ch.logged    = true;
+          ch.lastValue = value;
+          ch.lastTime  = t;
+        }
+      }
+
+      next += step;
+      auto now = std::chrono::steady_clock::now();
+      if ( next < now )
+        next = now;   /* overrun: skip the missed slots */
+      std::unique_lock<std::mutex> lk( stopM_ );
+      if ( stopCv_.wait_until( lk, next, [this] { return !running_; } ) )
+        return;
+    }
+  }
+
+  double                  period_;
+  std::mutex              stopM_;
+  std::condition_variable stopCv_;
+  std::atomic<bool>       running_;
+  Writer                  writer_;
+};
+
+
+struct Registry {
+  std::mutex                               m;
+  Int32                                    nextId = 1;
+  std::map<Int32, std::shared_ptr<Engine>> engines;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+std::shared_ptr<Engine> find( Int32 engine )
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lk( reg.m );
+  auto it = reg.engines.find( engine );
+  return it == reg.engines.end() ? std::shared_ptr<Engine>() : it->second;
+}
+
+} // namespace
+
+
+Int32 TLOG_API TLOG_create( const char* path, double period, Int32* engine )
+{
+  if ( !path || !engine || !( period > 0. ) )
+    return TLOG_InvalidParam;
+
+  /* Only append to a log of this format; each start writes the channel
+     layout of its session */
+  if ( std::FILE* old = std::fopen( path, "rb" ) ) {
+    std::fseek( old, 0, SEEK_END );
+    bool empty = std::ftell( old ) == 0;
+    std::fclose( old );
+    if ( !empty && !LogFile( path ).valid() )
+      return TLOG_FileError;
+  }
+
+  std::FILE* f = std::fopen( path, "ab" );
+  if ( !f )
+    return TLOG_FileError;
+  std::fseek( f, 0, SEEK_END );
+  if ( std::ftell( f ) == 0 && std::fwrite( kMagic, 1, sizeof kMagic, f ) != sizeof kMagic ) {
+    std::fclose( f );
+    return TLOG_FileError;
+  }
+
+  try {
+    std::shared_ptr<Engine> e = std::make_shared<Engine>( f, period );
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    *engine = reg.nextId++;
+    reg.engines[*engine] = e;
+    return TLOG_Ok;
+  }
+  catch ( ... ) {
+    return TLOG_Error;
+  }
+}
+
+
+Int32 TLOG_API TLOG_close( Int32 engine )
+{
+  std::shared_ptr<Engine> e;
+  {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lk( reg.m );
+    auto it = reg.engines.find( engine );
+    if ( it == reg.engines.end() )
+      return TLOG_NotConnected;
+    e = it->second;
+    reg.engines.erase( it );
+  }
+  bool failed = e->writeFailed();
+  e.reset();
+  return failed ? TLOG_FileError : TLOG_Ok;
+}
+
+
+Int32 TLOG_API TLOG_addTable( Int32 engine,
+                              const double* sensor,
+                              const double* temperature,
+                              Int32 n,
+                              Int32* table )
+{
+  if ( !sensor || !temperature || n < 2 || !table )
+    return TLOG_InvalidParam;
+  std::shared_ptr<Engine> e = find( engine );
+  if ( !e )
+    return TLOG_NotConnected;
+  std::lock_guard<std::mutex> ctl( e->control );
+  std::lock_guard<std::mutex> lk( e->m );
+  if ( e->running() )
+    return TLOG_Running;
+  try {
+    Spline s;
+    if ( !s.build( sensor, temperature, n ) )
+      return TLOG_InvalidParam;
+    e->tables.push_back( std::move( s ) );
+    *table = Int32( e->tables.size() ) - 1;
+    return TLOG_Ok;
+  }
+  catch ( ... ) {
+    return TLOG_Error;
+  }
+}
+
+
+Int32 TLOG_API TLOG_convert( Int32 engine,
+                             Int32 table,
+                             const double* in,
+                             double* out,
+                             Int32 n )
+{
+  if ( n < 0 || ( n > 0 && ( !in || !out ) ) )
+    return TLOG_InvalidParam;
+  std::shared_ptr<Engine> e = find( engine );
+  if ( !e )
+    return TLOG_NotConnected;
+  std::lock_guard<std::mutex> lk( e->m );
+  if ( table < 0 || table >= Int32( e->tables.size() ) )
+    return TLOG_InvalidParam;
+  const Spline& s = e->tables[table];
+  for ( Int32 k = 0; k < n; ++k )
+    out[k] = s( in[k] );
+  return TLOG_Ok;
+}
+
+
+Int32 TLOG_API TLOG_addController( Int32 engine, Int32 instrument, Int32* controller )
+{
+  if ( !controller )
+    return TLOG_InvalidParam;
+  std::shared_ptr<Engine> e = find( engine );
+  if ( !e )
+    return TLOG_NotConnected;
+  std::lock_guard<std::mutex> ctl( e->control );
+  std::lock_guard<std::mutex> lk( e->m );
+  if ( e->running() )
+    return TLOG_Running;
+  try {
+    std::unique_ptr<Controller> c( new Controller );
+    c->instrument = instrument;
+    e->controllers.push_back( std::move( c ) );
+    *controller = Int32( e->controllers.size() ) - 1;
+    return TLOG_Ok;
+  }
+  catch ( ... ) {
+    return TLOG_Error;
+  }
+}
+
+
+Int32 TLOG_API TLOG_addChannel( Int32 engine,
+                                Int32 controller,
+                                const char* query,
+                                Int32 table,
+                                double deadband,
+                                double heartbeat,
+                                Int32* channel )
+{
+  if ( !query || !channel || deadband < 0. || heartbeat < 0. )
+    return TLOG_InvalidParam;
+  std::shared_ptr<Engine> e = find( engine );
+  if ( !e )
+    return TLOG_NotConnected;
+  std::lock_guard<std::mutex> ctl( e->control );
+  std::lock_guard<std::mutex> lk( e->m );
+  if ( e->running() )
+    return TLOG_Running;
+  if ( controller < 0 || controller >= Int32( e->controllers.size() ) ||
+       table < -1 || table >= Int32( e->tables.size() ) || e->latest.size() >= kSessionMarker )
+    return TLOG_InvalidParam;
+  try {
+    Channel ch;
+    ch.number    = Int32( e->latest.size() );
+    ch.query     = query;
+    ch.table     = table;
+    ch.deadband  = deadband;
+    ch.heartbeat = heartbeat;
+    e->controllers[controller]->channels.push_back( ch );
+    e->latest.push_back( Latest() );
+    *channel = ch.number;
+    return TLOG_Ok;
+  }
+  catch ( ... ) {
+    return TLOG_Error;
+  }
+}
+
+
+Int32 TLOG_API TLOG_start( Int32 engine )
+{
+  std::shared_ptr<Engine> e = find( engine );
+  if ( !e )
+    return TLOG_NotConnected;
+  std::lock_guard<std::mutex> ctl( e->control );
+  std::lock_guard<std::mutex> lk( e->m );
+  if ( e->running() )
+    return TLOG_Running;
+  try {
+    e->start();
+    return TLOG_Ok;
+  }
+  catch ( ... ) {
+    e->stop();
+    return TLOG_Error;
+  }
+}
+
+
+Int32 TLOG_API TLOG_stop( Int32 engine )
+{
+  std::shared_ptr<Engine> e = find( engine );
+  if ( !e )
+    return TLOG_NotConnected;
+  std::lock_guard<std::mutex> ctl( e->control );
+  e->stop();
+  return e->writeFailed() ? TLOG_FileError : TLOG_Ok;
+}
+
+
+Int32 TLOG_API TLOG_latest( Int32 engine, Int32 channel, double* time, double* value )
+{
+  if ( !time || !value )
+    return TLOG_InvalidParam;
+  std::shared_ptr<Engine> e = find( engine );
+  if ( !e )
+    return TLOG_NotConnected;
+  std::lock_guard<std::mutex> lk( e->m );
+  if ( channel < 0 || channel >= Int32( e->latest.size() ) )
+    return TLOG_InvalidParam;
+  const Latest& l = e->latest[channel];
+  if ( !l.valid )
+    return TLOG_NoData;
+  *time  = l.time;
+  *value = l.value;
+  return TLOG_Ok;
+}
+
+
+Int32 TLOG_API TLOG_readSession( const char* path,
+                                 Int32 session,
+                                 double* start,
+                                 Int32* channels,
+                                 Int32* sessions )
+{
+  if ( !path || !start || !channels )
+    return TLOG_InvalidParam;
+  try {
+    Session found;
+    Int32   n = 0;
+    Int32   r = findSession( path, session, found, n );
+    if ( sessions )
+      *sessions = n;
+    if ( r != TLOG_Ok )
+      return r;
+    *start    = found.start;
+    *channels = Int32( found.queries.size() );
+    return TLOG_Ok;
+  }
+  catch ( ... ) {
+    return TLOG_Error;
+  }
+}
+
+
+Int32 TLOG_API TLOG_readQuery( const char* path,
+                               Int32 session,
+                               Int32 channel,
+                               char* query,
+                               Int32 size )
+{
+  if ( !path || !query || size <= 0 )
+    return TLOG_InvalidParam;
+  try {
+    Session found;
+    Int32   n = 0;
+    Int32   r = findSession( path, session, found, n );
+    if ( r != TLOG_Ok )
+      return r;
+    if ( channel < 0 || channel >= Int32( found.queries.size() ) )
+      return TLOG_InvalidParam;
+    const std::string& q = found.queries[channel];
+    if ( q.size() >= size_t( size ) )
+      return TLOG_BufferTooSmall;
+    std::memcpy( query, q.c_str(), q.size() + 1 );
+    return TLOG_Ok;
+  }
+  catch ( ... ) {
+    return TLOG_Error;
+  }
+}
+
+
+Int32 TLOG_API TLOG_readLog( const char* path,
+                             Int32 session,
+                             Int32 channel,
+                             double* time,
+                             float* value,
+                             Int32 size,
+                             Int32* count )
+{
+  if ( !path || !count || size < 0 || ( size > 0 && ( !time || !value ) ) )
+    return TLOG_InvalidParam;
+
+  /* Channel numbers restart with every session, so only the records of
+     the requested one are taken */
+  Int32 n = 0, sessions = 0, channels = 0;
+  bool  active = false;
+  Int32 r = scanLog( path,
+                     [&]( Int32 k, Session& s ) {
+                       sessions = k + 1;
+                       active   = session < 0 || k == session;
+                       if ( active ) {
+                         n        = 0;
+                         channels = Int32( s.queries.size() );
+                       }
+                     },
+                     [&]( const unsigned char* p ) {
+                       if ( !active || Int32( getLe( p + 16, 2 ) ) != channel )
+                         return;
+                       if ( n < size ) {
+                         uint64_t t = getLe( p, 8 );
+                         uint32_t v = uint32_t( getLe( p + 12, 4 ) );
+                         std::memcpy( time + n, &t, 8 );
+                         std::memcpy( value + n, &v, 4 );
+                       }
+                       ++n;
+                     } );
+  if ( r != TLOG_Ok )
+    return r;
+  if ( session >= sessions || sessions == 0 || channel < 0 || channel >= channels )
+    return TLOG_InvalidParam;
+  *count = n;
+  return n > size ? TLOG_BufferTooSmall : TLOG_Ok;
+}
@@ -0,0 +1,242 @@
+/******************************************************************/
+/** @file tlogengine.h
+ *  Temperature logging DLL
+ *
+ *  Native engine behind TLogger. Every temperature controller (LSCI 332,
+ *  340, 370, 625...) is polled by its own worker at a fixed period, so
+ *  adding controllers or channels does not stretch the sample period.
+ *  Readings in sensor units are converted with cubic splines
+ *  precomputed from the calibration tables, filtered with a per channel
+ *  deadband and appended to a compact binary log by a background writer.
+ *
+ *  Controllers are instruments opened with the I/O scheduler (see
+ *  ioschedule.h); put each controller on its own bus.
+ *
+ *  Log file layout (little endian): the 8 byte magic "TLOGBIN2" followed
+ *  by 20 byte records { double time; float raw; float value;
+ *  uint16 channel; uint16 flags }. Time is in s since 1970-01-01 UTC.
+ *  Every @ref TLOG_start begins a session with the record { double time;
+ *  uint32 channels; uint32 bytes; uint16 0xffff; uint16 TLOG_FLAG_SESSION }
+ *  followed by bytes bytes (whole records) holding the NUL terminated
+ *  query of each channel. Channel numbers are only unique within their
+ *  session, as a file may be appended to with another set of channels.
+ */
+/******************************************************************/
+
+#ifndef __TLOGENGINE_H__
+#define __TLOGENGINE_H__
+
+
+/** Definitions for the windows DLL interface                                        */
+#if defined(unix) || defined(__unix__)
+#define TLOG_API
+#else
+#ifdef  DLL_EXPORT
+#define TLOG_API __declspec(dllexport) _stdcall  /**< For internal use of this header */
+#else
+#define TLOG_API __declspec(dllimport) _stdcall  /**< For external use of this header */
+#endif
+#endif
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int Bln32;                              /**< Boolean compatible to older C      */
+typedef int Int32;                              /**< Basic type                         */
+
+/** Return values of functions */
+#define TLOG_Ok                  0              /**< No error                              */
+#define TLOG_Error             (-1)             /**< Unspecified error                     */
+#define TLOG_NotConnected       -2              /**< Handle does not exist                 */
+#define TLOG_FileError          -8              /**< Log file cannot be opened or written  */
+#define TLOG_InvalidParam       -9              /**< Parameter out of range                */
+#define TLOG_BufferTooSmall    -10              /**< Output arrays too small               */
+#define TLOG_Running           -14              /**< Not allowed while logging             */
+#define TLOG_NoData            -15              /**< Channel has not been read yet         */
+
+/** Record flags */
+#define TLOG_FLAG_HEARTBEAT   0x01              /**< Written because heartbeat expired     */
+#define TLOG_FLAG_READ_ERROR  0x02              /**< Reading failed, value is NaN          */
+#define TLOG_FLAG_SESSION     0x80              /**< Session record, see the file layout   */
+
+
+/** @brief Create a logging engine
+ *
+ *  The log file is created, or appended to if it already exists and is
+ *  a log of this format; any other file gives @ref TLOG_FileError.
+ *
+ *  @param  path     Log file path
+ *  @param  period   Sample period in s
+ *  @param  engine   Output: engine handle
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_create( const char* path, double period, Int32* engine );
+
+
+/** @brief Stop logging, flush and close the log file
+ *
+ *  @param  engine   Engine handle
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_close( Int32 engine );
+
+
+/** @brief Add a calibration table
+ *
+ *  Builds a natural cubic spline through the (sensor, temperature)
+ *  points, e.g. a curve loaded by ConvTableTlog.vi. Points need not be
+ *  sorted; sensor values must be distinct. Outside the table the
+ *  conversion extrapolates linearly.
+ *
+ *  @param  engine       Engine handle
+ *  @param  sensor       Sensor readings (ohm, V...)
+ *  @param  temperature  Temperatures in K
+ *  @param  n            Number of points, >= 2
+ *  @param  table        Output: table id
+ *  @return              Result of function
+ */
+Int32 TLOG_API TLOG_addTable( Int32 engine,
+                              const double* sensor,
+                              const double* temperature,
+                              Int32 n,
+                              Int32* table );
+
+
+/** @brief Convert sensor readings
+ *
+ *  @param  engine   Engine handle
+ *  @param  table    Table id
+ *  @param  in       Sensor readings
+ *  @param  out      Output: temperatures in K (may alias in)
+ *  @param  n        Number of readings
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_convert( Int32 engine,
+                             Int32 table,
+                             const double* in,
+                             double* out,
+                             Int32 n );
+
+
+/** @brief Add a controller
+ *
+ *  @param  engine      Engine handle
+ *  @param  instrument  Instrument handle from IOS_openInstrument
+ *  @param  controller  Output: controller id
+ *  @return             Result of function
+ */
+Int32 TLOG_API TLOG_addController( Int32 engine, Int32 instrument, Int32* controller );
+
+
+/** @brief Add a channel to a controller
+ *
+ *  A reading is logged when it differs by more than deadband from the
+ *  last logged value of the channel, or when heartbeat seconds have
+ *  passed since then.
+ *
+ *  @param  engine      Engine handle
+ *  @param  controller  Controller id
+ *  @param  query       Query with terminator, e.g. "SRDG? A\\n" or "KRDG? B\\n"
+ *  @param  table       Table id, -1 if the reply is already in K
+ *  @param  deadband    Deadband in K (0 logs every reading)
+ *  @param  heartbeat   Maximum time between records in s (0 disables)
+ *  @param  channel     Output: channel number written in the log
+ *  @return             Result of function
+ */
+Int32 TLOG_API TLOG_addChannel( Int32 engine,
+                                Int32 controller,
+                                const char* query,
+                                Int32 table,
+                                double deadband,
+                                double heartbeat,
+                                Int32* channel );
+
+
+/** @brief Start polling all controllers
+ *
+ *  Begins a session in the log that records the query of each channel.
+ *
+ *  @param  engine   Engine handle
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_start( Int32 engine );
+
+
+/** @brief Stop polling; logged records are flushed
+ *
+ *  @param  engine   Engine handle
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_stop( Int32 engine );
+
+
+/** @brief Latest reading of a channel, logged or not
+ *
+ *  @param  engine   Engine handle
+ *  @param  channel  Channel number
+ *  @param  time     Output: time of the reading in s since 1970
+ *  @param  value    Output: temperature in K
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_latest( Int32 engine, Int32 channel, double* time, double* value );
+
+
+/** @brief Describe a session of a log file
+ *
+ *  @param  path     Log file path
+ *  @param  session  Session index in file order, -1 for the last one
+ *  @param  start    Output: start time of the session in s since 1970
+ *  @param  channels Output: number of channels of the session
+ *  @param  sessions Output: number of sessions in the file (may be NULL)
+ *  @return          Result of function, @ref TLOG_InvalidParam if there
+ *                   is no such session
+ */
+Int32 TLOG_API TLOG_readSession( const char* path,
+                                 Int32 session,
+                                 double* start,
+                                 Int32* channels,
+                                 Int32* sessions );
+
+
+/** @brief Query that a channel of a session logged
+ *
+ *  @param  path     Log file path
+ *  @param  session  Session index in file order, -1 for the last one
+ *  @param  channel  Channel number
+ *  @param  query    Output: NUL terminated query
+ *  @param  size     Size of the query buffer
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_readQuery( const char* path,
+                               Int32 session,
+                               Int32 channel,
+                               char* query,
+                               Int32 size );
+
+
+/** @brief Read a channel of one session back from a log file
+ *
+ *  @param  path     Log file path
+ *  @param  session  Session index in file order, -1 for the last one
+ *  @param  channel  Channel number
+ *  @param  time     Output: record times in s since 1970
+ *  @param  value    Output: temperatures in K
+ *  @param  size     Number of elements of time and value
+ *  @param  count    Output: number of records of the channel
+ *  @return          Result of function
+ */
+Int32 TLOG_API TLOG_readLog( const char* path,
+                             Int32 session,
+                             Int32 channel,
+                             double* time,
+                             float* value,
+                             Int32 size,
+                             Int32* count );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif